@@ -0,0 +1,148 @@
+/*
+ * 微基准框架: 迭代次数标定, 计时, 周期计数和内存分配计数
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <malloc.h>
+#else
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#endif
+
+static _Atomic uint32_t s_allocs;
+static const char *s_filter;
+
+// 链接时用--wrap把本工程对malloc/calloc/realloc的调用转到这里
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+void *__real_heap_caps_malloc(size_t size, uint32_t caps);
+
+void *__wrap_heap_caps_malloc(size_t size, uint32_t caps)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __real_heap_caps_malloc(size, caps);
+}
+#endif
+
+void bench_set_filter(const char *prefix)
+{
+    s_filter = prefix && *prefix ? prefix : NULL;
+}
+
+void bench_heap_snapshot(bench_heap_t *heap)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct mallinfo2 mi = mallinfo2();
+    heap->used_bytes = mi.uordblks;
+    heap->free_bytes = mi.fordblks;
+    heap->largest_free = 0;
+#else
+    heap->free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    heap->largest_free = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    heap->used_bytes = heap_caps_get_total_size(MALLOC_CAP_8BIT) - heap->free_bytes;
+#endif
+}
+
+static bool filtered_out(const char *name)
+{
+    return s_filter && strncmp(name, s_filter, strlen(s_filter)) != 0;
+}
+
+void bench_measure(const char *name, const char *fmt, ...)
+{
+    if (filtered_out(name)) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    printf("MEASURE %s ", name);
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+    fflush(stdout);
+}
+
+static int64_t time_iters(bench_fn_t fn, void *ctx, uint32_t iters)
+{
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < iters; i++) {
+        fn(ctx);
+    }
+    return esp_timer_get_time() - start;
+}
+
+double bench_run(const char *name, bench_fn_t fn, void *ctx, size_t bytes_per_op)
+{
+    if (filtered_out(name)) {
+        return 0;
+    }
+
+    // 预热: 填充缓存, 完成首次调用时的延迟初始化
+    fn(ctx);
+
+    // 每轮迭代次数加倍, 直到耗时超过最短测量时长的十分之一
+    uint32_t iters = 1;
+    int64_t elapsed = time_iters(fn, ctx, iters);
+    while (elapsed < BENCH_MIN_TIME_US / 10 && iters < BENCH_MAX_ITERS) {
+        iters *= 2;
+        elapsed = time_iters(fn, ctx, iters);
+    }
+    if (elapsed < BENCH_MIN_TIME_US) {
+        uint64_t scaled = (uint64_t)iters * BENCH_MIN_TIME_US / (elapsed > 0 ? elapsed : 1);
+        iters = scaled < BENCH_MAX_ITERS ? (uint32_t)scaled : BENCH_MAX_ITERS;
+    }
+
+    uint32_t allocs = atomic_load_explicit(&s_allocs, memory_order_relaxed);
+#if !CONFIG_IDF_TARGET_LINUX
+    uint32_t cycles = esp_cpu_get_cycle_count();
+#endif
+    elapsed = time_iters(fn, ctx, iters);
+#if !CONFIG_IDF_TARGET_LINUX
+    cycles = esp_cpu_get_cycle_count() - cycles;
+#endif
+    allocs = atomic_load_explicit(&s_allocs, memory_order_relaxed) - allocs;
+
+    double ns_per_op = elapsed * 1000.0 / iters;
+    printf("BENCH %s iters=%lu ns_per_op=%.1f bytes_per_op=%u allocs_per_op=%.2f",
+           name, (unsigned long)iters, ns_per_op, (unsigned)bytes_per_op,
+           (double)allocs / iters);
+#if !CONFIG_IDF_TARGET_LINUX
+    printf(" cycles_per_op=%.1f", (double)cycles / iters);
+#endif
+    printf("\n");
+    fflush(stdout);
+
+    // 让出CPU, 空闲任务得以运行
+    vTaskDelay(1);
+    return ns_per_op;
+}
@@ -0,0 +1,70 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * 微基准框架
+ *
+ * 每个用例先调用一次预热, 然后按耗时标定迭代次数, 使测量时长不少于
+ * BENCH_MIN_TIME_US, 最后输出一行:
+ *   BENCH <名字> iters=<次数> ns_per_op=<> bytes_per_op=<> allocs_per_op=<> [cycles_per_op=<>]
+ * cycles_per_op只在设备上输出. allocs_per_op统计经过malloc/calloc/realloc的次数,
+ * 设备上其它任务的分配也会计入, 测量时应保持系统空闲.
+ *
+ * 不计时的质量指标(频响, 堆碎片, 首段时间等)输出为:
+ *   MEASURE <名字> <键>=<值> ...
+ */
+
+/* 每个用例的最短测量时长(us) */
+#define BENCH_MIN_TIME_US       200000
+
+/* 标定时的迭代次数上限 */
+#define BENCH_MAX_ITERS         10000000
+
+/* 被测函数, 每次调用算一次操作 */
+typedef void (*bench_fn_t)(void *ctx);
+
+/**
+ * @brief 运行一个用例并输出结果
+ *
+ * @param name 用例名, 以模块名开头, 例如 "resampler.process"
+ * @param bytes_per_op 每次操作处理的输入字节数, 用于换算吞吐
+ * @return 每次操作的耗时(ns), 被过滤掉时为0
+ */
+double bench_run(const char *name, bench_fn_t fn, void *ctx, size_t bytes_per_op);
+
+/**
+ * @brief 输出一行MEASURE记录, 同样受用例名过滤
+ *
+ * @param name 指标名, 命名规则与用例相同
+ * @param fmt 键值对的格式串, 例如 "freq_hz=%u gain_db=%.1f"
+ */
+void bench_measure(const char *name, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief 堆状态快照
+ *
+ * 设备上是内部RAM(MALLOC_CAP_8BIT)的空闲字节数和最大空闲块;
+ * 主机上是glibc堆中已分配的字节数和堆内空闲(未归还系统的空洞)字节数, 没有最大空闲块.
+ */
+typedef struct {
+    size_t used_bytes;
+    size_t free_bytes;
+    size_t largest_free;
+} bench_heap_t;
+
+void bench_heap_snapshot(bench_heap_t *heap);
+
+/**
+ * @brief 只运行名字以此开头的用例, NULL表示全部
+ */
+void bench_set_filter(const char *prefix);
+
+/* 各组用例 */
+void bench_dsp(void);
+void bench_text(void);
+void bench_metrics(void);
+
+#endif /* BENCH_H */
@@ -0,0 +1,169 @@
+/*
+ * 音频内核基准: 重采样, VAD, 回声抑制, IMA-ADPCM编解码
+ *
+ * 输入是固定种子的噪声加音调, 每次操作处理采集任务中的一块数据.
+ * 另外用正弦扫频测量抽取器的实际频响(MEASURE resampler.*), 设备上走esp-dsp内核.
+ */
+
+#include "bench.h"
+#include <math.h>
+#include <string.h>
+#include "resampler.h"
+#include "vad.h"
+#include "aec.h"
+#include "audio_codec.h"
+#include "ima_adpcm.h"
+
+/* 麦克风每次读取的48kHz样本数(20ms) */
+#define BENCH_MIC_SAMPLES       960
+
+/* 频响测量: 正弦幅度和每个频点送入的块数(共200ms) */
+#define BENCH_TONE_AMPLITUDE    16000
+#define BENCH_TONE_BLOCKS       10
+
+/* 16kHz一帧(20ms) */
+#define BENCH_FRAME_SAMPLES     VAD_FRAME_SAMPLES
+
+static int16_t s_mic[BENCH_MIC_SAMPLES];
+static int16_t s_frame[BENCH_FRAME_SAMPLES];
+static int16_t s_ref[BENCH_FRAME_SAMPLES];
+static int16_t s_work[BENCH_MIC_SAMPLES];
+static uint8_t s_encoded[BENCH_FRAME_SAMPLES * sizeof(int16_t)];     // 容纳PCM16和ADPCM两种输出
+
+static resampler_t s_resampler;
+static vad_t s_vad;
+static aec_t s_aec;
+static ima_adpcm_state_t s_adpcm;
+static audio_encoder_t s_encoder;
+
+// 噪声加三角波, 幅度约为满量程的四分之一
+static void fill_signal(int16_t *pcm, size_t n, uint32_t seed, uint32_t period)
+{
+    uint32_t x = seed;
+    for (size_t i = 0; i < n; i++) {
+        x = x * 1664525u + 1013904223u;
+        int32_t noise = (int32_t)(x >> 20) - 2048;
+        int32_t phase = (int32_t)(i % period) * 2 * 8192 / (int32_t)period;
+        int32_t tri = phase < 8192 ? phase - 4096 : 12288 - phase;
+        pcm[i] = (int16_t)(noise + tri);
+    }
+}
+
+static void run_resampler(void *ctx)
+{
+    resampler_process(&s_resampler, s_mic, BENCH_MIC_SAMPLES, s_work);
+}
+
+static void run_resampler_ref(void *ctx)
+{
+    resampler_process_ref(&s_resampler, s_mic, BENCH_MIC_SAMPLES, s_work);
+}
+
+// 正弦经过抽取器后的增益(dB), 跳过滤波器填满历史之前的输出
+static double resampler_gain_db(uint32_t freq_hz)
+{
+    double in_power = 0;
+    double out_power = 0;
+    size_t out_count = 0;
+    size_t skip = RESAMPLER_TAPS / RESAMPLER_DECIMATION;
+
+    resampler_init(&s_resampler);
+    for (size_t b = 0; b < BENCH_TONE_BLOCKS; b++) {
+        for (size_t i = 0; i < BENCH_MIC_SAMPLES; i++) {
+            double t = (double)(b * BENCH_MIC_SAMPLES + i) / 48000.0;
+            s_mic[i] = (int16_t)lrint(BENCH_TONE_AMPLITUDE * sin(2.0 * M_PI * freq_hz * t));
+            in_power += (double)s_mic[i] * s_mic[i];
+        }
+        size_t n = resampler_process(&s_resampler, s_mic, BENCH_MIC_SAMPLES, s_work);
+        for (size_t i = 0; i < n; i++) {
+            if (skip) {
+                skip--;
+                continue;
+            }
+            out_power += (double)s_work[i] * s_work[i];
+            out_count++;
+        }
+    }
+    in_power /= BENCH_TONE_BLOCKS * BENCH_MIC_SAMPLES;
+    out_power /= out_count;
+    // 输出量化噪声约为-90dB, 低于此值的衰减测不出来
+    return 10.0 * log10((out_power + 1e-3) / in_power);
+}
+
+// 通带(<=6kHz)波动和阻带(>=10kHz, 会混叠进0~6kHz)的最小衰减
+static void measure_resampler(void)
+{
+    static const uint32_t freqs[] = {1000, 4000, 6000, 8000, 10000, 12500, 16500, 20000, 23000};
+    double ripple = 0;
+    double stopband = -200;
+
+    for (size_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+        double gain = resampler_gain_db(freqs[i]);
+        bench_measure("resampler.response", "freq_hz=%lu gain_db=%.1f", (unsigned long)freqs[i], gain);
+        if (freqs[i] <= 6000 && fabs(gain) > ripple) {
+            ripple = fabs(gain);
+        }
+        if (freqs[i] >= 10000 && gain > stopband) {
+            stopband = gain;
+        }
+    }
+    bench_measure("resampler.stopband", "passband_ripple_db=%.2f stopband_atten_db=%.1f", ripple, -stopband);
+}
+
+static void run_vad(void *ctx)
+{
+    vad_process_frame(&s_vad, s_frame);
+}
+
+// 每块先送参考信号再处理麦克风, 与播放/采集两个任务的节奏相同
+static void run_aec(void *ctx)
+{
+    aec_feed_reference(&s_aec, s_ref, BENCH_FRAME_SAMPLES);
+    memcpy(s_work, s_frame, sizeof(s_frame));
+    aec_process(&s_aec, s_work, BENCH_FRAME_SAMPLES);
+}
+
+static void run_adpcm_encode(void *ctx)
+{
+    ima_adpcm_encode_block(&s_adpcm, s_frame, BENCH_FRAME_SAMPLES, s_encoded);
+}
+
+static void run_adpcm_decode(void *ctx)
+{
+    ima_adpcm_decode_block(s_encoded, IMA_ADPCM_BLOCK_BYTES(BENCH_FRAME_SAMPLES), s_work);
+}
+
+static void run_encoder(void *ctx)
+{
+    audio_encoder_encode(&s_encoder, s_frame, BENCH_FRAME_SAMPLES, s_encoded);
+}
+
+void bench_dsp(void)
+{
+    fill_signal(s_mic, BENCH_MIC_SAMPLES, 1, 96);
+    fill_signal(s_frame, BENCH_FRAME_SAMPLES, 2, 32);
+    fill_signal(s_ref, BENCH_FRAME_SAMPLES, 3, 40);
+
+    resampler_init(&s_resampler);
+    bench_run("resampler.process", run_resampler, NULL, sizeof(s_mic));
+    resampler_init(&s_resampler);
+    bench_run("resampler.process_ref", run_resampler_ref, NULL, sizeof(s_mic));
+    measure_resampler();
+
+    vad_init(&s_vad);
+    bench_run("vad.process_frame", run_vad, NULL, sizeof(s_frame));
+
+    aec_init(&s_aec, AEC_MODE_GATE);
+    bench_run("aec.gate", run_aec, NULL, sizeof(s_frame));
+    aec_init(&s_aec, AEC_MODE_NLMS);
+    bench_run("aec.nlms", run_aec, NULL, sizeof(s_frame));
+
+    ima_adpcm_reset(&s_adpcm);
+    bench_run("codec.adpcm_encode", run_adpcm_encode, NULL, sizeof(s_frame));
+    bench_run("codec.adpcm_decode", run_adpcm_decode, NULL, IMA_ADPCM_BLOCK_BYTES(BENCH_FRAME_SAMPLES));
+
+    audio_encoder_init(&s_encoder, AUDIO_CODEC_PCM16);
+    bench_run("codec.encoder_pcm16", run_encoder, NULL, sizeof(s_frame));
+    audio_encoder_init(&s_encoder, AUDIO_CODEC_IMA_ADPCM);
+    bench_run("codec.encoder_adpcm", run_encoder, NULL, sizeof(s_frame));
+}
@@ -0,0 +1,32 @@
+/*
+ * 微基准入口
+ *
+ * 输出每个用例一行BENCH记录(格式见bench.h), 开头一行BENCH_INFO记录目标和IDF版本,
+ * 可用 tools/bench_compare.py 比较两次运行的结果.
+ * 主机上可用环境变量VOICE_BENCH_FILTER只运行名字以此开头的用例.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_system.h"
+#include "sdkconfig.h"
+#include "bench.h"
+
+#define BENCH_FILTER_ENV    "VOICE_BENCH_FILTER"
+
+void app_main(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    bench_set_filter(getenv(BENCH_FILTER_ENV));
+#endif
+    printf("BENCH_INFO target=%s idf=%s\n", CONFIG_IDF_TARGET, esp_get_idf_version());
+
+    bench_dsp();
+    bench_text();
+    bench_metrics();
+
+    printf("BENCH_DONE\n");
+#if CONFIG_IDF_TARGET_LINUX
+    exit(0);
+#endif
+}
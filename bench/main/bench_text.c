@@ -0,0 +1,469 @@
+/*
+ * 文本和协议处理基准: Ollama流式解析/分句/文本缓冲, FunASR结果处理, 合成缓存
+ *
+ * 消息内容按真实服务的格式构造: Ollama每个token一行NDJSON, 最后一行带context;
+ * FunASR的2pass-online中间结果和带时间戳的2pass-offline最终结果.
+ * funasr.*和ollama.reply经过客户端的事件处理函数(回放接口), 包含回调分发.
+ *
+ * ollama.long_reply_*: 1万个token的回复分别用改动前的realloc+strcat方式和现在的
+ * 文本缓冲区+分句累积, 除耗时外用MEASURE输出累积缓冲区的峰值, 扩容搬移次数和回复结束后的堆状态.
+ * 回复期间每隔若干token做一次不释放的小分配, 模拟其它模块穿插的分配, 以显示碎片.
+ *
+ * tts_cache.ttfs_*: 合成任务从拿到文本到送出首段PCM的耗时, 命中只需查找,
+ * 未命中要经过合成引擎合成第一段; MEASURE tts_cache.ttfs 把两者并列.
+ * 未命中用例只在主机上运行(用tts_engine_linux.c的音调合成, VOICE_TTS_RTF_PCT可模拟esp_tts的耗时),
+ * 设备上的esp_tts需要esp-sr和语音数据分区, 基准工程不带这两者.
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "cJSON.h"
+#include "esp_websocket_client.h"
+#include "esp_http_client.h"
+#include "funasr_main.h"
+#include "ollama_main.h"
+#include "ollama_ndjson.h"
+#include "ollama_chunker.h"
+#include "ollama_textbuf.h"
+#include "tts_cache.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include "tts_engine.h"
+#endif
+
+/* 回复中context数组的token数 */
+#define BENCH_CONTEXT_TOKENS    512
+
+/* 合成缓存基准中每段语音的长度(样本), 1秒 */
+#define BENCH_PHRASE_SAMPLES    16000
+
+#define BENCH_BLOCK_SAMPLES     320
+
+/* 未命中用例合成的文本 */
+#define BENCH_MISS_TEXT         "没有缓存的句子"
+
+/* 长回复基准的token数, 以及每隔多少个token穿插一次其它分配和它的大小 */
+#define BENCH_LONG_TOKENS       10000
+#define BENCH_OTHER_EVERY       64
+#define BENCH_OTHER_BYTES       48
+
+/* 长回复中不同的token数上限 */
+#define BENCH_TOKEN_TABLE       64
+
+static const char *s_reply_text = "今天天气很好，适合出去走走。你想去哪里呢？我可以帮你查一下路线，顺便看看附近有什么好吃的。";
+
+// 没有句号: 改动前要到回复结束才送出, 累积文本一直增长; 分句器在逗号处切分
+static const char *s_clause_text = "今天天气很好，适合出去走走，你想去哪里呢，我可以帮你查一下路线，顺便看看附近有什么好吃的，";
+
+static const char *s_funasr_partial =
+    "{\"mode\":\"2pass-online\",\"text\":\"今天天气\",\"wav_name\":\"mic\",\"is_final\":false}";
+
+static const char *s_funasr_final =
+    "{\"mode\":\"2pass-offline\",\"text\":\"今天天气怎么样\",\"wav_name\":\"mic\",\"is_final\":true,"
+    "\"timestamp\":\"[[430,670],[670,810],[810,1030],[1030,1250],[1250,1470],[1470,1690],[1690,2005]]\","
+    "\"stamp_sents\":[{\"text_seg\":\"今 天 天 气 怎 么 样\",\"punc\":\"\",\"start\":430,\"end\":2005,"
+    "\"ts_list\":[[430,670],[670,810],[810,1030],[1030,1250],[1250,1470],[1470,1690],[1690,2005]]}]}";
+
+static char s_stream[16 * 1024];        // 整个回复的NDJSON
+static size_t s_stream_len;
+static const char *s_lines[128];        // 每行起始位置
+static size_t s_line_lens[128];
+static size_t s_line_count;
+
+static ollama_ndjson_t s_parser;
+static int32_t s_context[BENCH_CONTEXT_TOKENS];
+static ollama_textbuf_t s_textbuf;
+static const ollama_chunker_config_t s_chunker = OLLAMA_CHUNKER_DEFAULT_CONFIG();
+static tts_cache_t s_cache;
+#if CONFIG_IDF_TARGET_LINUX
+static tts_engine_t *s_tts;
+#endif
+static int16_t s_pcm[BENCH_PHRASE_SAMPLES];
+static uint32_t s_sink;                 // 回调计数, 防止被优化掉
+
+static char s_tokens[BENCH_TOKEN_TABLE][8];     // 长回复按UTF-8字符循环取token
+static size_t s_token_count;
+static size_t s_long_bytes;                     // 长回复的总字节数
+
+typedef struct {
+    size_t peak_bytes;                  // 累积缓冲区占用的峰值
+    uint32_t moves;                     // 扩容时缓冲区地址改变的次数
+    void *others[(BENCH_LONG_TOKENS + BENCH_OTHER_EVERY - 1) / BENCH_OTHER_EVERY];
+    size_t other_count;
+} long_reply_probe_t;
+
+static void append_line(const char *fmt, const char *token, int done)
+{
+    const char *line = s_stream + s_stream_len;
+    int n = snprintf(s_stream + s_stream_len, sizeof(s_stream) - s_stream_len, fmt, token, done ? "true" : "false");
+    s_lines[s_line_count] = line;
+    s_line_lens[s_line_count] = (size_t)n;
+    s_line_count++;
+    s_stream_len += (size_t)n;
+}
+
+// 按UTF-8字符切成token, 每个token一行, 最后一行带context
+static void build_stream(void)
+{
+    static const char *fmt = "{\"model\":\"qwen:0.5b\",\"created_at\":\"2024-05-01T08:00:00.000000Z\","
+                             "\"response\":\"%s\",\"done\":%s}\n";
+    const char *p = s_reply_text;
+    char token[8];
+
+    s_stream_len = 0;
+    s_line_count = 0;
+    while (*p && s_line_count < 127) {
+        size_t n = 1;
+        while ((p[n] & 0xC0) == 0x80) {
+            n++;
+        }
+        memcpy(token, p, n);
+        token[n] = '\0';
+        append_line(fmt, token, 0);
+        p += n;
+    }
+
+    const char *line = s_stream + s_stream_len;
+    int n = snprintf(s_stream + s_stream_len, sizeof(s_stream) - s_stream_len,
+                     "{\"model\":\"qwen:0.5b\",\"created_at\":\"2024-05-01T08:00:01.000000Z\","
+                     "\"response\":\"\",\"done\":true,\"done_reason\":\"stop\",\"context\":[");
+    for (int i = 0; i < BENCH_CONTEXT_TOKENS; i++) {
+        n += snprintf(s_stream + s_stream_len + n, sizeof(s_stream) - s_stream_len - n,
+                      i ? ",%d" : "%d", 151644 - i * 37);
+    }
+    n += snprintf(s_stream + s_stream_len + n, sizeof(s_stream) - s_stream_len - n,
+                  "],\"total_duration\":812345678,\"eval_count\":%u}\n", (unsigned)s_line_count);
+    s_lines[s_line_count] = line;
+    s_line_lens[s_line_count] = (size_t)n;
+    s_line_count++;
+    s_stream_len += (size_t)n;
+}
+
+static void build_tokens(const char *text)
+{
+    const char *p = text;
+    s_token_count = 0;
+    while (*p && s_token_count < BENCH_TOKEN_TABLE) {
+        size_t n = 1;
+        while ((p[n] & 0xC0) == 0x80) {
+            n++;
+        }
+        memcpy(s_tokens[s_token_count], p, n);
+        s_tokens[s_token_count][n] = '\0';
+        s_token_count++;
+        p += n;
+    }
+    s_long_bytes = 0;
+    for (size_t i = 0; i < BENCH_LONG_TOKENS; i++) {
+        s_long_bytes += strlen(s_tokens[i % s_token_count]);
+    }
+}
+
+static void probe_other_alloc(long_reply_probe_t *probe, size_t i)
+{
+    if (probe && i % BENCH_OTHER_EVERY == 0) {
+        probe->others[probe->other_count++] = malloc(BENCH_OTHER_BYTES);
+    }
+}
+
+// 改用文本缓冲区之前的累积方式: 每个token realloc+strcat, 收到"。"或回复结束才送出
+static void long_reply_legacy(long_reply_probe_t *probe)
+{
+    char *acc = NULL;
+    size_t acc_len = 0;
+
+    for (size_t i = 0; i < BENCH_LONG_TOKENS; i++) {
+        const char *text = s_tokens[i % s_token_count];
+        probe_other_alloc(probe, i);
+        if (strcmp(text, "？") == 0) {
+            continue;
+        }
+        if (!acc) {
+            acc = strdup(text);
+            acc_len = acc ? strlen(text) : 0;
+        } else {
+            size_t new_len = acc_len + strlen(text);
+            uintptr_t old = (uintptr_t)acc;
+            char *p = realloc(acc, new_len + 1);
+            if (p) {
+                if (probe && (uintptr_t)p != old) {
+                    probe->moves++;
+                }
+                acc = p;
+                strcat(acc, text);
+                acc_len = new_len;
+            }
+        }
+        if (probe && acc_len + 1 > probe->peak_bytes) {
+            probe->peak_bytes = acc_len + 1;
+        }
+        if (strcmp(text, "。") == 0) {
+            s_sink += acc_len;
+            free(acc);
+            acc = NULL;
+            acc_len = 0;
+        }
+    }
+    s_sink += acc_len;
+    free(acc);
+}
+
+// 现在的方式: 预分配的文本缓冲区, 每个token后按子句切分送出(与emit_chunks相同)
+static void long_reply_textbuf(long_reply_probe_t *probe)
+{
+    bool first = true;
+
+    ollama_textbuf_reset(&s_textbuf);
+    for (size_t i = 0; i < BENCH_LONG_TOKENS; i++) {
+        const char *text = s_tokens[i % s_token_count];
+        size_t len = strlen(text);
+        uintptr_t old = (uintptr_t)s_textbuf.buf;
+        probe_other_alloc(probe, i);
+        if (!ollama_textbuf_append(&s_textbuf, text, len)) {
+            s_sink += ollama_textbuf_len(&s_textbuf);
+            ollama_textbuf_reset(&s_textbuf);
+            ollama_textbuf_append(&s_textbuf, text, len);
+        }
+        size_t cut;
+        while ((cut = ollama_chunker_find_cut(&s_chunker, ollama_textbuf_data(&s_textbuf),
+                                              ollama_textbuf_len(&s_textbuf), first)) > 0) {
+            s_sink += cut;
+            ollama_textbuf_consume(&s_textbuf, cut);
+            first = false;
+        }
+        if (probe) {
+            probe->moves += (uintptr_t)s_textbuf.buf != old;
+            if (s_textbuf.cap > probe->peak_bytes) {
+                probe->peak_bytes = s_textbuf.cap;
+            }
+        }
+    }
+    s_sink += ollama_textbuf_len(&s_textbuf);
+    ollama_textbuf_reset(&s_textbuf);
+}
+
+static void run_long_reply_legacy(void *ctx)
+{
+    long_reply_legacy(NULL);
+}
+
+static void run_long_reply_textbuf(void *ctx)
+{
+    long_reply_textbuf(NULL);
+}
+
+// 回复结束时其它模块的分配仍然保留, 此时的堆状态反映累积方式留下的空洞
+static void measure_long_reply(const char *name, void (*fn)(long_reply_probe_t *))
+{
+    static long_reply_probe_t probe;
+    bench_heap_t before;
+    bench_heap_t after;
+
+    memset(&probe, 0, sizeof(probe));
+    bench_heap_snapshot(&before);
+    fn(&probe);
+    bench_heap_snapshot(&after);
+
+    long used = (long)after.used_bytes - (long)before.used_bytes;
+    if (after.largest_free) {
+        bench_measure(name, "tokens=%u peak_bytes=%u moves=%lu used_delta=%ld free_bytes=%u largest_free=%u frag_pct=%.1f",
+                      BENCH_LONG_TOKENS, (unsigned)probe.peak_bytes, (unsigned long)probe.moves, used,
+                      (unsigned)after.free_bytes, (unsigned)after.largest_free,
+                      100.0 - 100.0 * after.largest_free / after.free_bytes);
+    } else {
+        // 主机上没有最大空闲块, 用回复前后堆内空洞的增量表示碎片
+        bench_measure(name, "tokens=%u peak_bytes=%u moves=%lu used_delta=%ld holes_delta=%ld",
+                      BENCH_LONG_TOKENS, (unsigned)probe.peak_bytes, (unsigned long)probe.moves, used,
+                      (long)after.free_bytes - (long)before.free_bytes);
+    }
+
+    for (size_t i = 0; i < probe.other_count; i++) {
+        free(probe.others[i]);
+    }
+}
+
+static void count_msg(const ollama_ndjson_msg_t *msg, void *ctx)
+{
+    s_sink += msg->response_len;
+}
+
+static void count_text(const char *text)
+{
+    s_sink++;
+}
+
+static void run_ndjson_reply(void *ctx)
+{
+    ollama_ndjson_set_context_buffer(&s_parser, s_context, BENCH_CONTEXT_TOKENS);
+    ollama_ndjson_init(&s_parser);
+    ollama_ndjson_feed(&s_parser, s_stream, s_stream_len, count_msg, NULL);
+}
+
+static void run_ndjson_line(void *ctx)
+{
+    ollama_ndjson_feed(&s_parser, s_lines[0], s_line_lens[0], count_msg, NULL);
+}
+
+// 改用增量解析之前的做法, 作为对照
+static void run_cjson_line(void *ctx)
+{
+    cJSON *root = cJSON_Parse(s_lines[0]);
+    cJSON *response = cJSON_GetObjectItem(root, "response");
+    if (cJSON_IsString(response)) {
+        s_sink += strlen(response->valuestring);
+    }
+    cJSON_Delete(root);
+}
+
+// 一次完整回复经过http_event_handler: 解析, 累积, 分句和回调
+static void run_ollama_reply(void *ctx)
+{
+    ollama_replay_begin();
+    for (size_t i = 0; i < s_line_count; i++) {
+        ollama_replay_event(HTTP_EVENT_ON_DATA, s_lines[i], (int)s_line_lens[i]);
+    }
+    ollama_replay_event(HTTP_EVENT_ON_FINISH, NULL, 0);
+}
+
+static void run_funasr_partial(void *ctx)
+{
+    funasr_replay_event(WEBSOCKET_EVENT_DATA, 0x01, s_funasr_partial, (int)strlen(s_funasr_partial));
+}
+
+static void run_funasr_final(void *ctx)
+{
+    funasr_replay_event(WEBSOCKET_EVENT_DATA, 0x01, s_funasr_final, (int)strlen(s_funasr_final));
+}
+
+// 在累积的文本中找切分点, emit_chunks每收到一个token调用一次
+static void run_chunker(void *ctx)
+{
+    const char *text = (const char *)ctx;
+    s_sink += ollama_chunker_find_cut(&s_chunker, text, strlen(text), false);
+}
+
+static void run_textbuf(void *ctx)
+{
+    if (!ollama_textbuf_append(&s_textbuf, "好", 3)) {
+        ollama_textbuf_reset(&s_textbuf);
+    }
+    if (ollama_textbuf_len(&s_textbuf) >= 36) {
+        ollama_textbuf_consume(&s_textbuf, 36);
+    }
+}
+
+// 命中时首段PCM就是查找的结果
+static void run_cache_hit(void *ctx)
+{
+    const int16_t *pcm;
+    size_t samples;
+    s_sink += tts_cache_lookup(&s_cache, "你好", &pcm, &samples);
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+// 未命中时合成任务送出首段PCM前的全部工作: 查找, 开始暂存, 合成第一段并暂存
+static void run_cache_miss(void *ctx)
+{
+    const int16_t *pcm;
+    size_t samples;
+    s_sink += tts_cache_lookup(&s_cache, BENCH_MISS_TEXT, &pcm, &samples);
+    tts_cache_begin(&s_cache, BENCH_MISS_TEXT);
+    if (tts_engine_begin(s_tts, BENCH_MISS_TEXT)) {
+        pcm = tts_engine_next(s_tts, &samples);
+        if (pcm) {
+            tts_cache_append(&s_cache, pcm, samples);
+            s_sink += samples;
+        }
+    }
+    tts_engine_reset(s_tts);
+    tts_cache_abort(&s_cache);
+}
+#endif
+
+// 整段写入缓存, 每次换一句, 预算满后淘汰最旧的
+static void run_cache_insert(void *ctx)
+{
+    static uint32_t n;
+    char text[24];
+    snprintf(text, sizeof(text), "句子%lu", (unsigned long)n++);
+    tts_cache_begin(&s_cache, text);
+    for (size_t i = 0; i < BENCH_PHRASE_SAMPLES; i += BENCH_BLOCK_SAMPLES) {
+        tts_cache_append(&s_cache, s_pcm + i, BENCH_BLOCK_SAMPLES);
+    }
+    tts_cache_commit(&s_cache);
+}
+
+void bench_text(void)
+{
+    build_stream();
+    ollama_ndjson_set_context_buffer(&s_parser, NULL, 0);
+    ollama_ndjson_init(&s_parser);
+
+    bench_run("ollama.ndjson_reply", run_ndjson_reply, NULL, s_stream_len);
+    ollama_ndjson_set_context_buffer(&s_parser, NULL, 0);
+    ollama_ndjson_init(&s_parser);
+    bench_run("ollama.ndjson_line", run_ndjson_line, NULL, s_line_lens[0]);
+    bench_run("ollama.cjson_line", run_cjson_line, NULL, s_line_lens[0]);
+
+    // 只分配缓冲区, 不连接服务器
+    if (ollama_init("http://127.0.0.1/api/generate") == ESP_OK) {
+        ollama_set_response_callback(count_text);
+        bench_run("ollama.reply", run_ollama_reply, NULL, s_stream_len);
+        ollama_cleanup();
+    }
+
+    funasr_set_result_callback(count_text);
+    bench_run("funasr.partial", run_funasr_partial, NULL, strlen(s_funasr_partial));
+    bench_run("funasr.final", run_funasr_final, NULL, strlen(s_funasr_final));
+
+    static const char *clause = "今天天气很好，适合出去走走";
+    static const char *no_punct = "今天天气很好适合出去走走你想去哪里呢我可以帮你查一下路线顺便看看附近有什么好吃的";
+    bench_run("chunker.clause", run_chunker, (void *)clause, strlen(clause));
+    bench_run("chunker.no_punct", run_chunker, (void *)no_punct, strlen(no_punct));
+
+    if (ollama_textbuf_init(&s_textbuf, OLLAMA_TEXTBUF_INITIAL, OLLAMA_TEXTBUF_HIGH_WATER) == ESP_OK) {
+        bench_run("textbuf.append_consume", run_textbuf, NULL, 3);
+
+        // 先测堆状态, 计时用例的反复分配会改变堆的布局
+        static const char *const texts[] = {"sentences", "clauses"};
+        const char *sources[] = {s_reply_text, s_clause_text};
+        char name[48];
+        for (int t = 0; t < 2; t++) {
+            build_tokens(sources[t]);
+            snprintf(name, sizeof(name), "ollama.long_reply_legacy.%s", texts[t]);
+            measure_long_reply(name, long_reply_legacy);
+            snprintf(name, sizeof(name), "ollama.long_reply_textbuf.%s", texts[t]);
+            measure_long_reply(name, long_reply_textbuf);
+            snprintf(name, sizeof(name), "ollama.long_reply_legacy.%s", texts[t]);
+            bench_run(name, run_long_reply_legacy, NULL, s_long_bytes);
+            snprintf(name, sizeof(name), "ollama.long_reply_textbuf.%s", texts[t]);
+            bench_run(name, run_long_reply_textbuf, NULL, s_long_bytes);
+        }
+        ollama_textbuf_deinit(&s_textbuf);
+    }
+
+    for (size_t i = 0; i < BENCH_PHRASE_SAMPLES; i++) {
+        s_pcm[i] = (int16_t)((i * 37) & 0x3fff);
+    }
+    if (tts_cache_init(&s_cache, 8 * BENCH_PHRASE_SAMPLES * sizeof(int16_t)) == ESP_OK) {
+        tts_cache_begin(&s_cache, "你好");
+        tts_cache_append(&s_cache, s_pcm, BENCH_PHRASE_SAMPLES);
+        tts_cache_commit(&s_cache);
+#if CONFIG_IDF_TARGET_LINUX
+        double hit_ns = bench_run("tts_cache.ttfs_hit", run_cache_hit, NULL, 0);
+        if (tts_engine_create(&s_tts) == ESP_OK) {
+            double miss_ns = bench_run("tts_cache.ttfs_miss", run_cache_miss, NULL, 0);
+            if (hit_ns > 0 && miss_ns > 0) {
+                bench_measure("tts_cache.ttfs", "hit_ns=%.1f miss_ns=%.1f miss_over_hit=%.0f",
+                              hit_ns, miss_ns, miss_ns / hit_ns);
+            }
+        }
+#else
+        bench_run("tts_cache.ttfs_hit", run_cache_hit, NULL, 0);
+#endif
+        bench_run("tts_cache.insert", run_cache_insert, NULL, sizeof(s_pcm));
+        tts_cache_deinit(&s_cache);
+    }
+}
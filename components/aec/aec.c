@@ -0,0 +1,316 @@
+/*
+ * 播放感知的回声抑制
+ *
+ * 喇叭播放TTS时麦克风仍在采集, 设备会把自己的声音发给FunASR,
+ * 甚至被自己触发. 这里用送往喇叭的PCM作为参考信号:
+ * - NLMS模式: 先用抽取后的互相关估计参考信号相对回声的整体时延,
+ *   按时延对齐后由定点NLMS自适应滤波器估计回声并从麦克风信号中减去,
+ *   双讲(近端说话)时冻结自适应
+ * - 门限模式/残余回声: 正在播放且没有近端说话时把输出衰减约30dB
+ */
+
+#include "aec.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_timer.h"
+
+esp_err_t aec_init(aec_t *aec, aec_mode_t mode)
+{
+    if (!aec) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(aec, 0, sizeof(*aec));
+    aec->mode = mode;
+    atomic_init(&aec->ref_head, 0);
+    atomic_init(&aec->ref_tail, 0);
+    atomic_init(&aec->ref_discard, 0);
+    return ESP_OK;
+}
+
+void aec_feed_reference(aec_t *aec, const int16_t *pcm, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&aec->ref_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&aec->ref_tail, memory_order_acquire);
+    size_t space = AEC_REF_RING - (head - tail);
+
+    if (len > space) {
+        aec->stats.ref_overflow += len - space;
+        len = space;
+    }
+    for (size_t i = 0; i < len; i++) {
+        aec->ref_ring[(head + i) & (AEC_REF_RING - 1)] = pcm[i];
+    }
+    atomic_store_explicit(&aec->ref_head, head + len, memory_order_release);
+}
+
+void aec_discard_reference(aec_t *aec)
+{
+    // 只有采集任务移动读指针, 这里记下作废位置由它来跳过
+    uint32_t head = atomic_load_explicit(&aec->ref_head, memory_order_relaxed);
+    atomic_store_explicit(&aec->ref_discard, head, memory_order_release);
+}
+
+// 取出n个参考样本, 不足部分补零
+static void pull_reference(aec_t *aec, int16_t *out, size_t n)
+{
+    uint32_t tail = atomic_load_explicit(&aec->ref_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&aec->ref_head, memory_order_acquire);
+    uint32_t discard = atomic_load_explicit(&aec->ref_discard, memory_order_acquire);
+
+    if ((int32_t)(discard - tail) > 0) {
+        tail = discard;
+    }
+    size_t avail = head - tail;
+    size_t take = avail < n ? avail : n;
+
+    for (size_t i = 0; i < take; i++) {
+        out[i] = aec->ref_ring[(tail + i) & (AEC_REF_RING - 1)];
+    }
+    if (take < n) {
+        memset(out + take, 0, (n - take) * sizeof(int16_t));
+        // 播放中途断流才算欠载, 完全空闲时不计
+        if (take > 0) {
+            aec->stats.ref_underflow += n - take;
+        }
+    }
+    atomic_store_explicit(&aec->ref_tail, tail + take, memory_order_release);
+}
+
+static int64_t block_energy(const int16_t *s, size_t n)
+{
+    int64_t e = 0;
+    for (size_t i = 0; i < n; i++) {
+        e += (int32_t)s[i] * s[i];
+    }
+    return n ? e / (int64_t)n : 0;
+}
+
+static inline int16_t saturate16(int32_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+// 参考和麦克风各抽取AEC_XCORR_DECIM倍, accumulate时把本块计入各时延的互相关.
+// ref是本块取出的参考(未按时延对齐), mic是NLMS之前的麦克风信号
+static void xcorr_block(aec_t *aec, const int16_t *ref, const int16_t *mic, size_t n, bool accumulate)
+{
+    int16_t mic_dec[AEC_BLOCK / AEC_XCORR_DECIM + 1];
+    int16_t *ref_dec = &aec->xc_ref[AEC_XCORR_LAGS];
+    size_t m = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        aec->xc_ref_acc += ref[i];
+        aec->xc_mic_acc += mic[i];
+        if (++aec->xc_phase == AEC_XCORR_DECIM) {
+            ref_dec[m] = (int16_t)(aec->xc_ref_acc / AEC_XCORR_DECIM);
+            mic_dec[m] = (int16_t)(aec->xc_mic_acc / AEC_XCORR_DECIM);
+            m++;
+            aec->xc_ref_acc = 0;
+            aec->xc_mic_acc = 0;
+            aec->xc_phase = 0;
+        }
+    }
+
+    if (accumulate) {
+        for (size_t j = 0; j < m; j++) {
+            // 麦克风第j点与lag个抽取点之前的参考相乘
+            const int16_t *r = &ref_dec[j];
+            int32_t v = mic_dec[j];
+            for (int lag = 0; lag < AEC_XCORR_LAGS; lag++) {
+                aec->xc_corr[lag] += (int32_t)r[-lag] * v;
+            }
+        }
+    }
+
+    // 保留最近AEC_XCORR_LAGS个抽取点作为下一块的历史
+    memmove(aec->xc_ref, aec->xc_ref + m, AEC_XCORR_LAGS * sizeof(int16_t));
+}
+
+// 累计够AEC_XCORR_BLOCKS块后判决: 峰值足够突出且与当前时延不同时采用,
+// 时延改变后原有系数不再对应回声路径, 滤波器从零重新收敛
+static void xcorr_update_delay(aec_t *aec)
+{
+    if (++aec->xc_blocks < AEC_XCORR_BLOCKS) {
+        return;
+    }
+    aec->xc_blocks = 0;
+
+    int64_t peak = 0;
+    int64_t sum = 0;
+    int peak_lag = 0;
+    for (int lag = 0; lag < AEC_XCORR_LAGS; lag++) {
+        int64_t a = llabs(aec->xc_corr[lag]);
+        sum += a;
+        if (a > peak) {
+            peak = a;
+            peak_lag = lag;
+        }
+    }
+    memset(aec->xc_corr, 0, sizeof(aec->xc_corr));
+
+    if (peak == 0 || peak * AEC_XCORR_LAGS * 256 <= sum * AEC_XCORR_PEAK_Q8) {
+        return;
+    }
+    int32_t delay = peak_lag * AEC_XCORR_DECIM - AEC_DELAY_MARGIN;
+    if (delay < 0) {
+        delay = 0;
+    }
+    if (abs(delay - (int32_t)aec->delay) <= AEC_XCORR_DECIM) {
+        return;
+    }
+    aec->delay = (uint32_t)delay;
+    memset(aec->w, 0, sizeof(aec->w));
+    aec->stats.erle_q8 = 0;
+    aec->stats.delay_samples = aec->delay;
+    aec->stats.delay_updates++;
+}
+
+// 对一块(不超过AEC_BLOCK)做NLMS, 返回回声估计的能量
+static int64_t nlms_block(aec_t *aec, int16_t *mic, size_t n)
+{
+    // 正则项: 参考信号很小时避免步长过大
+    const int64_t delta = (int64_t)AEC_TAPS * 1024;
+    // x[i]是按整体时延与mic[i]对齐的参考样本
+    const int16_t *x = &aec->x[AEC_HISTORY - aec->delay];
+    int64_t echo_energy = 0;
+    bool adapt = !aec->doubletalk;
+
+    // 每块从历史重算窗口能量, 时延改变后也不会带入旧窗口的误差
+    aec->x_energy = 0;
+    for (int k = 1; k <= AEC_TAPS; k++) {
+        aec->x_energy += (int32_t)x[-k] * x[-k];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        // 窗口为 x[i-AEC_TAPS+1 .. i], 最新样本在 x[i], 移出的样本为 x[i-AEC_TAPS]
+        const int16_t *newest = &x[i];
+        int32_t in = *newest;
+        int32_t out_old = x[(int)i - AEC_TAPS];
+        aec->x_energy += in * in - out_old * out_old;
+
+        int64_t acc = 0;
+        for (int k = 0; k < AEC_TAPS; k++) {
+            acc += (int64_t)aec->w[k] * newest[-k];
+        }
+        int32_t y = (int32_t)(acc >> 28);
+        int32_t e = mic[i] - y;
+        echo_energy += (int64_t)y * y;
+
+        // x_energy是AEC_TAPS个样本之和, 门限按每样本均方值换算
+        if (adapt && aec->x_energy > (int64_t)AEC_REF_ACTIVE_ENERGY * AEC_TAPS) {
+            // w += mu * e * x / (|x|^2 + delta), Q28
+            int64_t g = ((int64_t)AEC_MU_Q15 * e * 8192) / (aec->x_energy + delta);
+            if (g > 32767) {
+                g = 32767;
+            } else if (g < -32767) {
+                g = -32767;
+            }
+            int32_t g32 = (int32_t)g;
+            for (int k = 0; k < AEC_TAPS; k++) {
+                aec->w[k] += g32 * newest[-k];
+            }
+        }
+
+        mic[i] = saturate16(e);
+    }
+
+    return n ? echo_energy / (int64_t)n : 0;
+}
+
+void aec_process(aec_t *aec, int16_t *mic, size_t len)
+{
+    if (aec->mode == AEC_MODE_OFF) {
+        return;
+    }
+
+    while (len > 0) {
+        size_t n = len > AEC_BLOCK ? AEC_BLOCK : len;
+        int64_t start_us = esp_timer_get_time();
+
+        int16_t *ref = &aec->x[AEC_HISTORY];
+        pull_reference(aec, ref, n);
+        // 门限和双讲判决都用按时延对齐后的参考, 即此刻麦克风中回声对应的部分
+        int64_t ref_energy = block_energy(ref - aec->delay, n);
+        int64_t mic_energy = block_energy(mic, n);
+
+        int64_t echo_energy = 0;
+        int64_t residual_energy = mic_energy;
+        if (aec->mode == AEC_MODE_NLMS) {
+            // 播放期间累计互相关. 双讲时也累计: 近端语音与参考无关, 只抬高平均幅度;
+            // 而回声路径突变在收敛后的滤波器看来就像双讲, 不能因此停止估计
+            bool estimate = aec->gate_hold > 0;
+            xcorr_block(aec, ref, mic, n, estimate);
+            if (estimate) {
+                xcorr_update_delay(aec);
+            }
+            echo_energy = nlms_block(aec, mic, n);
+            residual_energy = block_energy(mic, n);
+        }
+
+        // 播放中才需要门限, 停止后再保持一段时间覆盖房间混响
+        if (ref_energy > AEC_REF_ACTIVE_ENERGY) {
+            aec->gate_hold = AEC_GATE_HANGOVER;
+        } else if (aec->gate_hold > 0) {
+            aec->gate_hold--;
+        }
+
+        // 滤波器收敛后, 残差相对回声估计明显偏大说明近端有人说话;
+        // 未收敛时残差本身就很大, 只能按参考能量粗略估计回声
+        bool near_talk;
+        if (aec->mode == AEC_MODE_NLMS &&
+            aec->stats.erle_q8 > AEC_CONVERGED_ERLE_Q8) {
+            near_talk = residual_energy * 256 > echo_energy * AEC_DOUBLETALK_Q8;
+        } else {
+            int64_t expected = ref_energy * AEC_GATE_COUPLING_Q8 / 256;
+            near_talk = mic_energy * 256 > expected * AEC_GATE_MARGIN_Q8;
+        }
+        aec->doubletalk = aec->gate_hold > 0 && near_talk &&
+                          residual_energy > AEC_REF_ACTIVE_ENERGY;
+
+        // 只在单讲(仅有回声)时更新ERLE估计
+        if (aec->mode == AEC_MODE_NLMS && !aec->doubletalk &&
+            ref_energy > AEC_REF_ACTIVE_ENERGY) {
+            int64_t erle = mic_energy * 256 / (residual_energy + 1);
+            if (erle > 65535) {
+                erle = 65535;
+            }
+            aec->stats.erle_q8 += ((int32_t)erle - (int32_t)aec->stats.erle_q8) / 8;
+        }
+
+        if (aec->doubletalk) {
+            aec->stats.doubletalk_blocks++;
+        } else if (aec->gate_hold > 0) {
+            for (size_t i = 0; i < n; i++) {
+                mic[i] = (int16_t)(((int32_t)mic[i] * AEC_GATE_ATTEN_Q15) >> 15);
+            }
+            aec->stats.gated_blocks++;
+        }
+
+        // 保留最后AEC_HISTORY个参考样本作为下一块的历史
+        memmove(aec->x, aec->x + n, AEC_HISTORY * sizeof(int16_t));
+
+        uint32_t cost = (uint32_t)(esp_timer_get_time() - start_us);
+        aec->stats.last_block_us = cost;
+        if (cost > aec->stats.max_block_us) {
+            aec->stats.max_block_us = cost;
+        }
+        aec->stats.blocks++;
+
+        mic += n;
+        len -= n;
+    }
+}
+
+void aec_get_stats(const aec_t *aec, aec_stats_t *stats)
+{
+    if (stats) {
+        *stats = aec->stats;
+    }
+}
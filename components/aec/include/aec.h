@@ -0,0 +1,156 @@
+#ifndef AEC_H
+#define AEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+
+/* 每次处理的最大样本数(20ms @ 16kHz) */
+#define AEC_BLOCK               320
+
+/* NLMS滤波器长度(256 = 16ms回声路径) */
+#ifndef AEC_TAPS
+#define AEC_TAPS                256
+#endif
+
+/* 参考信号环形缓冲区长度(样本, 2的幂), 需大于喇叭DMA深度 */
+#define AEC_REF_RING            16384
+
+/* NLMS步长(Q15, 8192 = 0.25) */
+#define AEC_MU_Q15              8192
+
+/* 参考信号能量(每样本均方值)超过该值视为正在播放 */
+#define AEC_REF_ACTIVE_ENERGY   10000
+
+/* 参考信号相对回声的最大提前量(样本, 4096 = 256ms), 覆盖喇叭DMA,
+ * 采集块(2880样本@48kHz)和声学路径造成的整体时延 */
+#define AEC_DELAY_MAX           4096
+
+/* 整体时延估计: 参考和麦克风各按该倍数平均抽取后做互相关 */
+#define AEC_XCORR_DECIM         8
+#define AEC_XCORR_LAGS          (AEC_DELAY_MAX / AEC_XCORR_DECIM)
+
+/* 播放期间每累计多少块判决一次时延(25 x 20ms) */
+#define AEC_XCORR_BLOCKS        25
+
+/* 互相关峰值超过平均幅度的该倍数才采用(Q8, 1536 = 6倍) */
+#define AEC_XCORR_PEAK_Q8       1536
+
+/* 补偿时延后让回声峰值落在滤波器窗口内的余量(样本) */
+#define AEC_DELAY_MARGIN        32
+
+/* 参考历史长度: 最大时延 + 滤波器窗口 */
+#define AEC_HISTORY             (AEC_DELAY_MAX + AEC_TAPS)
+
+/* 播放停止后门限保持的块数(10 x 20ms) */
+#define AEC_GATE_HANGOVER       10
+
+/* 门限衰减系数(Q15, 1024 约-30dB) */
+#define AEC_GATE_ATTEN_Q15      1024
+
+/* 滤波器收敛后, 残差能量超过回声估计能量的该比例判为双讲(Q8, 64 = 1/4) */
+#define AEC_DOUBLETALK_Q8       64
+
+/* 回声抑制比(ERLE)超过该值视为已收敛(Q8, 1024 = 6dB) */
+#define AEC_CONVERGED_ERLE_Q8   1024
+
+/* 门限模式(或未收敛)下, 麦克风能量与参考能量之比的回声耦合估计(Q8, 256 = 1倍) */
+#define AEC_GATE_COUPLING_Q8    256
+
+/* 门限模式(或未收敛)下, 麦克风能量超过估计回声多少倍判为双讲(Q8, 1024 = 4倍) */
+#define AEC_GATE_MARGIN_Q8      1024
+
+/**
+ * @brief 工作模式
+ */
+typedef enum {
+    AEC_MODE_OFF = 0,       // 直通
+    AEC_MODE_GATE,          // 只做参考信号驱动的半双工门限
+    AEC_MODE_NLMS,          // NLMS回声消除 + 残余回声门限
+} aec_mode_t;
+
+/**
+ * @brief 统计信息
+ */
+typedef struct {
+    uint32_t blocks;            // 处理的块数
+    uint32_t gated_blocks;      // 被门限衰减的块数
+    uint32_t doubletalk_blocks; // 判为双讲(近端说话)的块数
+    uint32_t ref_overflow;      // 参考缓冲区满丢弃的样本数
+    uint32_t ref_underflow;     // 参考数据不足补零的样本数
+    uint32_t last_block_us;     // 最近一块的处理耗时
+    uint32_t max_block_us;      // 最大单块处理耗时
+    uint32_t erle_q8;           // 平滑后的回声抑制比(麦克风/残差能量, Q8)
+    uint32_t delay_samples;     // 当前补偿的参考信号整体时延
+    uint32_t delay_updates;     // 时延估计改变的次数
+} aec_stats_t;
+
+/**
+ * @brief 回声抑制器状态
+ *
+ * 参考信号环形缓冲区由播放任务写入、采集任务读取(单生产者/单消费者).
+ * 采集端每处理一个麦克风样本就取出一个参考样本. 参考在写入喇叭DMA时进入缓冲区,
+ * 回声要等DMA播出, 经过声学路径, 再随下一个采集块被读到, 因此取出的参考
+ * 比麦克风中的回声提前几十到一百多毫秒, 远超NLMS窗口(AEC_TAPS).
+ * 采集端用抽取后的互相关估计这段整体时延, 从参考历史中按时延取样送入NLMS,
+ * 滤波器只需覆盖剩下的房间回声路径.
+ */
+typedef struct {
+    aec_mode_t mode;
+
+    int16_t ref_ring[AEC_REF_RING];
+    _Atomic uint32_t ref_head;      // 播放任务写
+    _Atomic uint32_t ref_tail;      // 采集任务读
+    _Atomic uint32_t ref_discard;   // 播放被打断时, 此位置之前的参考数据作废
+
+    int16_t x[AEC_HISTORY + AEC_BLOCK]; // 参考历史 + 本块参考
+    int32_t w[AEC_TAPS];                // 滤波器系数(Q28), w[0]对应最新样本
+    int64_t x_energy;                   // 滤波窗口内参考信号能量(AEC_TAPS个样本之和)
+    uint32_t delay;                     // 参考信号整体时延(样本), 滤波器窗口从x[末尾 - delay]往前
+
+    // 整体时延估计
+    int16_t xc_ref[AEC_XCORR_LAGS + AEC_BLOCK / AEC_XCORR_DECIM + 1];  // 抽取后的参考历史
+    int64_t xc_corr[AEC_XCORR_LAGS];    // 各时延的互相关累计
+    int32_t xc_ref_acc;                 // 未凑满一个抽取点的样本和
+    int32_t xc_mic_acc;
+    uint32_t xc_phase;                  // 已累计的样本数(0..AEC_XCORR_DECIM-1)
+    uint32_t xc_blocks;                 // 本轮累计的有效块数
+
+    int gate_hold;                      // 门限剩余保持块数
+    bool doubletalk;                    // 上一块是否判为双讲
+
+    aec_stats_t stats;
+} aec_t;
+
+/**
+ * @brief 初始化(或复位)
+ */
+esp_err_t aec_init(aec_t *aec, aec_mode_t mode);
+
+/**
+ * @brief 写入送往喇叭的PCM(16kHz), 由播放任务调用
+ */
+void aec_feed_reference(aec_t *aec, const int16_t *pcm, size_t len);
+
+/**
+ * @brief 丢弃已写入但不会再播出的参考数据(喇叭DMA被清零时由播放任务调用)
+ */
+void aec_discard_reference(aec_t *aec);
+
+/**
+ * @brief 处理一段麦克风信号(16kHz), 原地输出去除回声后的信号, 由采集任务调用
+ *
+ * @param aec 回声抑制器
+ * @param mic 麦克风样本, 处理结果写回此处
+ * @param len 样本数, 任意长度(内部按AEC_BLOCK分块)
+ */
+void aec_process(aec_t *aec, int16_t *mic, size_t len);
+
+/**
+ * @brief 获取统计信息
+ */
+void aec_get_stats(const aec_t *aec, aec_stats_t *stats);
+
+#endif /* AEC_H */
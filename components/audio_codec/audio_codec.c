@@ -0,0 +1,86 @@
+/*
+ * 上传音频编码器
+ *
+ * 在WebSocket发送前插入一级编码, 编码方式通过audio_encoder_ops_t接入.
+ */
+
+#include "audio_codec.h"
+
+#include <string.h>
+
+static size_t pcm16_max_bytes(size_t samples)
+{
+    return samples * sizeof(int16_t);
+}
+
+static size_t pcm16_encode(audio_encoder_t *enc, const int16_t *pcm, size_t samples, uint8_t *out)
+{
+    memcpy(out, pcm, samples * sizeof(int16_t));
+    return samples * sizeof(int16_t);
+}
+
+static void pcm16_reset(audio_encoder_t *enc)
+{
+}
+
+static size_t adpcm_max_bytes(size_t samples)
+{
+    return IMA_ADPCM_BLOCK_BYTES(samples);
+}
+
+static size_t adpcm_encode(audio_encoder_t *enc, const int16_t *pcm, size_t samples, uint8_t *out)
+{
+    return ima_adpcm_encode_block(&enc->adpcm, pcm, samples, out);
+}
+
+static void adpcm_reset(audio_encoder_t *enc)
+{
+    ima_adpcm_reset(&enc->adpcm);
+}
+
+static const audio_encoder_ops_t s_pcm16_ops = {
+    .wav_format = "pcm",
+    .max_encoded_bytes = pcm16_max_bytes,
+    .encode = pcm16_encode,
+    .reset = pcm16_reset,
+};
+
+static const audio_encoder_ops_t s_adpcm_ops = {
+    .wav_format = "ima_adpcm",
+    .max_encoded_bytes = adpcm_max_bytes,
+    .encode = adpcm_encode,
+    .reset = adpcm_reset,
+};
+
+esp_err_t audio_encoder_init(audio_encoder_t *enc, audio_codec_type_t type)
+{
+    if (!enc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(enc, 0, sizeof(*enc));
+    switch (type) {
+        case AUDIO_CODEC_PCM16:
+            enc->ops = &s_pcm16_ops;
+            break;
+        case AUDIO_CODEC_IMA_ADPCM:
+            enc->ops = &s_adpcm_ops;
+            break;
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+    enc->ops->reset(enc);
+    return ESP_OK;
+}
+
+size_t audio_encoder_encode(audio_encoder_t *enc, const int16_t *pcm, size_t samples, uint8_t *out)
+{
+    size_t bytes = enc->ops->encode(enc, pcm, samples, out);
+    enc->samples_in += samples;
+    enc->bytes_out += bytes;
+    return bytes;
+}
+
+void audio_encoder_reset(audio_encoder_t *enc)
+{
+    enc->ops->reset(enc);
+}
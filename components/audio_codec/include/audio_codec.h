@@ -0,0 +1,70 @@
+#ifndef AUDIO_CODEC_H
+#define AUDIO_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "ima_adpcm.h"
+
+/**
+ * @brief 上传编码类型
+ */
+typedef enum {
+    AUDIO_CODEC_PCM16 = 0,      // 原始16位PCM, 256kbit/s
+    AUDIO_CODEC_IMA_ADPCM,      // IMA-ADPCM 4:1, 约64kbit/s
+} audio_codec_type_t;
+
+typedef struct audio_encoder audio_encoder_t;
+
+/**
+ * @brief 编码器接口, 新的编码方式实现这组函数即可接入上传路径
+ */
+typedef struct {
+    const char *wav_format;                             // 开始帧中的wav_format字段
+    size_t (*max_encoded_bytes)(size_t samples);        // 编码后的最大字节数
+    size_t (*encode)(audio_encoder_t *enc, const int16_t *pcm, size_t samples, uint8_t *out);
+    void (*reset)(audio_encoder_t *enc);                // 每段语音开始时复位
+} audio_encoder_ops_t;
+
+/**
+ * @brief 编码器实例
+ */
+struct audio_encoder {
+    const audio_encoder_ops_t *ops;
+    ima_adpcm_state_t adpcm;
+    uint32_t samples_in;        // 累计输入样本数
+    uint32_t bytes_out;         // 累计输出字节数
+};
+
+/**
+ * @brief 按类型初始化编码器
+ */
+esp_err_t audio_encoder_init(audio_encoder_t *enc, audio_codec_type_t type);
+
+/**
+ * @brief 编码一块PCM, 返回输出字节数
+ */
+size_t audio_encoder_encode(audio_encoder_t *enc, const int16_t *pcm, size_t samples, uint8_t *out);
+
+/**
+ * @brief 复位编码状态
+ */
+void audio_encoder_reset(audio_encoder_t *enc);
+
+/**
+ * @brief 编码后的最大字节数
+ */
+static inline size_t audio_encoder_max_bytes(const audio_encoder_t *enc, size_t samples)
+{
+    return enc->ops->max_encoded_bytes(samples);
+}
+
+/**
+ * @brief 开始帧中声明的音频格式
+ */
+static inline const char *audio_encoder_format(const audio_encoder_t *enc)
+{
+    return enc->ops->wav_format;
+}
+
+#endif /* AUDIO_CODEC_H */
@@ -0,0 +1,53 @@
+#ifndef IMA_ADPCM_H
+#define IMA_ADPCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* 块头: 预测值(int16, 小端) + 步长索引(uint8) + 标志(uint8) */
+#define IMA_ADPCM_HEADER_BYTES  4
+
+/* 标志位: 样本数为奇数, 最后一个字节的高4位是填充 */
+#define IMA_ADPCM_FLAG_ODD      0x01
+
+/* n个样本编码后的最大字节数 */
+#define IMA_ADPCM_BLOCK_BYTES(n)    (IMA_ADPCM_HEADER_BYTES + ((n) + 1) / 2)
+
+/**
+ * @brief 编码/解码状态
+ */
+typedef struct {
+    int16_t predictor;
+    uint8_t index;
+} ima_adpcm_state_t;
+
+/**
+ * @brief 复位状态
+ */
+void ima_adpcm_reset(ima_adpcm_state_t *state);
+
+/**
+ * @brief 编码一块PCM(4:1)
+ *
+ * 每块开头写入编码前的状态, 因此每块都可以独立解码,
+ * 上传队列丢帧不会让后续音频解码错乱. 样本按低4位在前打包.
+ *
+ * @param state 编码状态, 跨块保持
+ * @param pcm 16位PCM
+ * @param samples 样本数
+ * @param out 输出缓冲区, 至少IMA_ADPCM_BLOCK_BYTES(samples)字节
+ * @return 输出字节数
+ */
+size_t ima_adpcm_encode_block(ima_adpcm_state_t *state, const int16_t *pcm, size_t samples, uint8_t *out);
+
+/**
+ * @brief 解码一块
+ *
+ * @param in 编码数据(含块头)
+ * @param len 字节数
+ * @param pcm 输出缓冲区, 至少(len - IMA_ADPCM_HEADER_BYTES) * 2个样本
+ * @return 输出样本数, 数据不完整返回0
+ */
+size_t ima_adpcm_decode_block(const uint8_t *in, size_t len, int16_t *pcm);
+
+#endif /* IMA_ADPCM_H */
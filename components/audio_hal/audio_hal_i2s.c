@@ -0,0 +1,108 @@
+/*
+ * 设备端音频输入输出: 两路I2S, 麦克风和喇叭各占一个端口
+ */
+
+#include "audio_hal.h"
+#include "driver/i2s.h"
+#include "esp_log.h"
+
+static const char *TAG = "AUDIO_HAL";
+
+#define AUDIO_HAL_MIC_PORT      I2S_NUM_0
+#define AUDIO_HAL_SPK_PORT      I2S_NUM_1
+
+esp_err_t audio_hal_init(const audio_hal_config_t *cfg)
+{
+    if (!cfg) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // MIC I2S配置
+    i2s_config_t i2s_mic_config = {
+        .mode = I2S_MODE_MASTER | I2S_MODE_RX,
+        .sample_rate = cfg->mic_sample_rate,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,  // 单声道
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = 8,        // 增加DMA缓冲区数量
+        .dma_buf_len = 1024,       // 增加DMA缓冲区长度
+        .use_apll = true,          // 使用APLL提供更精确的采样率
+        .tx_desc_auto_clear = false,
+        .fixed_mclk = 0
+    };
+
+    // 喇叭I2S配置
+    i2s_config_t i2s_spk_config = {
+        .mode = I2S_MODE_MASTER | I2S_MODE_TX,
+        .sample_rate = cfg->spk_sample_rate,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = 8,
+        .dma_buf_len = 1024,
+        .use_apll = true,  // 使用APLL获得更准确的时钟
+        .tx_desc_auto_clear = true,
+        .fixed_mclk = 0
+    };
+
+    // MIC I2S引脚配置
+    i2s_pin_config_t mic_pin_config = {
+        .bck_io_num = cfg->mic_bck_io,
+        .ws_io_num = cfg->mic_ws_io,
+        .data_out_num = -1,
+        .data_in_num = cfg->mic_data_io
+    };
+
+    // 喇叭I2S引脚配置
+    i2s_pin_config_t spk_pin_config = {
+        .bck_io_num = cfg->spk_bck_io,
+        .ws_io_num = cfg->spk_ws_io,
+        .data_out_num = cfg->spk_data_io,
+        .data_in_num = -1
+    };
+
+    esp_err_t err = i2s_driver_install(AUDIO_HAL_MIC_PORT, &i2s_mic_config, 0, NULL);
+    if (err == ESP_OK) {
+        err = i2s_set_pin(AUDIO_HAL_MIC_PORT, &mic_pin_config);
+    }
+    if (err == ESP_OK) {
+        err = i2s_driver_install(AUDIO_HAL_SPK_PORT, &i2s_spk_config, 0, NULL);
+    }
+    if (err == ESP_OK) {
+        err = i2s_set_pin(AUDIO_HAL_SPK_PORT, &spk_pin_config);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "I2S初始化失败: %s", esp_err_to_name(err));
+        audio_hal_deinit();
+    }
+    return err;
+}
+
+esp_err_t audio_hal_mic_read(int16_t *buf, size_t samples, size_t *read, TickType_t wait)
+{
+    size_t bytes_read = 0;
+    esp_err_t err = i2s_read(AUDIO_HAL_MIC_PORT, buf, samples * sizeof(int16_t), &bytes_read, wait);
+    *read = bytes_read / sizeof(int16_t);
+    return err;
+}
+
+esp_err_t audio_hal_spk_write(const int16_t *buf, size_t samples, size_t *written, TickType_t wait)
+{
+    size_t bytes_written = 0;
+    esp_err_t err = i2s_write(AUDIO_HAL_SPK_PORT, buf, samples * sizeof(int16_t), &bytes_written, wait);
+    *written = bytes_written / sizeof(int16_t);
+    return err;
+}
+
+esp_err_t audio_hal_spk_clear(void)
+{
+    return i2s_zero_dma_buffer(AUDIO_HAL_SPK_PORT);
+}
+
+void audio_hal_deinit(void)
+{
+    i2s_driver_uninstall(AUDIO_HAL_MIC_PORT);
+    i2s_driver_uninstall(AUDIO_HAL_SPK_PORT);
+}
@@ -0,0 +1,373 @@
+/*
+ * 主机(linux目标)音频输入输出
+ *
+ * 麦克风: 读入WAV文件, 按整数倍线性插值到麦克风采样率, 以实时速率交付;
+ * 读取方来晚时和设备一样只保留DMA深度内的样本, 其余丢弃.
+ * 喇叭: 模拟DMA缓冲(满时写入阻塞, 清空时丢弃未播出的部分),
+ * 按播放时间线写入WAV文件, 断流处补静音, 便于和输入对齐测量应答延迟.
+ * 两条时间线都从audio_hal_init开始计时.
+ */
+
+#include "audio_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+static const char *TAG = "AUDIO_HAL";
+
+/* 麦克风DMA缓冲的样本数, 读取方来晚时超出部分被丢弃 */
+#define AUDIO_HAL_MIC_DMA_SAMPLES   (8 * 1024)
+
+static int64_t s_t0_us;
+
+// 麦克风输入
+static int16_t *s_src;              // WAV第一声道
+static size_t s_src_len;
+static uint32_t s_upsample = 1;     // 麦克风采样率 / 文件采样率
+static uint32_t s_mic_rate;
+static uint64_t s_mic_pos;          // 已交付(含丢弃)的样本数
+static uint64_t s_mic_total;        // 插值后的样本数 + 静音尾巴, 0表示无文件(一直是静音)
+
+// 喇叭输出
+static SemaphoreHandle_t s_spk_lock;
+static FILE *s_spk_fp;
+static uint32_t s_spk_rate;
+static int16_t s_spk_dma[AUDIO_HAL_SPK_DMA_SAMPLES];
+static size_t s_spk_pending;        // DMA中尚未播出的样本数
+static uint64_t s_spk_played;       // 已按时间线写入文件的样本数
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 时间线上t时刻对应的样本位置
+static uint64_t timeline_samples(int64_t t, uint32_t rate)
+{
+    if (t <= s_t0_us) {
+        return 0;
+    }
+    return (uint64_t)(t - s_t0_us) * rate / 1000000;
+}
+
+static void sleep_until(int64_t t)
+{
+    int64_t now = now_us();
+    if (t > now) {
+        TickType_t ticks = pdMS_TO_TICKS((t - now + 999) / 1000);
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+}
+
+static uint16_t rd16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+// 读入16位PCM WAV的第一声道
+static esp_err_t load_wav(const char *path, uint32_t *rate)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        ESP_LOGE(TAG, "无法打开输入文件 %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t hdr[12];
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+
+    if (fread(hdr, 1, 12, fp) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+        ESP_LOGE(TAG, "%s 不是WAV文件", path);
+        goto out;
+    }
+
+    uint8_t chunk[8];
+    while (fread(chunk, 1, 8, fp) == 8) {
+        uint32_t size = rd32(chunk + 4);
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, 16, fp) != 16) {
+                goto out;
+            }
+            channels = rd16(fmt + 2);
+            *rate = rd32(fmt + 4);
+            bits = rd16(fmt + 14);
+            fseek(fp, (long)(size - 16 + (size & 1)), SEEK_CUR);
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (bits != 16 || channels == 0) {
+                ESP_LOGE(TAG, "只支持16位PCM (%u位 %u声道)", bits, channels);
+                goto out;
+            }
+            size_t frames = size / (2u * channels);
+            int16_t *raw = malloc(size ? size : 1);
+            s_src = malloc((frames ? frames : 1) * sizeof(int16_t));
+            if (!raw || !s_src) {
+                free(raw);
+                err = ESP_ERR_NO_MEM;
+                goto out;
+            }
+            frames = fread(raw, 2u * channels, frames, fp);
+            for (size_t i = 0; i < frames; i++) {
+                s_src[i] = raw[i * channels];
+            }
+            free(raw);
+            s_src_len = frames;
+            err = ESP_OK;
+            goto out;
+        } else {
+            fseek(fp, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    ESP_LOGE(TAG, "%s 没有data块", path);
+
+out:
+    fclose(fp);
+    return err;
+}
+
+static void write_wav_header(FILE *fp, uint32_t rate, uint32_t data_bytes)
+{
+    uint8_t h[44];
+    memcpy(h, "RIFF", 4);
+    wr32(h + 4, 36 + data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    wr32(h + 16, 16);
+    h[20] = 1; h[21] = 0;                   // PCM
+    h[22] = 1; h[23] = 0;                   // 单声道
+    wr32(h + 24, rate);
+    wr32(h + 28, rate * 2);
+    h[32] = 2; h[33] = 0;
+    h[34] = 16; h[35] = 0;
+    memcpy(h + 36, "data", 4);
+    wr32(h + 40, data_bytes);
+    fseek(fp, 0, SEEK_SET);
+    fwrite(h, 1, sizeof(h), fp);
+}
+
+esp_err_t audio_hal_init(const audio_hal_config_t *cfg)
+{
+    if (!cfg || cfg->mic_sample_rate == 0 || cfg->spk_sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_mic_rate = cfg->mic_sample_rate;
+    s_spk_rate = cfg->spk_sample_rate;
+    s_mic_pos = 0;
+    s_mic_total = 0;
+    s_spk_pending = 0;
+    s_spk_played = 0;
+
+    const char *mic_path = getenv(AUDIO_HAL_ENV_MIC_WAV);
+    if (mic_path && *mic_path) {
+        uint32_t rate = 0;
+        esp_err_t err = load_wav(mic_path, &rate);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (rate == 0 || s_mic_rate % rate != 0) {
+            ESP_LOGE(TAG, "输入采样率 %lu 不是 %lu 的整数分之一", (unsigned long)rate, (unsigned long)s_mic_rate);
+            audio_hal_deinit();
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        s_upsample = s_mic_rate / rate;
+
+        uint32_t tail_ms = AUDIO_HAL_DEFAULT_TAIL_MS;
+        const char *tail = getenv(AUDIO_HAL_ENV_TAIL_MS);
+        if (tail && *tail) {
+            tail_ms = (uint32_t)strtoul(tail, NULL, 10);
+        }
+        s_mic_total = (uint64_t)s_src_len * s_upsample + (uint64_t)tail_ms * s_mic_rate / 1000;
+        ESP_LOGI(TAG, "麦克风输入 %s: %u 样本 @ %lu Hz, x%lu 插值, 静音尾巴 %lu ms",
+                 mic_path, (unsigned)s_src_len, (unsigned long)rate,
+                 (unsigned long)s_upsample, (unsigned long)tail_ms);
+    } else {
+        ESP_LOGW(TAG, "未设置 %s, 麦克风输入静音", AUDIO_HAL_ENV_MIC_WAV);
+    }
+
+    const char *spk_path = getenv(AUDIO_HAL_ENV_SPK_WAV);
+    if (spk_path && *spk_path) {
+        s_spk_fp = fopen(spk_path, "wb");
+        if (!s_spk_fp) {
+            ESP_LOGE(TAG, "无法创建输出文件 %s", spk_path);
+            audio_hal_deinit();
+            return ESP_FAIL;
+        }
+        write_wav_header(s_spk_fp, s_spk_rate, 0);
+    }
+
+    s_spk_lock = xSemaphoreCreateMutex();
+    if (!s_spk_lock) {
+        audio_hal_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_t0_us = now_us();
+    return ESP_OK;
+}
+
+// 第k个麦克风样本: 文件内线性插值, 文件之后为静音
+static int16_t mic_sample(uint64_t k)
+{
+    uint64_t i = k / s_upsample;
+    if (i >= s_src_len) {
+        return 0;
+    }
+    int32_t a = s_src[i];
+    int32_t b = i + 1 < s_src_len ? s_src[i + 1] : a;
+    int32_t frac = (int32_t)(k % s_upsample);
+    return (int16_t)(a + (b - a) * frac / (int32_t)s_upsample);
+}
+
+esp_err_t audio_hal_mic_read(int16_t *buf, size_t samples, size_t *read, TickType_t wait)
+{
+    *read = 0;
+    if (s_mic_total && s_mic_pos >= s_mic_total) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 读取方来晚: 和设备一样, DMA只保留最近的若干样本
+    uint64_t avail_end = timeline_samples(now_us(), s_mic_rate);
+    if (avail_end > s_mic_pos + AUDIO_HAL_MIC_DMA_SAMPLES) {
+        s_mic_pos = avail_end - AUDIO_HAL_MIC_DMA_SAMPLES;
+    }
+
+    // 等待时间内能凑齐多少就交付多少
+    int64_t deadline = now_us() + (int64_t)wait * portTICK_PERIOD_MS * 1000;
+    uint64_t end = s_mic_pos + samples;
+    uint64_t reachable = timeline_samples(deadline, s_mic_rate);
+    if (end > reachable) {
+        end = reachable > s_mic_pos ? reachable : s_mic_pos;
+    }
+    if (s_mic_total && end > s_mic_total) {
+        end = s_mic_total;
+    }
+    sleep_until(s_t0_us + (int64_t)(end * 1000000 / s_mic_rate));
+
+    size_t n = (size_t)(end - s_mic_pos);
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = mic_sample(s_mic_pos + i);
+    }
+    s_mic_pos = end;
+    *read = n;
+    return ESP_OK;
+}
+
+// 把时间线推进到当前时刻: DMA中的样本依次播出, 播空后补静音
+static void spk_advance(void)
+{
+    static const int16_t zeros[256];
+    uint64_t target = timeline_samples(now_us(), s_spk_rate);
+
+    while (s_spk_played < target) {
+        size_t n = (size_t)(target - s_spk_played);
+        if (s_spk_pending > 0) {
+            if (n > s_spk_pending) {
+                n = s_spk_pending;
+            }
+            if (s_spk_fp) {
+                fwrite(s_spk_dma, sizeof(int16_t), n, s_spk_fp);
+            }
+            memmove(s_spk_dma, s_spk_dma + n, (s_spk_pending - n) * sizeof(int16_t));
+            s_spk_pending -= n;
+        } else {
+            if (n > sizeof(zeros) / sizeof(zeros[0])) {
+                n = sizeof(zeros) / sizeof(zeros[0]);
+            }
+            if (s_spk_fp) {
+                fwrite(zeros, sizeof(int16_t), n, s_spk_fp);
+            }
+        }
+        s_spk_played += n;
+    }
+}
+
+esp_err_t audio_hal_spk_write(const int16_t *buf, size_t samples, size_t *written, TickType_t wait)
+{
+    int64_t deadline = now_us() + (int64_t)wait * portTICK_PERIOD_MS * 1000;
+    size_t done = 0;
+
+    while (1) {
+        xSemaphoreTake(s_spk_lock, portMAX_DELAY);
+        spk_advance();
+        size_t n = AUDIO_HAL_SPK_DMA_SAMPLES - s_spk_pending;
+        if (n > samples - done) {
+            n = samples - done;
+        }
+        memcpy(s_spk_dma + s_spk_pending, buf + done, n * sizeof(int16_t));
+        s_spk_pending += n;
+        done += n;
+        // DMA满: 等到能再放下剩余部分(最多一个描述符)的时刻
+        size_t want = samples - done;
+        if (want > 1024) {
+            want = 1024;
+        }
+        int64_t room_at = s_t0_us + (int64_t)((s_spk_played + want) * 1000000 / s_spk_rate);
+        xSemaphoreGive(s_spk_lock);
+
+        if (done == samples || (wait != portMAX_DELAY && now_us() >= deadline)) {
+            break;
+        }
+        sleep_until(wait != portMAX_DELAY && room_at > deadline ? deadline : room_at);
+    }
+
+    *written = done;
+    return ESP_OK;
+}
+
+esp_err_t audio_hal_spk_clear(void)
+{
+    if (!s_spk_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_spk_lock, portMAX_DELAY);
+    spk_advance();
+    s_spk_pending = 0;
+    xSemaphoreGive(s_spk_lock);
+    return ESP_OK;
+}
+
+void audio_hal_deinit(void)
+{
+    if (s_spk_lock) {
+        xSemaphoreTake(s_spk_lock, portMAX_DELAY);
+    }
+    if (s_spk_fp) {
+        // DMA中剩余的音频照常播完
+        spk_advance();
+        fwrite(s_spk_dma, sizeof(int16_t), s_spk_pending, s_spk_fp);
+        s_spk_played += s_spk_pending;
+        s_spk_pending = 0;
+        write_wav_header(s_spk_fp, s_spk_rate, (uint32_t)(s_spk_played * sizeof(int16_t)));
+        fclose(s_spk_fp);
+        s_spk_fp = NULL;
+        ESP_LOGI(TAG, "喇叭输出 %llu 样本", (unsigned long long)s_spk_played);
+    }
+    if (s_spk_lock) {
+        xSemaphoreGive(s_spk_lock);
+        vSemaphoreDelete(s_spk_lock);
+        s_spk_lock = NULL;
+    }
+    free(s_src);
+    s_src = NULL;
+    s_src_len = 0;
+}
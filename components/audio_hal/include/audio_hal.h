@@ -0,0 +1,80 @@
+#ifndef AUDIO_HAL_H
+#define AUDIO_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* 主机构建: 作为麦克风输入的WAV文件(16位PCM, 多声道只取第一声道) */
+#define AUDIO_HAL_ENV_MIC_WAV       "VOICE_HAL_MIC_WAV"
+
+/* 主机构建: 喇叭输出录制到的WAV文件, 按播放时间线写入(断流处补静音) */
+#define AUDIO_HAL_ENV_SPK_WAV       "VOICE_HAL_SPK_WAV"
+
+/* 主机构建: 输入文件读完后继续送入的静音时长, 留给识别/应答/播放收尾 */
+#define AUDIO_HAL_ENV_TAIL_MS       "VOICE_HAL_TAIL_MS"
+#define AUDIO_HAL_DEFAULT_TAIL_MS   8000
+
+/* 喇叭DMA缓冲的样本数(8个描述符 x 1024), 主机构建按此模拟写入阻塞和清空 */
+#define AUDIO_HAL_SPK_DMA_SAMPLES   (8 * 1024)
+
+/**
+ * @brief 音频输入输出配置
+ *
+ * 引脚只在设备上使用; 主机构建用采样率换算文件和时间线.
+ */
+typedef struct {
+    uint32_t mic_sample_rate;
+    uint32_t spk_sample_rate;
+    int mic_bck_io;
+    int mic_ws_io;
+    int mic_data_io;
+    int spk_bck_io;
+    int spk_ws_io;
+    int spk_data_io;
+} audio_hal_config_t;
+
+/**
+ * @brief 初始化麦克风和喇叭
+ *
+ * 设备上安装两路I2S驱动; 主机构建打开环境变量指定的WAV文件.
+ *
+ * @param cfg 配置
+ * @return esp_err_t
+ */
+esp_err_t audio_hal_init(const audio_hal_config_t *cfg);
+
+/**
+ * @brief 读取单声道16位麦克风样本, 按实时速率返回
+ *
+ * @param buf 输出缓冲区
+ * @param samples 最多读取的样本数
+ * @param[out] read 实际读取的样本数
+ * @param wait 最长等待时间
+ * @return esp_err_t ESP_ERR_NOT_FOUND: 输入已结束(主机构建的文件和静音尾巴都已读完)
+ */
+esp_err_t audio_hal_mic_read(int16_t *buf, size_t samples, size_t *read, TickType_t wait);
+
+/**
+ * @brief 写入喇叭, DMA缓冲满时阻塞
+ *
+ * @param buf 单声道16位样本
+ * @param samples 样本数
+ * @param[out] written 实际写入的样本数
+ * @param wait 最长等待时间
+ * @return esp_err_t
+ */
+esp_err_t audio_hal_spk_write(const int16_t *buf, size_t samples, size_t *written, TickType_t wait);
+
+/**
+ * @brief 丢弃已写入但尚未播出的音频(打断播放)
+ */
+esp_err_t audio_hal_spk_clear(void);
+
+/**
+ * @brief 释放麦克风和喇叭, 主机构建在此补全输出WAV文件头
+ */
+void audio_hal_deinit(void);
+
+#endif /* AUDIO_HAL_H */
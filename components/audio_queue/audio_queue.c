@@ -0,0 +1,109 @@
+/*
+ * 单生产者/单消费者无锁音频帧队列
+ *
+ * 采集任务只做I2S读取和重采样, 通过本队列把帧交给上传任务,
+ * 网络阻塞不会再拖慢I2S读取导致DMA溢出.
+ *
+ * DROP_OLDEST策略下生产者需要推进tail, 因此消费者采用
+ * "先拷贝再CAS提交"的方式: 若拷贝期间该帧被生产者覆盖,
+ * CAS会失败, 消费者丢弃这次拷贝并重试.
+ */
+
+#include "audio_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+esp_err_t audio_queue_init(audio_queue_t *q, size_t depth, audio_queue_policy_t policy)
+{
+    if (!q || depth < 2 || (depth & (depth - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    q->frames = (audio_frame_t *)calloc(depth, sizeof(audio_frame_t));
+    if (!q->frames) {
+        return ESP_ERR_NO_MEM;
+    }
+    q->mask = depth - 1;
+    q->policy = policy;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->dropped, 0);
+    return ESP_OK;
+}
+
+void audio_queue_deinit(audio_queue_t *q)
+{
+    if (q && q->frames) {
+        free(q->frames);
+        q->frames = NULL;
+    }
+}
+
+bool audio_queue_push(audio_queue_t *q, audio_frame_type_t type, const int16_t *samples, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head - tail > q->mask) {
+        if (q->policy == AUDIO_QUEUE_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        // 丢弃最旧的一帧; CAS失败说明消费者刚好取走了它, 同样腾出了空间
+        if (atomic_compare_exchange_strong_explicit(&q->tail, &tail, tail + 1,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+        }
+    }
+
+    if (len > AUDIO_QUEUE_FRAME_SAMPLES) {
+        len = AUDIO_QUEUE_FRAME_SAMPLES;
+    }
+    audio_frame_t *frame = &q->frames[head & q->mask];
+    frame->type = (uint16_t)type;
+    frame->samples = (uint16_t)len;
+    if (samples && len > 0) {
+        memcpy(frame->data, samples, len * sizeof(int16_t));
+    }
+
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool audio_queue_pop(audio_queue_t *q, audio_frame_t *out)
+{
+    for (;;) {
+        uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail == head) {
+            return false;
+        }
+
+        const audio_frame_t *frame = &q->frames[tail & q->mask];
+        out->type = frame->type;
+        out->samples = frame->samples;
+        if (out->samples > AUDIO_QUEUE_FRAME_SAMPLES) {
+            out->samples = AUDIO_QUEUE_FRAME_SAMPLES;
+        }
+        memcpy(out->data, frame->data, out->samples * sizeof(int16_t));
+
+        // 提交; 失败说明生产者在拷贝期间丢弃并覆盖了该帧, 重试
+        if (atomic_compare_exchange_strong_explicit(&q->tail, &tail, tail + 1,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            return true;
+        }
+    }
+}
+
+size_t audio_queue_count(audio_queue_t *q)
+{
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    return head - tail;
+}
+
+uint32_t audio_queue_dropped(audio_queue_t *q)
+{
+    return atomic_load_explicit(&q->dropped, memory_order_relaxed);
+}
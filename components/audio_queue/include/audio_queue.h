@@ -0,0 +1,101 @@
+#ifndef AUDIO_QUEUE_H
+#define AUDIO_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+
+/* 每帧最多容纳的16位样本数(60ms @ 16kHz) */
+#ifndef AUDIO_QUEUE_FRAME_SAMPLES
+#define AUDIO_QUEUE_FRAME_SAMPLES   960
+#endif
+
+/**
+ * @brief 帧类型. 控制帧与音频帧走同一个队列, 保证顺序一致
+ */
+typedef enum {
+    AUDIO_FRAME_AUDIO = 0,  // 音频数据
+    AUDIO_FRAME_START,      // 语音段开始
+    AUDIO_FRAME_FINISH,     // 语音段结束
+} audio_frame_type_t;
+
+/**
+ * @brief 固定大小的音频帧
+ */
+typedef struct {
+    uint16_t type;                                  // audio_frame_type_t
+    uint16_t samples;                               // 有效样本数
+    int16_t data[AUDIO_QUEUE_FRAME_SAMPLES];
+} audio_frame_t;
+
+/**
+ * @brief 队列满时的处理策略
+ */
+typedef enum {
+    AUDIO_QUEUE_DROP_OLDEST = 0,    // 丢弃最旧的帧, 保留最新音频
+    AUDIO_QUEUE_DROP_NEWEST,        // 丢弃新写入的帧
+} audio_queue_policy_t;
+
+/**
+ * @brief 单生产者/单消费者无锁音频帧队列
+ *
+ * 生产者(采集任务)永远不会阻塞. 读写索引为自由增长的32位计数,
+ * 容量必须是2的幂.
+ */
+typedef struct {
+    audio_frame_t *frames;
+    uint32_t mask;
+    audio_queue_policy_t policy;
+    _Atomic uint32_t head;      // 仅生产者写
+    _Atomic uint32_t tail;      // 消费者推进; DROP_OLDEST时生产者也会CAS推进
+    _Atomic uint32_t dropped;   // 溢出丢弃的帧数
+} audio_queue_t;
+
+/**
+ * @brief 初始化队列, 一次性分配帧存储
+ *
+ * @param q 队列
+ * @param depth 帧数, 必须是2的幂
+ * @param policy 溢出策略
+ * @return esp_err_t
+ */
+esp_err_t audio_queue_init(audio_queue_t *q, size_t depth, audio_queue_policy_t policy);
+
+/**
+ * @brief 释放队列存储
+ */
+void audio_queue_deinit(audio_queue_t *q);
+
+/**
+ * @brief 写入一帧(仅生产者调用, 不阻塞)
+ *
+ * @param q 队列
+ * @param type 帧类型
+ * @param samples 音频样本, 控制帧可为NULL
+ * @param len 样本数, 不超过AUDIO_QUEUE_FRAME_SAMPLES
+ * @return true 写入成功; false 按DROP_NEWEST策略丢弃了本帧
+ */
+bool audio_queue_push(audio_queue_t *q, audio_frame_type_t type, const int16_t *samples, size_t len);
+
+/**
+ * @brief 取出一帧(仅消费者调用, 不阻塞)
+ *
+ * @param q 队列
+ * @param out 输出帧
+ * @return true 取到一帧; false 队列为空
+ */
+bool audio_queue_pop(audio_queue_t *q, audio_frame_t *out);
+
+/**
+ * @brief 当前排队的帧数
+ */
+size_t audio_queue_count(audio_queue_t *q);
+
+/**
+ * @brief 累计溢出丢弃的帧数
+ */
+uint32_t audio_queue_dropped(audio_queue_t *q);
+
+#endif /* AUDIO_QUEUE_H */
@@ -0,0 +1,70 @@
+#ifndef CANCEL_TOKEN_H
+#define CANCEL_TOKEN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/**
+ * @brief 取消源
+ *
+ * 内部是一个递增的代数(epoch). 每次取消代数加一,
+ * 之前发出的所有令牌随即失效. 只用原子变量, 可以在任意任务中调用.
+ */
+typedef struct {
+    _Atomic uint32_t epoch;
+} cancel_source_t;
+
+/**
+ * @brief 取消令牌: 发出时刻的代数快照
+ */
+typedef struct {
+    cancel_source_t *source;
+    uint32_t epoch;
+} cancel_token_t;
+
+/**
+ * @brief 初始化取消源
+ */
+static inline void cancel_source_init(cancel_source_t *source)
+{
+    atomic_init(&source->epoch, 0);
+}
+
+/**
+ * @brief 取消之前发出的所有令牌
+ *
+ * @return uint32_t 新的代数
+ */
+static inline uint32_t cancel_source_cancel(cancel_source_t *source)
+{
+    return atomic_fetch_add_explicit(&source->epoch, 1, memory_order_acq_rel) + 1;
+}
+
+/**
+ * @brief 当前代数
+ */
+static inline uint32_t cancel_source_epoch(cancel_source_t *source)
+{
+    return atomic_load_explicit(&source->epoch, memory_order_acquire);
+}
+
+/**
+ * @brief 按指定代数生成令牌(用于随队列项传递的代数)
+ */
+static inline cancel_token_t cancel_token_make(cancel_source_t *source, uint32_t epoch)
+{
+    cancel_token_t token = { .source = source, .epoch = epoch };
+    return token;
+}
+
+/**
+ * @brief 令牌是否已被取消. NULL令牌永远不会被取消
+ */
+static inline bool cancel_token_is_cancelled(const cancel_token_t *token)
+{
+    return token && token->source && cancel_source_epoch(token->source) != token->epoch;
+}
+
+#endif /* CANCEL_TOKEN_H */
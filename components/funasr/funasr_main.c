@@ -6,6 +6,10 @@
  * - 音频数据的发送
  * - 识别结果的接收和处理
  * 
+ * 连接由独立的管理任务负责: 断线后销毁旧客户端, 按指数退避重建,
+ * 连上后重新发送当前语音段的开始帧并补发最近的音频.
+ * 事件处理函数只通知状态, 不再在WebSocket任务内部重建客户端.
+ * 
  * 作者: 星年
  * 日期: 2024-01-20
  */
@@ -13,16 +17,26 @@
 #include "funasr_main.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
 #include "esp_websocket_client.h"
 #include "esp_log.h"
 #include "cJSON.h"
+#include "sdkconfig.h"
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
 #include "esp_crt_bundle.h"
-#include "ollama_main.h"
+#endif
+#include "esp_timer.h"
+#include "metrics.h"
+#include "trace_log.h"
+#include "traffic_capture.h"
 
 /* 日志标签 */
 static const char *TAG = "FUNASR_WEBSOCKET";
@@ -30,14 +44,76 @@ static const char *TAG = "FUNASR_WEBSOCKET";
 /* WebSocket客户端句柄 */
 static esp_websocket_client_handle_t funasr_client;
 
+/* 识别结果回调 */
+static funasr_result_callback_t funasr_result_callback = NULL;
+
+/* 上传编码器及编码输出缓冲区 */
+static audio_encoder_t *funasr_encoder = NULL;
+static uint8_t funasr_encoded[FUNASR_MAX_FRAME_SAMPLES * sizeof(int16_t)];
+
+/* 发送成功的音频字节数, 只在上传任务中写; 其余发送统计见funasr_m_send_us */
+static uint64_t funasr_send_bytes;
+
+/* 连接状态事件位 */
+#define FUNASR_EVT_CONNECTED     BIT0    // 已连接
+#define FUNASR_EVT_DISCONNECTED  BIT1    // 断线(事件通知或发送失败)
+#define FUNASR_EVT_STOP          BIT2    // 请求停止管理任务
+#define FUNASR_EVT_STOPPED       BIT3    // 管理任务已退出
+
+static EventGroupHandle_t funasr_events = NULL;
+
+/* 保护客户端句柄, 同时保证补发和正常发送的顺序 */
+static SemaphoreHandle_t funasr_lock = NULL;
+
+/* 当前语音段状态, 持有funasr_lock时访问 */
+static bool funasr_stream_open = false;     // 已开始且未结束
+static bool funasr_stream_synced = false;   // 服务器已收到本段的开始帧和全部音频
+static bool funasr_finish_pending = false;  // 本段在断线期间结束, 重连后补发结束帧
+
+/* 当前语音段最近音频的环形缓冲区, 重连后补发 */
+static int16_t *funasr_replay = NULL;
+static size_t funasr_replay_cap = 0;
+static size_t funasr_replay_head = 0;       // 下一个写入位置
+static size_t funasr_replay_len = 0;
+static bool funasr_replay_wrapped = false;  // 本段开头已被覆盖, 补发不完整
+
+/* 连接统计 */
+static funasr_conn_stats_t funasr_conn_stats;
+
+/* 运行期指标 */
+METRIC_COUNTER_DEFINE(funasr_m_connects, "funasr.connects");
+METRIC_COUNTER_DEFINE(funasr_m_disconnects, "funasr.disconnects");
+METRIC_COUNTER_DEFINE(funasr_m_send_failures, "funasr.send_failures");
+METRIC_COUNTER_DEFINE(funasr_m_json_errors, "funasr.json_errors");
+METRIC_COUNTER_DEFINE(funasr_m_blank_results, "funasr.blank_results");
+METRIC_COUNTER_DEFINE(funasr_m_replays, "funasr.replays");
+METRIC_COUNTER_DEFINE(funasr_m_replay_overflows, "funasr.replay_overflows");
+METRIC_HISTOGRAM_DEFINE(funasr_m_send_us, "funasr.send_us", FUNASR_SEND_HIST_BOUNDS_US);
+
 /* 保存WebSocket连接参数的全局变量 */
 static struct {
     char uri[128];
     bool is_ssl;
 } funasr_ws_config = {0};
 
+/* 识别结果是否只有空白(ASCII空白或全角空格) */
+static bool funasr_text_is_blank(const char *text)
+{
+    while (*text) {
+        if (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') {
+            text++;
+        } else if (strncmp(text, "\xE3\x80\x80", 3) == 0) {
+            text += 3;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
 /* 函数声明 */
 static void funasr_websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
+void funasr_set_result_callback(funasr_result_callback_t callback);
 esp_err_t funasr_websocket_init(const char *uri, bool is_ssl);
 esp_err_t funasr_send_start_frame(void);
 esp_err_t funasr_send_finish_frame(void);
@@ -57,60 +133,33 @@ static void funasr_websocket_event_handler(void *handler_args, esp_event_base_t
 {
     /* 将事件数据转换为WebSocket事件数据结构 */
     esp_websocket_event_data_t *data = (esp_websocket_event_data_t *)event_data;
+
+    /* 抓包(主机构建中按需开启), 只有数据事件带负载 */
+    if (event_id == WEBSOCKET_EVENT_DATA) {
+        traffic_capture_record(TRAFFIC_CAPTURE_FUNASR, event_id, data->op_code, data->data_ptr, data->data_len);
+    } else {
+        traffic_capture_record(TRAFFIC_CAPTURE_FUNASR, event_id, 0, NULL, 0);
+    }
     
     /* 根据事件ID进行不同的处理 */
     switch (event_id) {
         case WEBSOCKET_EVENT_CONNECTED:
-            /* WebSocket连接建立成功 */
+            /* WebSocket连接建立成功, 由管理任务补发当前语音段 */
             ESP_LOGI(TAG, "FunASR: WEBSOCKET_EVENT_CONNECTED");
+            xEventGroupClearBits(funasr_events, FUNASR_EVT_DISCONNECTED);
+            xEventGroupSetBits(funasr_events, FUNASR_EVT_CONNECTED);
             break;
         case WEBSOCKET_EVENT_DISCONNECTED:
-            /* WebSocket连接断开 */
+        case WEBSOCKET_EVENT_CLOSED:
+            /* WebSocket连接断开(或服务器主动关闭)
+             * 不能在客户端自己的任务里销毁/重建客户端, 只通知管理任务 */
             ESP_LOGE(TAG, "FunASR: WEBSOCKET_EVENT_DISCONNECTED: 连接断开");
-            ESP_LOGI(TAG, "FunASR: 正在尝试重新连接...");
-            
-            /* 停止当前客户端 */
-            esp_err_t stop_err = esp_websocket_client_stop(funasr_client);
-            if (stop_err != ESP_OK) {
-                ESP_LOGE(TAG, "FunASR: 停止WebSocket客户端失败: %s", esp_err_to_name(stop_err));
-            }
-            
-            /* 使用保存的配置重新初始化并启动客户端 */
-            esp_websocket_client_config_t websocket_cfg = {
-                .uri = funasr_ws_config.uri,
-                .disable_auto_reconnect = false,
-                .task_stack = 4096,
-                .task_prio = 5,
-                .buffer_size = 1024,
-                .transport = funasr_ws_config.is_ssl ? WEBSOCKET_TRANSPORT_OVER_SSL : WEBSOCKET_TRANSPORT_OVER_TCP,
-                .crt_bundle_attach = esp_crt_bundle_attach,
-            };
-            
-            /* 重新初始化客户端 */
-            funasr_client = esp_websocket_client_init(&websocket_cfg);
-            if (funasr_client == NULL) {
-                ESP_LOGE(TAG, "重新初始化WebSocket客户端失败");
-                break;
-            }
-            
-            /* 重新注册事件处理函数 */
-            esp_err_t reg_err = esp_websocket_register_events(funasr_client, WEBSOCKET_EVENT_ANY, funasr_websocket_event_handler, NULL);
-            if (reg_err != ESP_OK) {
-                ESP_LOGE(TAG, "FunASR: 注册事件处理函数失败: %s", esp_err_to_name(reg_err));
-                break;
-            }
-            
-            /* 启动客户端 */
-            esp_err_t start_err = esp_websocket_client_start(funasr_client);
-            if (start_err != ESP_OK) {
-                ESP_LOGE(TAG, "FunASR: 启动WebSocket客户端失败: %s", esp_err_to_name(start_err));
-            }
-            
+            xEventGroupClearBits(funasr_events, FUNASR_EVT_CONNECTED);
+            xEventGroupSetBits(funasr_events, FUNASR_EVT_DISCONNECTED);
             break;
         case WEBSOCKET_EVENT_DATA:
-            /* 接收到WebSocket数据 */
-            ESP_LOGI(TAG, "FunASR: WEBSOCKET_EVENT_DATA");
-            ESP_LOGI(TAG, "FunASR: Received opcode=%d", data->op_code);
+            /* 接收到WebSocket数据, 每条消息都会经过这里, 只写延迟日志 */
+            TRACE_LOGD(TAG, "FunASR: 收到数据 opcode=%d, %d 字节", data->op_code, data->data_len);
             
             /* 检查是否为关闭帧(opcode 0x08)或心跳帧(opcode 0x0A) */
             if (data->op_code == 0x08 && data->data_len == 2) {
@@ -118,7 +167,7 @@ static void funasr_websocket_event_handler(void *handler_args, esp_event_base_t
                 ESP_LOGW(TAG, "FunASR: 收到关闭消息,状态码=%d", 256*data->data_ptr[0] + data->data_ptr[1]);
             } else if (data->op_code == 0x0A) {
                 /* 收到心跳帧,忽略处理 */
-                ESP_LOGI(TAG, "FunASR: 收到心跳帧");
+                TRACE_LOGD(TAG, "FunASR: 收到心跳帧");
             } else if (data->data_ptr == NULL) {
                 ESP_LOGE(TAG, "FunASR: 接收到空数据");
             } else {
@@ -126,23 +175,35 @@ static void funasr_websocket_event_handler(void *handler_args, esp_event_base_t
                 cJSON *root = cJSON_Parse((char *)data->data_ptr);
                 if (root == NULL) {
                     ESP_LOGE(TAG, "FunASR: JSON解析失败");
+                    metric_inc(&funasr_m_json_errors);
                     break;
                 }
 
-                /* 获取各个字段 */
-                const char *mode = cJSON_GetObjectItem(root, "mode")->valuestring;
-                const char *text = cJSON_GetObjectItem(root, "text")->valuestring;
+                /* 获取各个字段; 服务器可能省略text或给出其他类型, 按空白结果处理 */
+                cJSON *mode_item = cJSON_GetObjectItem(root, "mode");
+                cJSON *text_item = cJSON_GetObjectItem(root, "text");
+                const char *mode = cJSON_IsString(mode_item) ? mode_item->valuestring : "";
+                const char *text = cJSON_IsString(text_item) ? text_item->valuestring : "";
                 
                 /* 打印基本信息 */
-                if (strcmp(mode, "2pass-offline") == 0) {
+                if (strcmp(mode, "2pass-offline") == 0 && funasr_text_is_blank(text)) {
+                    /* 噪声或咳嗽只识别出空白, 不能打断正在进行的应答 */
+                    TRACE_LOGD(TAG, "FunASR: 忽略空白识别结果");
+                    metric_inc(&funasr_m_blank_results);
+                } else if (strcmp(mode, "2pass-offline") == 0) {
+                    /* 每段语音一次, 直接输出完整文本 */
                     ESP_LOGI(TAG, "FunASR: 识别文本: %s", text);
-                    ollama_chat(text);
+                    /* 只把结果交给回调入队, 不在WebSocket任务中等待大模型和播放 */
+                    if (funasr_result_callback) {
+                        funasr_result_callback(text);
+                    }
                 }
 
                 /* 处理时间戳信息(如果存在) */
                 cJSON *timestamp = cJSON_GetObjectItem(root, "timestamp");
-                if (timestamp != NULL) {
-                    ESP_LOGI(TAG, "FunASR: 时间戳: %s", timestamp->valuestring);
+                if (cJSON_IsString(timestamp)) {
+                    TRACE_LOGD_STR(TAG, "FunASR: 时间戳: %s", timestamp->valuestring,
+                                   strlen(timestamp->valuestring));
                 }
 
                 /* 处理句子级别时间戳(如果存在) */
@@ -151,13 +212,23 @@ static void funasr_websocket_event_handler(void *handler_args, esp_event_base_t
                     int array_size = cJSON_GetArraySize(stamp_sents);
                     for (int i = 0; i < array_size; i++) {
                         cJSON *sent = cJSON_GetArrayItem(stamp_sents, i);
-                        const char *text_seg = cJSON_GetObjectItem(sent, "text_seg")->valuestring;
-                        const char *punc = cJSON_GetObjectItem(sent, "punc")->valuestring;
-                        int start = cJSON_GetObjectItem(sent, "start")->valueint;
-                        int end = cJSON_GetObjectItem(sent, "end")->valueint;
-                        
-                        ESP_LOGI(TAG, "FunASR: 句子[%d]: 文本=%s, 标点=%s, 开始=%d, 结束=%d", 
-                                i, text_seg, punc, start, end);
+                        cJSON *text_seg = cJSON_GetObjectItem(sent, "text_seg");
+                        cJSON *punc = cJSON_GetObjectItem(sent, "punc");
+                        cJSON *start = cJSON_GetObjectItem(sent, "start");
+                        cJSON *end = cJSON_GetObjectItem(sent, "end");
+                        if (!cJSON_IsString(text_seg)) {
+                            continue;
+                        }
+
+                        /* 每条记录只能带一段字符串, 标点单独记一条 */
+                        TRACE_LOGD_STR(TAG, "FunASR: 句子[%d]: 开始=%d, 结束=%d, 文本=%s",
+                                       text_seg->valuestring, strlen(text_seg->valuestring), i,
+                                       cJSON_IsNumber(start) ? start->valueint : -1,
+                                       cJSON_IsNumber(end) ? end->valueint : -1);
+                        if (cJSON_IsString(punc)) {
+                            TRACE_LOGD_STR(TAG, "FunASR: 句子[%d]: 标点=%s",
+                                           punc->valuestring, strlen(punc->valuestring), i);
+                        }
                     }
                 }
 
@@ -176,63 +247,311 @@ static void funasr_websocket_event_handler(void *handler_args, esp_event_base_t
     }
 }
 
+/* 回放抓包: 构造数据事件交给事件处理函数, 连接类事件依赖管理任务, 不回放 */
+void funasr_replay_event(int32_t event_id, uint8_t op_code, const char *data, int len)
+{
+    if (event_id != WEBSOCKET_EVENT_DATA) {
+        return;
+    }
+    esp_websocket_event_data_t evt = {
+        .op_code = op_code,
+        .data_ptr = data,
+        .data_len = len,
+        .payload_len = len,
+        .fin = true,
+    };
+    funasr_websocket_event_handler(NULL, NULL, event_id, &evt);
+}
+
+/* 设置识别结果回调函数 */
+void funasr_set_result_callback(funasr_result_callback_t callback)
+{
+    funasr_result_callback = callback;
+}
+
+/* 补发缓冲区操作, 持有funasr_lock时调用 */
+static void funasr_replay_clear(void)
+{
+    funasr_replay_head = 0;
+    funasr_replay_len = 0;
+    funasr_replay_wrapped = false;
+}
+
+static void funasr_replay_push(const int16_t *pcm, size_t samples)
+{
+    for (size_t i = 0; i < samples && funasr_replay_cap > 0; i++) {
+        funasr_replay[funasr_replay_head] = pcm[i];
+        funasr_replay_head = (funasr_replay_head + 1) % funasr_replay_cap;
+        if (funasr_replay_len < funasr_replay_cap) {
+            funasr_replay_len++;
+        } else {
+            funasr_conn_stats.replay_overflow_samples++;
+            funasr_replay_wrapped = true;
+        }
+    }
+}
+
 /**
- * @brief 初始化并连接WebSocket客户端
- * 
- * 该函数完成以下工作:
- * 1. 保存连接参数
- * 2. 配置WebSocket客户端参数
- * 3. 初始化WebSocket客户端
- * 4. 注册事件处理函数
- * 5. 启动WebSocket客户端
- * 
+ * @brief 创建并启动WebSocket客户端
+ *
+ * 自动重连关闭, 断线由管理任务销毁客户端后重建.
+ *
  * @return esp_err_t ESP_OK:成功 ESP_FAIL:失败
  */
-esp_err_t funasr_websocket_init(const char *uri , bool is_ssl)
-{    
-    /* 保存连接参数供后续使用 */
-    strncpy(funasr_ws_config.uri, uri, sizeof(funasr_ws_config.uri) - 1);
-    funasr_ws_config.uri[sizeof(funasr_ws_config.uri) - 1] = '\0';
-    funasr_ws_config.is_ssl = is_ssl;
-
+static esp_err_t funasr_client_create(void)
+{
     /* 配置WebSocket客户端参数 */
     esp_websocket_client_config_t websocket_cfg = {
         .uri = funasr_ws_config.uri,                             // WebSocket服务器的URI
-        .disable_auto_reconnect = false,                        // 启用自动重连
+        .disable_auto_reconnect = true,                         // 由管理任务负责重连
         .task_stack = 4096,                                     // WebSocket任务栈大小(字节)
         .task_prio = 5,                                         // WebSocket任务优先级(0-25,数字越大优先级越高)
-        .buffer_size = 1024,                                    // 收发数据缓冲区大小(字节)
+        .buffer_size = FUNASR_WS_BUFFER_SIZE,                   // 收发数据缓冲区大小(字节)
         .transport = funasr_ws_config.is_ssl ?                // 传输方式: 根据是否使用SSL选择
             WEBSOCKET_TRANSPORT_OVER_SSL : WEBSOCKET_TRANSPORT_OVER_TCP,
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
         .crt_bundle_attach = esp_crt_bundle_attach,            // 证书捆绑附加
+#endif
     };
 
+    xEventGroupClearBits(funasr_events, FUNASR_EVT_CONNECTED | FUNASR_EVT_DISCONNECTED);
+
     /* 使用配置初始化WebSocket客户端 */
-    funasr_client = esp_websocket_client_init(&websocket_cfg);
-    if (funasr_client == NULL) {
+    esp_websocket_client_handle_t client = esp_websocket_client_init(&websocket_cfg);
+    if (client == NULL) {
         ESP_LOGE(TAG, "FunASR: Failed to initialize WebSocket client");
         return ESP_FAIL;
     }
 
     /* 注册事件处理函数,处理所有WebSocket事件 */
-    esp_websocket_register_events(funasr_client, WEBSOCKET_EVENT_ANY, funasr_websocket_event_handler, NULL);
+    esp_websocket_register_events(client, WEBSOCKET_EVENT_ANY, funasr_websocket_event_handler, NULL);
 
     /* 启动WebSocket客户端,开始连接服务器 */
-    esp_err_t ret = esp_websocket_client_start(funasr_client);
-    if (ret != ESP_OK) {
+    if (esp_websocket_client_start(client) != ESP_OK) {
         ESP_LOGE(TAG, "FunASR: Failed to start WebSocket client");
-        return ret;
+        esp_websocket_client_destroy(client);
+        return ESP_FAIL;
     }
 
+    xSemaphoreTake(funasr_lock, portMAX_DELAY);
+    funasr_client = client;
+    xSemaphoreGive(funasr_lock);
     return ESP_OK;
 }
 
-/* 发送开始帧 */
-esp_err_t funasr_send_start_frame() {
-    if (funasr_client == NULL) {
+/* 停止并销毁客户端(会等待客户端任务退出) */
+static void funasr_client_destroy(void)
+{
+    xSemaphoreTake(funasr_lock, portMAX_DELAY);
+    esp_websocket_client_handle_t client = funasr_client;
+    funasr_client = NULL;
+    funasr_stream_synced = false;
+    xSemaphoreGive(funasr_lock);
+
+    if (client) {
+        esp_websocket_client_stop(client);
+        esp_websocket_client_destroy(client);
+    }
+}
+
+static esp_err_t funasr_send_start_locked(void);
+static esp_err_t funasr_send_finish_locked(void);
+static esp_err_t funasr_send_pcm_locked(const int16_t *pcm, size_t samples);
+
+/* 重连后补发: 当前语音段的开始帧, 最近的音频, 以及断线期间错过的结束帧 */
+static void funasr_resync(void)
+{
+    xSemaphoreTake(funasr_lock, portMAX_DELAY);
+
+    if (funasr_stream_open || funasr_finish_pending) {
+        size_t len = funasr_replay_len;
+        size_t start = (funasr_replay_head + funasr_replay_cap - len) % (funasr_replay_cap ? funasr_replay_cap : 1);
+        esp_err_t ret = funasr_send_start_locked();
+
+        // 环形缓冲区最多分两段发送
+        while (ret == ESP_OK && len > 0) {
+            size_t n = funasr_replay_cap - start;
+            if (n > len) {
+                n = len;
+            }
+            ret = funasr_send_pcm_locked(funasr_replay + start, n);
+            funasr_conn_stats.replayed_samples += n;
+            start = 0;
+            len -= n;
+        }
+
+        if (ret == ESP_OK) {
+            funasr_conn_stats.replays++;
+            metric_inc(&funasr_m_replays);
+            if (funasr_replay_wrapped) {
+                // 语音段比补发缓冲区长, 开头部分已经丢失
+                metric_inc(&funasr_m_replay_overflows);
+                ESP_LOGW(TAG, "FunASR: 重连后补发 %u 个样本, 语音段开头已被覆盖", (unsigned)funasr_replay_len);
+            } else {
+                ESP_LOGI(TAG, "FunASR: 重连后补发 %u 个样本", (unsigned)funasr_replay_len);
+            }
+            if (funasr_finish_pending) {
+                ret = funasr_send_finish_locked();
+                if (ret == ESP_OK) {
+                    funasr_finish_pending = false;
+                    funasr_replay_clear();
+                }
+            } else {
+                funasr_stream_synced = true;
+            }
+        }
+    }
+
+    xSemaphoreGive(funasr_lock);
+}
+
+/**
+ * @brief 连接管理任务
+ *
+ * 创建客户端 -> 等待连接 -> 补发 -> 等待断线 -> 销毁 -> 退避, 循环往复.
+ * 退避间隔从FUNASR_BACKOFF_MIN_MS开始每次加倍, 连接成功后复位, 并加入随机抖动,
+ * 避免大量设备在服务器重启后同时重连.
+ */
+static void funasr_conn_task(void *arg)
+{
+    uint32_t backoff_ms = FUNASR_BACKOFF_MIN_MS;
+
+    while (1) {
+        if (funasr_client_create() == ESP_OK) {
+            // 不自动重连: 连接被拒或握手失败时只有DISCONNECTED, 立即销毁并退避, 不等满超时
+            EventBits_t bits = xEventGroupWaitBits(funasr_events,
+                                                   FUNASR_EVT_CONNECTED | FUNASR_EVT_DISCONNECTED | FUNASR_EVT_STOP,
+                                                   pdFALSE, pdFALSE, pdMS_TO_TICKS(FUNASR_CONNECT_TIMEOUT_MS));
+            if (bits & FUNASR_EVT_STOP) {
+                break;
+            }
+            if (bits & FUNASR_EVT_CONNECTED) {
+                funasr_conn_stats.connects++;
+                metric_inc(&funasr_m_connects);
+                backoff_ms = FUNASR_BACKOFF_MIN_MS;
+                funasr_resync();
+
+                bits = xEventGroupWaitBits(funasr_events, FUNASR_EVT_DISCONNECTED | FUNASR_EVT_STOP,
+                                           pdFALSE, pdFALSE, portMAX_DELAY);
+                if (bits & FUNASR_EVT_STOP) {
+                    break;
+                }
+                funasr_conn_stats.disconnects++;
+                metric_inc(&funasr_m_disconnects);
+            } else if (bits & FUNASR_EVT_DISCONNECTED) {
+                ESP_LOGW(TAG, "FunASR: 连接失败");
+            } else {
+                ESP_LOGW(TAG, "FunASR: 连接超时");
+            }
+        }
+
+        funasr_client_destroy();
+
+        uint32_t delay_ms = backoff_ms + esp_random() % (backoff_ms / 4 + 1);
+        funasr_conn_stats.backoff_ms = delay_ms;
+        ESP_LOGW(TAG, "FunASR: %lu ms后重新连接", (unsigned long)delay_ms);
+        if (xEventGroupWaitBits(funasr_events, FUNASR_EVT_STOP, pdFALSE, pdFALSE,
+                                pdMS_TO_TICKS(delay_ms)) & FUNASR_EVT_STOP) {
+            break;
+        }
+        backoff_ms *= 2;
+        if (backoff_ms > FUNASR_BACKOFF_MAX_MS) {
+            backoff_ms = FUNASR_BACKOFF_MAX_MS;
+        }
+    }
+
+    funasr_client_destroy();
+    xEventGroupSetBits(funasr_events, FUNASR_EVT_STOPPED);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 初始化WebSocket连接
+ * 
+ * 该函数完成以下工作:
+ * 1. 保存连接参数
+ * 2. 分配断线补发缓冲区
+ * 3. 启动连接管理任务, 由它创建客户端并维持连接
+ * 
+ * @return esp_err_t ESP_OK:成功 ESP_FAIL:失败
+ */
+esp_err_t funasr_websocket_init(const char *uri , bool is_ssl)
+{    
+    /* 保存连接参数供后续使用 */
+    strncpy(funasr_ws_config.uri, uri, sizeof(funasr_ws_config.uri) - 1);
+    funasr_ws_config.uri[sizeof(funasr_ws_config.uri) - 1] = '\0';
+    funasr_ws_config.is_ssl = is_ssl;
+
+    metrics_register(&funasr_m_connects);
+    metrics_register(&funasr_m_disconnects);
+    metrics_register(&funasr_m_send_failures);
+    metrics_register(&funasr_m_json_errors);
+    metrics_register(&funasr_m_blank_results);
+    metrics_register(&funasr_m_replays);
+    metrics_register(&funasr_m_replay_overflows);
+    metrics_register(&funasr_m_send_us);
+
+    funasr_events = xEventGroupCreate();
+    funasr_lock = xSemaphoreCreateMutex();
+    if (funasr_events == NULL || funasr_lock == NULL) {
+        ESP_LOGE(TAG, "FunASR: 创建同步对象失败");
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* 补发缓冲区放在PSRAM; 没有PSRAM时只在内部RAM中留一小段,
+       96KB的完整缓冲区会挤占WiFi/LWIP和DMA缓冲. 分配失败时只是不补发 */
+    size_t cap = FUNASR_REPLAY_MS * 16;
+#if !CONFIG_IDF_TARGET_LINUX
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+        cap = FUNASR_REPLAY_INTERNAL_MS * 16;
+        ESP_LOGW(TAG, "FunASR: 没有PSRAM, 补发缓冲区缩短为 %d ms", FUNASR_REPLAY_INTERNAL_MS);
+        funasr_replay = heap_caps_malloc(cap * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    } else
+#endif
+    {
+        funasr_replay = heap_caps_malloc(cap * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (funasr_replay == NULL) {
+        ESP_LOGW(TAG, "FunASR: 补发缓冲区分配失败, 断线重连后不补发音频");
+        cap = 0;
+    }
+    funasr_replay_cap = cap;
+    funasr_replay_clear();
+
+    if (xTaskCreate(funasr_conn_task, "funasr_conn", 4096, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "FunASR: 创建连接管理任务失败");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief 发送一条消息, 调用方持有funasr_lock
+ *
+ * 未连接时立即返回, 不再阻塞上传任务. 发送失败(含超时)按断线处理,
+ * 由管理任务重建连接.
+ */
+static esp_err_t funasr_send_locked(bool text, const char *data, size_t len)
+{
+    if (funasr_client == NULL || !esp_websocket_client_is_connected(funasr_client)) {
         return ESP_ERR_INVALID_STATE;
     }
 
+    TickType_t timeout = pdMS_TO_TICKS(FUNASR_SEND_TIMEOUT_MS);
+    int ret = text ? esp_websocket_client_send_text(funasr_client, data, len, timeout)
+                   : esp_websocket_client_send_bin(funasr_client, data, len, timeout);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "FunASR: 发送失败, 重建连接");
+        xEventGroupSetBits(funasr_events, FUNASR_EVT_DISCONNECTED);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* 发送开始帧, 调用方持有funasr_lock */
+static esp_err_t funasr_send_start_locked(void)
+{
     cJSON *data = cJSON_CreateObject();
     /* chunk_interval: 设置音频分片间隔为10帧 */
     cJSON_AddNumberToObject(data, "chunk_interval", 10);
@@ -248,91 +567,228 @@ esp_err_t funasr_send_start_frame() {
     cJSON_AddItemToArray(chunk_size, cJSON_CreateNumber(10));
     cJSON_AddItemToArray(chunk_size, cJSON_CreateNumber(5));
     cJSON_AddItemToObject(data, "chunk_size", chunk_size);
+
+    /* is_speaking: 每段语音开始时重新置为true, 服务器才会开始新的一句 */
+    cJSON_AddTrueToObject(data, "is_speaking");
+
+    /* wav_format: 使用压缩编码时告知服务器(或本地解码中转), 每段语音从初始状态开始编码 */
+    if (funasr_encoder) {
+        audio_encoder_reset(funasr_encoder);
+        cJSON_AddStringToObject(data, "wav_format", audio_encoder_format(funasr_encoder));
+        cJSON_AddNumberToObject(data, "audio_fs", 16000);
+    }
     
     char *json_str = cJSON_Print(data);
     ESP_LOGI(TAG, "FunASR: 发送开始帧: %s", json_str);
     
-    int ret = esp_websocket_client_send_text(funasr_client, json_str, strlen(json_str), portMAX_DELAY);
+    esp_err_t ret = funasr_send_locked(true, json_str, strlen(json_str));
     
     free(json_str);
     cJSON_Delete(data);
     
-    return (ret > 0) ? ESP_OK : ESP_FAIL;
+    return ret;
 }
 
-/* 发送结束帧 */
-esp_err_t funasr_send_finish_frame() {
-    if (funasr_client == NULL) {
-        return ESP_ERR_INVALID_STATE;
-    }
-
+/* 发送结束帧, 调用方持有funasr_lock */
+static esp_err_t funasr_send_finish_locked(void)
+{
     cJSON *data = cJSON_CreateObject();
     cJSON_AddStringToObject(data, "type", "end");
+    /* is_speaking=false 通知服务器当前语音段结束, 立即输出离线识别结果 */
+    cJSON_AddFalseToObject(data, "is_speaking");
     
     char *json_str = cJSON_Print(data);
     ESP_LOGI(TAG, "FunASR: 发送结束帧: %s", json_str);
     
-    int ret = esp_websocket_client_send_text(funasr_client, json_str, strlen(json_str), portMAX_DELAY);
+    esp_err_t ret = funasr_send_locked(true, json_str, strlen(json_str));
     
     free(json_str);
     cJSON_Delete(data);
     
-    return (ret > 0) ? ESP_OK : ESP_FAIL;
+    return ret;
+}
+
+/* 发送开始帧
+ * 断线时也会开始记录本段音频, 重连后由管理任务补发 */
+esp_err_t funasr_send_start_frame() {
+    if (funasr_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(funasr_lock, portMAX_DELAY);
+    if (funasr_finish_pending) {
+        ESP_LOGW(TAG, "FunASR: 上一段语音未能补发, 丢弃");
+        funasr_finish_pending = false;
+    }
+    funasr_replay_clear();
+    funasr_stream_open = true;
+    esp_err_t ret = funasr_send_start_locked();
+    funasr_stream_synced = (ret == ESP_OK);
+    xSemaphoreGive(funasr_lock);
+
+    return ret;
+}
+
+/* 发送结束帧
+ * 断线时记下待发, 重连后连同本段音频一起补发 */
+esp_err_t funasr_send_finish_frame() {
+    if (funasr_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(funasr_lock, portMAX_DELAY);
+    esp_err_t ret = funasr_stream_synced ? funasr_send_finish_locked() : ESP_ERR_INVALID_STATE;
+    if (ret != ESP_OK && funasr_stream_open && funasr_replay_len > 0) {
+        funasr_finish_pending = true;
+    } else {
+        funasr_replay_clear();
+    }
+    funasr_stream_open = false;
+    funasr_stream_synced = false;
+    xSemaphoreGive(funasr_lock);
+
+    return ret;
+}
+
+/* 记录一次音频发送的耗时 */
+static void funasr_record_send(uint32_t us, size_t len, bool ok)
+{
+    metric_observe(&funasr_m_send_us, us);
+    if (ok) {
+        funasr_send_bytes += len;
+    } else {
+        metric_inc(&funasr_m_send_failures);
+    }
+}
+
+/* 发送一条音频消息并记录耗时, 调用方持有funasr_lock */
+static esp_err_t funasr_send_audio_locked(const uint8_t *data, size_t len)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = funasr_send_locked(false, (const char *)data, len);
+    if (ret != ESP_ERR_INVALID_STATE) {
+        funasr_record_send((uint32_t)(esp_timer_get_time() - start_us), len, ret == ESP_OK);
+    }
+    return ret;
 }
 
 /**
  * @brief 发送音频数据到WebSocket服务器
  * 
  * 该函数完成以下工作:
- * 1. 检查WebSocket客户端连接状态
+ * 1. 检查WebSocket客户端连接状态, 未连接时立即返回
  * 2. 以二进制格式发送音频数据
  * 
+ * 原样发送, 不经过编码器也不进入断线补发缓冲区.
+ * 
  * @param data 要发送的音频数据缓冲区
  * @param len 音频数据长度(字节)
- * @return esp_err_t ESP_OK:发送成功 ESP_FAIL:发送失败
+ * @return esp_err_t ESP_OK:发送成功 ESP_ERR_INVALID_STATE:未连接 ESP_FAIL:发送失败
  */
 esp_err_t funasr_websocket_send_audio(const uint8_t *data, size_t len)
 {
-    /* 检查WebSocket客户端是否已连接 */
-    if (!esp_websocket_client_is_connected(funasr_client)) {
-        ESP_LOGE(TAG, "FunASR: WebSocket client not connected");
-        /* 延时1秒后再返回失败 */
-        vTaskDelay(pdMS_TO_TICKS(3000));
-        return ESP_FAIL;
-    }
-
-    /* 以二进制格式发送音频数据
-     * portMAX_DELAY表示无限等待直到发送完成
-     */
-    esp_err_t ret = esp_websocket_client_send_bin(funasr_client, (const char*)data, len, portMAX_DELAY);
-    if (ret == -1) {
-        ESP_LOGE(TAG, "FunASR: Failed to send data, error code: %d", ret);
-        return ret;
+    if (funasr_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    return ESP_OK;
+    xSemaphoreTake(funasr_lock, portMAX_DELAY);
+    esp_err_t ret = funasr_send_audio_locked(data, len);
+    xSemaphoreGive(funasr_lock);
+    return ret;
 }
 
 /**
  * @brief 清理并关闭WebSocket连接
  * 
  * 该函数完成以下工作:
- * 1. 停止WebSocket客户端
- * 2. 销毁WebSocket客户端实例
- * 3. 清空客户端指针
+ * 1. 通知连接管理任务退出
+ * 2. 等待它停止并销毁WebSocket客户端
  */
 void funasr_websocket_cleanup(void)
 {
-    /* 检查客户端是否存在 */
-    if (funasr_client) {
-        /* 停止WebSocket客户端 */
-        esp_websocket_client_stop(funasr_client);
-        /* 销毁WebSocket客户端实例,释放资源 */
-        esp_websocket_client_destroy(funasr_client);
-        /* 将客户端指针置空 */
-        funasr_client = NULL;
+    if (funasr_events == NULL) {
+        return;
     }
+    xEventGroupSetBits(funasr_events, FUNASR_EVT_STOP);
+    xEventGroupWaitBits(funasr_events, FUNASR_EVT_STOPPED, pdFALSE, pdFALSE, portMAX_DELAY);
 }
 
+/* 设置上传编码器 */
+void funasr_set_encoder(audio_encoder_t *encoder)
+{
+    funasr_encoder = encoder;
+}
 
+/* 编码并发送PCM, 调用方持有funasr_lock */
+static esp_err_t funasr_send_pcm_locked(const int16_t *pcm, size_t samples)
+{
+    if (!funasr_encoder) {
+        return funasr_send_audio_locked((const uint8_t *)pcm, samples * sizeof(int16_t));
+    }
+
+    while (samples > 0) {
+        size_t n = samples > FUNASR_MAX_FRAME_SAMPLES ? FUNASR_MAX_FRAME_SAMPLES : samples;
+        size_t bytes = audio_encoder_encode(funasr_encoder, pcm, n, funasr_encoded);
+        esp_err_t ret = funasr_send_audio_locked(funasr_encoded, bytes);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        pcm += n;
+        samples -= n;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 编码并发送PCM
+ *
+ * 未设置编码器时直接发送原始PCM. 每条消息独立编码, 服务器端可以逐条解码.
+ * 语音段中的音频同时记入补发缓冲区; 断线期间只记录不发送, 立即返回.
+ *
+ * @param pcm 16kHz单声道PCM
+ * @param samples 样本数
+ * @return esp_err_t ESP_OK:发送成功 ESP_ERR_INVALID_STATE:未连接, 等待补发 ESP_FAIL:发送失败
+ */
+esp_err_t funasr_websocket_send_pcm(const int16_t *pcm, size_t samples)
+{
+    if (funasr_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
+    xSemaphoreTake(funasr_lock, portMAX_DELAY);
+    if (funasr_stream_open) {
+        funasr_replay_push(pcm, samples);
+    }
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (funasr_stream_synced || !funasr_stream_open) {
+        ret = funasr_send_pcm_locked(pcm, samples);
+        if (ret != ESP_OK) {
+            funasr_stream_synced = false;
+        }
+    }
+    xSemaphoreGive(funasr_lock);
+    return ret;
+}
+
+/* 获取音频发送统计 */
+void funasr_get_send_stats(funasr_send_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    stats->messages = metric_get(&funasr_m_send_us);
+    stats->failures = metric_get(&funasr_m_send_failures);
+    stats->bytes = funasr_send_bytes;
+    stats->max_us = metric_get_max(&funasr_m_send_us);
+    for (uint8_t i = 0; i < FUNASR_SEND_HIST_BUCKETS; i++) {
+        stats->hist[i] = metric_get_bucket(&funasr_m_send_us, i);
+    }
+}
+
+/* 获取连接统计 */
+void funasr_get_conn_stats(funasr_conn_stats_t *stats)
+{
+    if (stats) {
+        *stats = funasr_conn_stats;
+    }
+}
@@ -14,13 +14,80 @@
 #include <stddef.h>
 #include "esp_err.h"
 #include "esp_event.h"
+#include "audio_codec.h"
+
+/* funasr_websocket_send_pcm单次编码的最大样本数, 更长的分成多条消息 */
+#define FUNASR_MAX_FRAME_SAMPLES    4800
+
+/* WebSocket收发缓冲区大小(字节), 单条消息不超过它时不会被拆成多个分片 */
+#define FUNASR_WS_BUFFER_SIZE       4096
+
+/* 发送耗时直方图(指标funasr.send_us)各桶的上界(微秒, 不含), 最后一桶收集500ms及以上的发送 */
+#define FUNASR_SEND_HIST_BOUNDS_US  1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000
+#define FUNASR_SEND_HIST_BUCKETS    10
+
+/* 断线重连的退避间隔(毫秒): 从最小值开始每次加倍, 连接成功后复位 */
+#define FUNASR_BACKOFF_MIN_MS       500
+#define FUNASR_BACKOFF_MAX_MS       30000
+
+/* 等待连接建立的超时(毫秒) */
+#define FUNASR_CONNECT_TIMEOUT_MS   10000
+
+/* 单条消息的发送超时(毫秒), 超时按断线处理 */
+#define FUNASR_SEND_TIMEOUT_MS      5000
+
+/* 重连后补发的当前语音段最近音频时长(毫秒), 缓冲区放在PSRAM */
+#define FUNASR_REPLAY_MS            3000
+
+/* 没有PSRAM时改用内部RAM中的短缓冲区(毫秒, 640ms = 20KB) */
+#define FUNASR_REPLAY_INTERNAL_MS   640
+
+/* 连接统计 */
+typedef struct {
+    uint32_t connects;                  // 成功建立连接的次数
+    uint32_t disconnects;               // 断线次数
+    uint32_t replays;                   // 重连后补发语音段的次数
+    uint32_t replayed_samples;          // 补发的样本数
+    uint32_t replay_overflow_samples;   // 语音段超出补发缓冲区而无法补发的样本数
+    uint32_t backoff_ms;                // 最近一次的重连等待时间
+} funasr_conn_stats_t;
+
+/* 音频发送统计, 除字节数外都取自运行期指标funasr.send_us和funasr.send_failures */
+typedef struct {
+    uint32_t messages;                              // 发送的音频消息数
+    uint32_t failures;                              // 发送失败次数
+    uint64_t bytes;                                 // 发送的字节数
+    uint32_t max_us;                                // 最大单条发送耗时
+    uint32_t hist[FUNASR_SEND_HIST_BUCKETS];        // 发送耗时直方图
+} funasr_send_stats_t;
+
+/* 识别结果回调函数类型, 收到"2pass-offline"最终结果时调用
+ * 在WebSocket任务中执行, 回调内不应做耗时操作 */
+typedef void (*funasr_result_callback_t)(const char *text);
 
 /* 函数声明 */
+void funasr_set_result_callback(funasr_result_callback_t callback);
 esp_err_t funasr_websocket_init(const char *uri, bool is_ssl);
 esp_err_t funasr_send_start_frame(void);
 esp_err_t funasr_send_finish_frame(void);
 esp_err_t funasr_websocket_send_audio(const uint8_t *data, size_t len);
+
+/* 设置上传编码器, NULL表示直接发送PCM; 开始帧中的wav_format随之变化 */
+void funasr_set_encoder(audio_encoder_t *encoder);
+
+/* 经过上传编码器发送16kHz PCM */
+esp_err_t funasr_websocket_send_pcm(const int16_t *pcm, size_t samples);
+
+/* 获取音频发送统计 */
+void funasr_get_send_stats(funasr_send_stats_t *stats);
+
+/* 获取连接统计 */
+void funasr_get_conn_stats(funasr_conn_stats_t *stats);
 void funasr_websocket_cleanup(void);
 
+/* 回放抓包(traffic_capture): 把一条收到的消息交给事件处理函数, 只处理数据事件,
+ * data需以'\0'结尾. 不需要先调用funasr_websocket_init */
+void funasr_replay_event(int32_t event_id, uint8_t op_code, const char *data, int len);
+
 #endif
 
@@ -0,0 +1,64 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/* 保存最近多少段语音的记录 */
+#define LATENCY_TRACE_DEPTH     32
+
+/* 串口输出每行的前缀, tools/latency_report.py按此解析 */
+#define LATENCY_TRACE_TAG       "LTRACE"
+
+/**
+ * @brief 一段语音从说完到开始播报经过的各点, 按先后顺序
+ */
+typedef enum {
+    LATENCY_TRACE_SPEECH_END = 0,       // 最后一帧语音发出(结束帧), 开始一条记录
+    LATENCY_TRACE_ASR_FINAL,            // 收到最终识别结果
+    LATENCY_TRACE_LLM_FIRST_TOKEN,      // 收到大模型第一个token
+    LATENCY_TRACE_TTS_FIRST_SAMPLE,     // 合成(或缓存)给出第一段PCM
+    LATENCY_TRACE_PLAYBACK_START,       // 第一次写入喇叭
+    LATENCY_TRACE_POINTS,
+} latency_trace_point_t;
+
+/**
+ * @brief 一条记录
+ *
+ * 各点存为相对语音结束的微秒偏移(32位, 可原子读写), 0表示还没到达.
+ * id为0表示空槽或正在改写.
+ */
+typedef struct {
+    _Atomic uint32_t id;
+    int64_t start_us;
+    _Atomic uint32_t offset_us[LATENCY_TRACE_POINTS];
+} latency_trace_record_t;
+
+/**
+ * @brief 开始一段语音的记录(在发出结束帧后调用), 之后的打点都记到这一段
+ *
+ * @return 记录编号
+ */
+uint32_t latency_trace_begin(void);
+
+/**
+ * @brief 在当前记录上打点
+ *
+ * 可在任意任务中调用, 不加锁. 每个点只记第一次, 并且前一个点到达后才记,
+ * 这样被打断的旧应答晚到的结果不会记到新的一段上.
+ */
+void latency_trace_mark(latency_trace_point_t point);
+
+/**
+ * @brief 把已结束的记录逐行输出到串口, 每条只输出一次
+ *
+ * 格式: LTRACE <编号> <语音结束时刻us> <识别> <首token> <首段PCM> <开始播放>,
+ * 后四项是相对语音结束的微秒数, -1表示未到达.
+ * 当前记录要等到完整或被下一段取代后才输出. 只应在一个任务中调用.
+ *
+ * @param all 为true时当前记录不完整也输出(例如退出前)
+ */
+void latency_trace_dump(bool all);
+
+#endif /* LATENCY_TRACE_H */
@@ -0,0 +1,105 @@
+/*
+ * 端到端延迟打点
+ *
+ * 固定大小的环形记录, 打点只有几次原子读写, 可在播放等高优先级任务中使用.
+ * 开始记录只在上传任务中进行, 输出在低优先级任务中进行.
+ */
+
+#include "latency_trace.h"
+#include <stdio.h>
+#include "esp_timer.h"
+
+static latency_trace_record_t s_ring[LATENCY_TRACE_DEPTH];
+static _Atomic uint32_t s_current;      // 当前记录编号, 0表示还没有
+static uint32_t s_next_id;              // 只在latency_trace_begin中使用
+static uint32_t s_dumped_id;            // 只在latency_trace_dump中使用
+
+static inline latency_trace_record_t *slot(uint32_t id)
+{
+    return &s_ring[id % LATENCY_TRACE_DEPTH];
+}
+
+uint32_t latency_trace_begin(void)
+{
+    uint32_t id = ++s_next_id;
+    if (id == 0) {
+        id = ++s_next_id;
+    }
+    latency_trace_record_t *rec = slot(id);
+
+    // 先作废旧记录再改写, 读方据此丢弃改写中的内容
+    atomic_store_explicit(&rec->id, 0, memory_order_release);
+    rec->start_us = esp_timer_get_time();
+    for (int i = 0; i < LATENCY_TRACE_POINTS; i++) {
+        atomic_store_explicit(&rec->offset_us[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&rec->offset_us[LATENCY_TRACE_SPEECH_END], 1, memory_order_relaxed);
+    atomic_store_explicit(&rec->id, id, memory_order_release);
+    atomic_store_explicit(&s_current, id, memory_order_release);
+    return id;
+}
+
+void latency_trace_mark(latency_trace_point_t point)
+{
+    if (point <= LATENCY_TRACE_SPEECH_END || point >= LATENCY_TRACE_POINTS) {
+        return;
+    }
+    uint32_t id = atomic_load_explicit(&s_current, memory_order_acquire);
+    if (id == 0) {
+        return;
+    }
+    latency_trace_record_t *rec = slot(id);
+    if (atomic_load_explicit(&rec->id, memory_order_acquire) != id ||
+        atomic_load_explicit(&rec->offset_us[point], memory_order_relaxed) != 0 ||
+        atomic_load_explicit(&rec->offset_us[point - 1], memory_order_relaxed) == 0) {
+        return;
+    }
+
+    int64_t offset = esp_timer_get_time() - rec->start_us;
+    if (offset < 1) {
+        offset = 1;
+    } else if (offset > UINT32_MAX) {
+        offset = UINT32_MAX;
+    }
+    atomic_store_explicit(&rec->offset_us[point], (uint32_t)offset, memory_order_relaxed);
+}
+
+void latency_trace_dump(bool all)
+{
+    uint32_t current = atomic_load_explicit(&s_current, memory_order_acquire);
+
+    // 落后太多时, 被覆盖的记录直接跳过
+    if (current - s_dumped_id > LATENCY_TRACE_DEPTH) {
+        s_dumped_id = current - LATENCY_TRACE_DEPTH;
+    }
+
+    while (s_dumped_id != current) {
+        uint32_t id = s_dumped_id + 1;
+        latency_trace_record_t *rec = slot(id);
+        uint32_t offset[LATENCY_TRACE_POINTS];
+
+        if (atomic_load_explicit(&rec->id, memory_order_acquire) != id) {
+            s_dumped_id = id;
+            continue;
+        }
+        int64_t start_us = rec->start_us;
+        for (int i = 0; i < LATENCY_TRACE_POINTS; i++) {
+            offset[i] = atomic_load_explicit(&rec->offset_us[i], memory_order_relaxed);
+        }
+        if (id == current && !all && offset[LATENCY_TRACE_POINTS - 1] == 0) {
+            break;
+        }
+        // 读取期间被改写则丢弃
+        if (atomic_load_explicit(&rec->id, memory_order_acquire) != id) {
+            s_dumped_id = id;
+            continue;
+        }
+
+        printf(LATENCY_TRACE_TAG " %lu %lld", (unsigned long)id, (long long)start_us);
+        for (int i = LATENCY_TRACE_SPEECH_END + 1; i < LATENCY_TRACE_POINTS; i++) {
+            printf(" %ld", offset[i] ? (long)offset[i] : -1L);
+        }
+        printf("\n");
+        s_dumped_id = id;
+    }
+}
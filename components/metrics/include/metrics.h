@@ -0,0 +1,141 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+
+/* 注册表容量 */
+#define METRICS_MAX             48
+
+/* 二进制快照的魔数("MET1", 小端) */
+#define METRICS_BINARY_MAGIC    0x3154454Du
+
+typedef enum {
+    METRIC_COUNTER = 0,     // 只增计数
+    METRIC_GAUGE,           // 当前值/水位
+    METRIC_HISTOGRAM,       // 固定分桶直方图
+} metric_type_t;
+
+/**
+ * @brief 一个指标
+ *
+ * 静态定义(见下方宏), 更新只有一两次relaxed原子操作, 不加锁;
+ * 在模块初始化时注册一次, 之后快照可以读到.
+ */
+typedef struct {
+    const char *name;
+    metric_type_t type;
+    atomic_flag registered;
+    _Atomic uint32_t value;             // 计数/当前值; 直方图为样本数
+    _Atomic uint32_t max;               // 直方图最大样本
+    const uint32_t *bounds;             // 直方图各桶上界(不含), 最后一桶无上界
+    _Atomic uint32_t *counts;
+    uint8_t buckets;
+} metric_t;
+
+/* 以下宏定义文件内的静态指标 */
+#define METRIC_COUNTER_DEFINE(var, metric_name) \
+    static metric_t var = { .name = (metric_name), .type = METRIC_COUNTER, .registered = ATOMIC_FLAG_INIT }
+
+#define METRIC_GAUGE_DEFINE(var, metric_name) \
+    static metric_t var = { .name = (metric_name), .type = METRIC_GAUGE, .registered = ATOMIC_FLAG_INIT }
+
+/* 上界列表写在最后, 桶数为上界个数加一 */
+#define METRIC_HISTOGRAM_DEFINE(var, metric_name, ...)                                  \
+    static const uint32_t var##_bounds[] = { __VA_ARGS__ };                             \
+    static _Atomic uint32_t var##_counts[sizeof(var##_bounds) / sizeof(uint32_t) + 1];  \
+    static metric_t var = { .name = (metric_name), .type = METRIC_HISTOGRAM,            \
+                            .registered = ATOMIC_FLAG_INIT,                             \
+                            .bounds = var##_bounds, .counts = var##_counts,             \
+                            .buckets = sizeof(var##_bounds) / sizeof(uint32_t) + 1 }
+
+static inline void metric_add(metric_t *m, uint32_t n)
+{
+    atomic_fetch_add_explicit(&m->value, n, memory_order_relaxed);
+}
+
+static inline void metric_inc(metric_t *m)
+{
+    metric_add(m, 1);
+}
+
+static inline void metric_set(metric_t *m, uint32_t v)
+{
+    atomic_store_explicit(&m->value, v, memory_order_relaxed);
+}
+
+/* 水位: 只在更低时更新(例如堆最小空闲) */
+static inline void metric_set_min(metric_t *m, uint32_t v)
+{
+    uint32_t cur = atomic_load_explicit(&m->value, memory_order_relaxed);
+    while ((cur == 0 || v < cur) &&
+           !atomic_compare_exchange_weak_explicit(&m->value, &cur, v, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static inline void metric_observe(metric_t *m, uint32_t v)
+{
+    uint8_t i = 0;
+    while (i + 1 < m->buckets && v >= m->bounds[i]) {
+        i++;
+    }
+    atomic_fetch_add_explicit(&m->counts[i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->value, 1, memory_order_relaxed);
+
+    uint32_t cur = atomic_load_explicit(&m->max, memory_order_relaxed);
+    while (v > cur &&
+           !atomic_compare_exchange_weak_explicit(&m->max, &cur, v, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/* 读取当前值, 直方图为样本数 */
+static inline uint32_t metric_get(metric_t *m)
+{
+    return atomic_load_explicit(&m->value, memory_order_relaxed);
+}
+
+/* 直方图的最大样本 */
+static inline uint32_t metric_get_max(metric_t *m)
+{
+    return atomic_load_explicit(&m->max, memory_order_relaxed);
+}
+
+/* 直方图第i桶的计数, 越界为0 */
+static inline uint32_t metric_get_bucket(metric_t *m, uint8_t i)
+{
+    return i < m->buckets ? atomic_load_explicit(&m->counts[i], memory_order_relaxed) : 0;
+}
+
+/**
+ * @brief 注册指标, 可在任意任务中调用, 重复注册无效果
+ *
+ * @return esp_err_t ESP_ERR_NO_MEM: 注册表已满
+ */
+esp_err_t metrics_register(metric_t *m);
+
+/**
+ * @brief 文本快照: 每个指标一行, 直方图输出样本数/最大值/各桶计数
+ *
+ * @return 写入的字节数(不含'\0'); 缓冲区不够时截断在行边界
+ */
+size_t metrics_snapshot_text(char *buf, size_t len);
+
+/**
+ * @brief 二进制快照(小端), 由tools/metrics_decode.py解析
+ *
+ * 魔数(4) 个数(2), 之后每个指标: 类型(1) 名字长度(1) 名字 值(4),
+ * 直方图再跟: 最大值(4) 桶数(1) 上界(4 x 桶数-1) 计数(4 x 桶数)
+ *
+ * @return 写入的字节数; 缓冲区不够时返回0
+ */
+size_t metrics_snapshot_binary(uint8_t *buf, size_t len);
+
+/**
+ * @brief 把文本快照输出到串口
+ */
+void metrics_dump(void);
+
+#endif /* METRICS_H */
@@ -0,0 +1,170 @@
+/*
+ * 运行期指标注册表
+ *
+ * 注册只追加: 先原子地占一个槽位再发布指针, 快照跳过还没发布的槽位.
+ * 快照逐个读取原子值, 各指标之间不保证是同一时刻, 对统计用途足够.
+ */
+
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+
+static _Atomic(metric_t *) s_metrics[METRICS_MAX];
+static _Atomic uint32_t s_reserved;
+
+esp_err_t metrics_register(metric_t *m)
+{
+    if (!m || !m->name) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_flag_test_and_set(&m->registered)) {
+        return ESP_OK;
+    }
+    uint32_t slot = atomic_fetch_add_explicit(&s_reserved, 1, memory_order_relaxed);
+    if (slot >= METRICS_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    atomic_store_explicit(&s_metrics[slot], m, memory_order_release);
+    return ESP_OK;
+}
+
+static inline uint32_t registered_count(void)
+{
+    uint32_t n = atomic_load_explicit(&s_reserved, memory_order_relaxed);
+    return n < METRICS_MAX ? n : METRICS_MAX;
+}
+
+static inline uint32_t load(_Atomic uint32_t *v)
+{
+    return atomic_load_explicit(v, memory_order_relaxed);
+}
+
+// 输出一个指标的文本, 返回写入的字节数, 放不下返回0
+static size_t format_metric(metric_t *m, char *buf, size_t len)
+{
+    int n;
+
+    if (m->type != METRIC_HISTOGRAM) {
+        n = snprintf(buf, len, "%s %lu\n", m->name, (unsigned long)load(&m->value));
+        return n > 0 && (size_t)n < len ? (size_t)n : 0;
+    }
+
+    n = snprintf(buf, len, "%s count=%lu max=%lu", m->name,
+                 (unsigned long)load(&m->value), (unsigned long)load(&m->max));
+    size_t pos = n > 0 ? (size_t)n : len;
+    for (uint8_t i = 0; i < m->buckets && pos < len; i++) {
+        if (i + 1 < m->buckets) {
+            n = snprintf(buf + pos, len - pos, " <%lu:%lu", (unsigned long)m->bounds[i],
+                         (unsigned long)load(&m->counts[i]));
+        } else {
+            n = snprintf(buf + pos, len - pos, " inf:%lu", (unsigned long)load(&m->counts[i]));
+        }
+        pos += n > 0 ? (size_t)n : len;
+    }
+    if (pos + 1 >= len) {
+        return 0;
+    }
+    buf[pos++] = '\n';
+    buf[pos] = '\0';
+    return pos;
+}
+
+size_t metrics_snapshot_text(char *buf, size_t len)
+{
+    size_t pos = 0;
+    uint32_t count = registered_count();
+
+    if (!buf || len == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    for (uint32_t i = 0; i < count; i++) {
+        metric_t *m = atomic_load_explicit(&s_metrics[i], memory_order_acquire);
+        if (!m) {
+            continue;
+        }
+        size_t n = format_metric(m, buf + pos, len - pos);
+        if (n == 0) {
+            buf[pos] = '\0';
+            break;
+        }
+        pos += n;
+    }
+    return pos;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+size_t metrics_snapshot_binary(uint8_t *buf, size_t len)
+{
+    uint32_t count = registered_count();
+    uint8_t *p = buf;
+    uint8_t *end = buf + len;
+    uint16_t written = 0;
+
+    if (!buf || len < 6) {
+        return 0;
+    }
+    p = put_u32(p, METRICS_BINARY_MAGIC);
+    p += 2;     // 个数最后回填
+
+    for (uint32_t i = 0; i < count; i++) {
+        metric_t *m = atomic_load_explicit(&s_metrics[i], memory_order_acquire);
+        if (!m) {
+            continue;
+        }
+        size_t name_len = strlen(m->name);
+        if (name_len > 255) {
+            name_len = 255;
+        }
+        size_t need = 2 + name_len + 4;
+        if (m->type == METRIC_HISTOGRAM) {
+            need += 4 + 1 + 4 * (size_t)(m->buckets - 1) + 4 * (size_t)m->buckets;
+        }
+        if ((size_t)(end - p) < need) {
+            return 0;
+        }
+
+        *p++ = (uint8_t)m->type;
+        *p++ = (uint8_t)name_len;
+        memcpy(p, m->name, name_len);
+        p += name_len;
+        p = put_u32(p, load(&m->value));
+        if (m->type == METRIC_HISTOGRAM) {
+            p = put_u32(p, load(&m->max));
+            *p++ = m->buckets;
+            for (uint8_t b = 0; b + 1 < m->buckets; b++) {
+                p = put_u32(p, m->bounds[b]);
+            }
+            for (uint8_t b = 0; b < m->buckets; b++) {
+                p = put_u32(p, load(&m->counts[b]));
+            }
+        }
+        written++;
+    }
+
+    buf[4] = written & 0xff;
+    buf[5] = written >> 8;
+    return (size_t)(p - buf);
+}
+
+void metrics_dump(void)
+{
+    char line[192];
+    uint32_t count = registered_count();
+
+    // 逐行输出, 不需要一次放下整个快照的缓冲区
+    for (uint32_t i = 0; i < count; i++) {
+        metric_t *m = atomic_load_explicit(&s_metrics[i], memory_order_acquire);
+        if (m && format_metric(m, line, sizeof(line)) > 0) {
+            printf("METRIC %s", line);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef OLLAMA_CHUNKER_H
+#define OLLAMA_CHUNKER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief 分句参数
+ *
+ * 长度均以UTF-8字节计(一个汉字3字节).
+ */
+typedef struct {
+    size_t first_min_bytes;     // 第一块遇到逗号类标点时的最小长度, 小一些可降低首音延迟
+    size_t min_bytes;           // 后续块遇到逗号类标点时的最小长度, 避免切得过碎
+    size_t max_bytes;           // 一直没有标点时的强制切分长度
+} ollama_chunker_config_t;
+
+/* 默认参数: 首块2个汉字, 后续4个汉字, 最长40个汉字 */
+#define OLLAMA_CHUNKER_DEFAULT_CONFIG() { \
+    .first_min_bytes = 6,                 \
+    .min_bytes = 12,                      \
+    .max_bytes = 120,                     \
+}
+
+/**
+ * @brief 在累积文本中寻找第一个可以送去合成的切分点
+ *
+ * 句末标点(。！？；等)总是切分; 英文句点只在其后为空白或文本末尾, 且前面不是数字时
+ * 切分, 以免拆开3.14, v1.2, e.g.; 逗号类标点(，、：等)在长度达到最小值时切分;
+ * 超过最大长度时在字符边界强制切分.
+ *
+ * @param cfg 分句参数
+ * @param text 累积文本
+ * @param len 文本字节数
+ * @param first_chunk 是否为本次回复的第一块
+ * @return size_t 第一块的字节数, 0表示还不能切分
+ */
+size_t ollama_chunker_find_cut(const ollama_chunker_config_t *cfg, const char *text, size_t len, bool first_chunk);
+
+#endif /* OLLAMA_CHUNKER_H */
@@ -4,6 +4,57 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "ollama_chunker.h"
+#include "cancel_token.h"
+
+/* 默认模型, 可通过ollama_set_model修改 */
+#define OLLAMA_MODEL            "qwen2:0.5b"
+
+/* 对话上下文(context token)最多保存的个数, 决定预分配的内存(每个4字节) */
+#ifndef OLLAMA_CONTEXT_MAX_TOKENS
+#define OLLAMA_CONTEXT_MAX_TOKENS   2048
+#endif
+
+/* 请求结束后服务器保持模型常驻的时间 */
+#define OLLAMA_KEEP_ALIVE       "30m"
+
+/**
+ * @brief 连接复用统计
+ */
+typedef struct {
+    uint32_t requests;              // 发出的请求数(含预热)
+    uint32_t connects;              // 新建TCP连接次数
+    uint32_t reused;                // 复用已有连接且成功的请求数
+    uint32_t failures;              // 失败的请求数
+    int64_t last_first_byte_us;     // 最近一次请求从发出到收到首个数据的时间
+    int64_t last_total_us;          // 最近一次请求的总耗时
+    size_t context_tokens;          // 下一轮将携带的上下文token数
+} ollama_stats_t;
+
+/**
+ * @brief 上下文超出上限时的处理方式
+ */
+typedef enum {
+    OLLAMA_CONTEXT_EVICT_RESET = 0,     // 清空上下文, 下一轮重新开始
+    OLLAMA_CONTEXT_EVICT_DROP_OLDEST,   // 丢弃最旧的token, 保留最近的部分
+} ollama_context_evict_t;
+
+/**
+ * @brief 对话上下文缓存配置
+ */
+typedef struct {
+    bool enable;                        // 是否携带上一轮返回的context
+    size_t max_tokens;                  // 上限, 不超过OLLAMA_CONTEXT_MAX_TOKENS
+    ollama_context_evict_t evict;       // 超出上限时的处理方式
+    uint32_t idle_reset_ms;             // 超过该时间没有对话则清空上下文, 0表示不清空
+} ollama_context_config_t;
+
+#define OLLAMA_CONTEXT_DEFAULT_CONFIG() {               \
+    .enable = true,                                     \
+    .max_tokens = OLLAMA_CONTEXT_MAX_TOKENS,            \
+    .evict = OLLAMA_CONTEXT_EVICT_DROP_OLDEST,          \
+    .idle_reset_ms = 5 * 60 * 1000,                     \
+}
 
 /**
  * @brief Ollama响应回调函数类型
@@ -27,6 +78,33 @@ esp_err_t ollama_init(const char *ollama_uri);
  */
 void ollama_set_response_callback(ollama_response_callback_t callback);
 
+/**
+ * @brief 设置流式回复的分句参数
+ * 
+ * @param config 分句参数, 见OLLAMA_CHUNKER_DEFAULT_CONFIG()
+ */
+void ollama_set_chunker_config(const ollama_chunker_config_t *config);
+
+/**
+ * @brief 设置使用的模型
+ * 
+ * @param model 模型名, 例如"qwen2:0.5b"
+ * @return esp_err_t 
+ */
+esp_err_t ollama_set_model(const char *model);
+
+/**
+ * @brief 设置对话上下文缓存策略
+ * 
+ * @param config 配置, 见OLLAMA_CONTEXT_DEFAULT_CONFIG()
+ */
+void ollama_set_context_config(const ollama_context_config_t *config);
+
+/**
+ * @brief 清空对话上下文, 下一轮对话重新开始
+ */
+void ollama_reset_context(void);
+
 /**
  * @brief 发送文本到Ollama进行对话
  * 
@@ -35,6 +113,59 @@ void ollama_set_response_callback(ollama_response_callback_t callback);
  */
 esp_err_t ollama_chat(const char *text);
 
+/**
+ * @brief 预热: 让服务器加载模型并建立长连接
+ * 
+ * 发送不带prompt的请求, 服务器只加载模型, 不生成文本.
+ * 会阻塞到模型加载完成, 应在发起对话的任务中调用.
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t ollama_warmup(void);
+
+/**
+ * @brief 获取连接复用统计
+ * 
+ * @param stats 输出统计
+ */
+void ollama_get_stats(ollama_stats_t *stats);
+
+/**
+ * @brief 发送文本到Ollama进行对话, 可被取消
+ * 
+ * 每收到一段数据都会检查令牌, 令牌被取消后立即中断HTTP请求,
+ * 不再触发响应回调. 上一轮的对话上下文保持不变.
+ * 
+ * @param text 要发送的文本
+ * @param cancel 取消令牌, NULL表示不可取消
+ * @return esp_err_t ESP_ERR_INVALID_STATE: 请求被取消
+ */
+esp_err_t ollama_chat_cancellable(const char *text, const cancel_token_t *cancel);
+
+/**
+ * @brief 回放抓包(traffic_capture): 开始一次回复, 复位解析状态
+ *
+ * 需要先调用ollama_init, 但不会发起网络请求.
+ */
+void ollama_replay_begin(void);
+
+/**
+ * @brief 回放抓包: 把一个HTTP事件交给事件处理函数
+ *
+ * @param event_id esp_http_client_event_id_t
+ * @param data 数据事件的负载, 其它事件为NULL
+ * @param len 负载字节数
+ * @return esp_err_t 
+ */
+esp_err_t ollama_replay_event(int32_t event_id, const char *data, int len);
+
+/**
+ * @brief 回放抓包: 结束一次回复, 与ollama_chat在请求返回后的处理相同
+ *
+ * 最终消息的context完整解析后成为下一轮的上下文; 解析到一半出错时清空上下文.
+ */
+void ollama_replay_end(void);
+
 /**
  * @brief 清理Ollama客户端资源
  */
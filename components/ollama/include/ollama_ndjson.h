@@ -0,0 +1,95 @@
+#ifndef OLLAMA_NDJSON_H
+#define OLLAMA_NDJSON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 单条消息中response字段的最大字节数(解码后, 不含结尾'\0') */
+#define OLLAMA_NDJSON_TEXT_MAX      255
+
+/* 需要识别的字段名最大长度 */
+#define OLLAMA_NDJSON_KEY_MAX       15
+
+/**
+ * @brief 从一行JSON中提取出的字段
+ */
+typedef struct {
+    char response[OLLAMA_NDJSON_TEXT_MAX + 1];  // 已反转义的UTF-8文本
+    size_t response_len;
+    bool has_response;
+    bool truncated;                             // response超出缓冲区被截断
+    bool done;
+    bool has_context;                           // 本行包含context数组
+    size_t context_total;                       // context数组元素总数(可能超过缓冲区容量)
+} ollama_ndjson_msg_t;
+
+/**
+ * @brief 每解析完一个顶层JSON对象调用一次
+ */
+typedef void (*ollama_ndjson_callback_t)(const ollama_ndjson_msg_t *msg, void *ctx);
+
+/**
+ * @brief 增量NDJSON解析器
+ *
+ * 不做动态内存分配, 不构建JSON树. 数据可以在任意字节处被切分,
+ * 一次输入也可以包含多行. 只提取顶层的response, done和context字段,
+ * 其他字段(包括嵌套的对象/数组)被跳过.
+ */
+typedef struct {
+    uint8_t state;
+    uint8_t field;                      // 当前值对应的字段
+    uint8_t key_len;
+    char key[OLLAMA_NDJSON_KEY_MAX + 1];
+    char literal[8];                    // true/false/null/数字
+    uint8_t literal_len;
+    uint8_t hex_count;                  // \uXXXX已读位数
+    uint16_t hex_value;
+    uint16_t high_surrogate;            // 等待低代理项的高代理项
+    uint32_t nest_depth;                // 跳过的嵌套对象/数组深度
+    bool nest_in_string;
+    bool nest_escape;
+    int32_t number;                     // context中正在解析的整数
+    bool number_neg;
+    bool number_valid;
+    int32_t *context_buf;               // context写入位置, NULL表示跳过
+    size_t context_cap;
+    bool context_written;               // 进入过context数组, 缓冲区可能已被改写; 只由init清除
+    uint32_t errors;                    // 累计格式错误行数
+    ollama_ndjson_msg_t msg;
+} ollama_ndjson_t;
+
+/**
+ * @brief 初始化(或复位)解析器
+ *
+ * context元素边解析边写入缓冲区, 所在行格式错误时msg.has_context为false且不会回调,
+ * 但缓冲区已被部分改写; 调用方据context_written判断缓冲区中原有内容是否还可信.
+ */
+void ollama_ndjson_init(ollama_ndjson_t *parser);
+
+/**
+ * @brief 设置context数组的写入缓冲区
+ *
+ * 元素按环形方式写入: 第i个元素写到 buf[i % cap], 超出容量时保留的是
+ * 最后cap个元素, 起始位置为 context_total % cap.
+ *
+ * @param parser 解析器
+ * @param buf 缓冲区, NULL表示不提取context
+ * @param cap 缓冲区元素个数
+ */
+void ollama_ndjson_set_context_buffer(ollama_ndjson_t *parser, int32_t *buf, size_t cap);
+
+/**
+ * @brief 输入一段原始字节
+ *
+ * @param parser 解析器
+ * @param data 数据
+ * @param len 字节数
+ * @param callback 每个完整对象的回调
+ * @param ctx 回调上下文
+ * @return size_t 本次输入中解析完成的对象数
+ */
+size_t ollama_ndjson_feed(ollama_ndjson_t *parser, const char *data, size_t len,
+                          ollama_ndjson_callback_t callback, void *ctx);
+
+#endif /* OLLAMA_NDJSON_H */
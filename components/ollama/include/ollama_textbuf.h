@@ -0,0 +1,77 @@
+#ifndef OLLAMA_TEXTBUF_H
+#define OLLAMA_TEXTBUF_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* 初始容量(字节), 在ollama_init时一次性分配 */
+#ifndef OLLAMA_TEXTBUF_INITIAL
+#define OLLAMA_TEXTBUF_INITIAL      512
+#endif
+
+/* 容量上限(字节), 超过时调用方应先把已有文本送出 */
+#ifndef OLLAMA_TEXTBUF_HIGH_WATER
+#define OLLAMA_TEXTBUF_HIGH_WATER   4096
+#endif
+
+/**
+ * @brief 可复用的文本缓冲区
+ *
+ * 追加为均摊O(1): 已消费的前缀用读偏移跳过, 空间不足时先整理再按倍数扩容.
+ * 每次回复结束只复位偏移, 不释放内存, 避免长对话中反复分配造成堆碎片.
+ * 缓冲区内容始终以'\0'结尾.
+ */
+typedef struct {
+    char *buf;
+    size_t cap;             // 已分配字节数
+    size_t start;           // 未消费文本的起始偏移
+    size_t len;             // 未消费文本的长度
+    size_t high_water;      // 容量上限
+    size_t peak;            // 历史最大未消费长度
+} ollama_textbuf_t;
+
+/**
+ * @brief 分配初始容量
+ */
+esp_err_t ollama_textbuf_init(ollama_textbuf_t *tb, size_t initial, size_t high_water);
+
+/**
+ * @brief 释放缓冲区
+ */
+void ollama_textbuf_deinit(ollama_textbuf_t *tb);
+
+/**
+ * @brief 追加文本
+ *
+ * @return true 成功; false 超过容量上限或内存不足, 内容不变
+ */
+bool ollama_textbuf_append(ollama_textbuf_t *tb, const char *text, size_t len);
+
+/**
+ * @brief 丢弃开头的n个字节
+ */
+void ollama_textbuf_consume(ollama_textbuf_t *tb, size_t n);
+
+/**
+ * @brief 清空内容, 保留已分配的内存
+ */
+void ollama_textbuf_reset(ollama_textbuf_t *tb);
+
+/**
+ * @brief 未消费文本的起始地址(可写, 以'\0'结尾)
+ */
+static inline char *ollama_textbuf_data(ollama_textbuf_t *tb)
+{
+    return tb->buf + tb->start;
+}
+
+/**
+ * @brief 未消费文本的长度
+ */
+static inline size_t ollama_textbuf_len(const ollama_textbuf_t *tb)
+{
+    return tb->len;
+}
+
+#endif /* OLLAMA_TEXTBUF_H */
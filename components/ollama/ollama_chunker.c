@@ -0,0 +1,91 @@
+/*
+ * 按子句切分大模型的流式输出
+ *
+ * 原先只有收到整句"。"或整个回复结束才触发合成, 用户要等很久
+ * 才能听到第一个字. 这里按标点和长度切分, 子句一完整就送去合成.
+ */
+
+#include "ollama_chunker.h"
+
+#include <ctype.h>
+#include <string.h>
+
+typedef enum {
+    PUNC_NONE = 0,
+    PUNC_WEAK,      // 子句内停顿, 达到最小长度才切
+    PUNC_STRONG,    // 句末, 总是切
+} punc_class_t;
+
+// 判断text[i]开始的字符是否为标点, 返回其类别并通过char_len输出字符字节数
+static punc_class_t classify(const char *text, size_t len, size_t i, size_t *char_len)
+{
+    static const char *const strong[] = {"。", "！", "？", "；", "…"};
+    static const char *const weak[] = {"，", "、", "："};
+    unsigned char c = (unsigned char)text[i];
+
+    if (c < 0x80) {
+        *char_len = 1;
+        if (c == '.') {
+            // 小数点, 版本号和缩写(3.14, v1.2, e.g.)中的点不是句末:
+            // 后面是空白或文本末尾, 并且前面不是数字时才切分
+            bool followed = i + 1 >= len || isspace((unsigned char)text[i + 1]);
+            bool after_digit = i > 0 && isdigit((unsigned char)text[i - 1]);
+            return followed && !after_digit ? PUNC_STRONG : PUNC_NONE;
+        }
+        if (c == '!' || c == '?' || c == ';' || c == '\n') {
+            return PUNC_STRONG;
+        }
+        if (c == ',' || c == ':') {
+            return PUNC_WEAK;
+        }
+        return PUNC_NONE;
+    }
+
+    *char_len = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+    if (*char_len != 3 || i + 3 > len) {
+        return PUNC_NONE;
+    }
+    for (size_t k = 0; k < sizeof(strong) / sizeof(strong[0]); k++) {
+        if (memcmp(text + i, strong[k], 3) == 0) {
+            return PUNC_STRONG;
+        }
+    }
+    for (size_t k = 0; k < sizeof(weak) / sizeof(weak[0]); k++) {
+        if (memcmp(text + i, weak[k], 3) == 0) {
+            return PUNC_WEAK;
+        }
+    }
+    return PUNC_NONE;
+}
+
+size_t ollama_chunker_find_cut(const ollama_chunker_config_t *cfg, const char *text, size_t len, bool first_chunk)
+{
+    size_t min_bytes = first_chunk ? cfg->first_min_bytes : cfg->min_bytes;
+    size_t last_boundary = 0;   // 不超过max_bytes的最后一个字符边界
+    size_t i = 0;
+
+    while (i < len) {
+        size_t char_len = 1;
+        punc_class_t punc = classify(text, len, i, &char_len);
+        if (i + char_len > len) {
+            // 不完整的多字节字符, 等待后续token
+            break;
+        }
+        size_t end = i + char_len;
+
+        if (punc == PUNC_STRONG) {
+            return end;
+        }
+        if (punc == PUNC_WEAK && end >= min_bytes) {
+            return end;
+        }
+        if (end <= cfg->max_bytes) {
+            last_boundary = end;
+        } else {
+            return last_boundary;
+        }
+        i = end;
+    }
+
+    return 0;
+}
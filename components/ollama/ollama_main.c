@@ -1,18 +1,171 @@
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include "esp_log.h"
 #include "esp_http_client.h"
+#include "esp_timer.h"
 #include "cJSON.h"
 #include "ollama_main.h"
+#include "ollama_chunker.h"
+#include "ollama_ndjson.h"
+#include "ollama_textbuf.h"
+#include "latency_trace.h"
+#include "metrics.h"
+#include "trace_log.h"
+#include "traffic_capture.h"
 
 static const char *TAG = "OLLAMA";
 static char *s_ollama_uri = NULL;
+static char s_model[64] = OLLAMA_MODEL;
 static esp_http_client_handle_t s_client = NULL;
 static ollama_response_callback_t s_response_callback = NULL;
 
-// 用于累积响应文本的缓冲区
-static char *s_accumulated_text = NULL;
-static size_t s_accumulated_len = 0;
+// 用于累积响应文本的缓冲区, 在ollama_init时预分配并在各次回复间复用
+static ollama_textbuf_t s_accumulated;
+
+// 分句参数, 以及当前回复是否还没送出第一块
+static ollama_chunker_config_t s_chunker_config = OLLAMA_CHUNKER_DEFAULT_CONFIG();
+static bool s_first_chunk = true;
+
+// 连接复用统计; 本次请求是否新建了连接, 以及请求开始时间
+static ollama_stats_t s_stats;
+
+// 运行期指标
+METRIC_COUNTER_DEFINE(s_m_requests, "ollama.requests");
+METRIC_COUNTER_DEFINE(s_m_failures, "ollama.failures");
+METRIC_COUNTER_DEFINE(s_m_connects, "ollama.connects");
+METRIC_COUNTER_DEFINE(s_m_reused, "ollama.reused");
+METRIC_COUNTER_DEFINE(s_m_json_errors, "ollama.json_errors");
+METRIC_HISTOGRAM_DEFINE(s_m_first_byte_ms, "ollama.first_byte_ms",
+                        50, 100, 200, 300, 500, 1000, 2000, 5000);
+static bool s_request_connected = false;
+static int64_t s_request_start_us = 0;
+
+// 当前请求的取消令牌, 以及是否已经因取消而中断
+static const cancel_token_t *s_cancel = NULL;
+static bool s_cancelled = false;
+
+// 流式响应解析器, 跨HTTP_EVENT_ON_DATA保持状态
+static ollama_ndjson_t s_ndjson;
+
+// 对话上下文: 上一轮最终消息返回的context, 下一轮原样带回,
+// 服务器只需计算新的token
+static ollama_context_config_t s_context_config = OLLAMA_CONTEXT_DEFAULT_CONFIG();
+static int32_t *s_context = NULL;
+static size_t s_context_len = 0;
+static bool s_context_updated = false;
+static int64_t s_last_turn_us = 0;
+
+// 原地循环左移n个元素(三次翻转)
+static void reverse_tokens(int32_t *a, size_t lo, size_t hi)
+{
+    while (lo + 1 < hi) {
+        int32_t t = a[lo];
+        a[lo++] = a[--hi];
+        a[hi] = t;
+    }
+}
+
+static void rotate_tokens(int32_t *a, size_t len, size_t n)
+{
+    reverse_tokens(a, 0, n);
+    reverse_tokens(a, n, len);
+    reverse_tokens(a, 0, len);
+}
+
+// 最终消息中的context已经写入s_context(环形), 按策略整理成线性数组
+static void update_context(const ollama_ndjson_msg_t *msg)
+{
+    size_t cap = s_ndjson.context_cap;
+
+    if (msg->context_total <= cap) {
+        s_context_len = msg->context_total;
+    } else if (s_context_config.evict == OLLAMA_CONTEXT_EVICT_DROP_OLDEST) {
+        rotate_tokens(s_context, cap, msg->context_total % cap);
+        s_context_len = cap;
+        ESP_LOGI(TAG, "上下文 %u 个token超出上限, 保留最近 %u 个",
+                 (unsigned)msg->context_total, (unsigned)cap);
+    } else {
+        s_context_len = 0;
+        ESP_LOGI(TAG, "上下文 %u 个token超出上限, 清空", (unsigned)msg->context_total);
+    }
+    s_context_updated = true;
+}
+
+// 把累积文本中已经完整的子句依次交给回调; flush为true时剩余文本也全部送出
+static void emit_chunks(bool flush)
+{
+    if (!s_response_callback) {
+        return;
+    }
+
+    // 已取消的回复不再送出
+    if (s_cancelled || cancel_token_is_cancelled(s_cancel)) {
+        ollama_textbuf_reset(&s_accumulated);
+        return;
+    }
+
+    while (ollama_textbuf_len(&s_accumulated) > 0) {
+        char *text = ollama_textbuf_data(&s_accumulated);
+        size_t len = ollama_textbuf_len(&s_accumulated);
+        size_t cut = ollama_chunker_find_cut(&s_chunker_config, text, len, s_first_chunk);
+        if (cut == 0) {
+            if (!flush) {
+                break;
+            }
+            cut = len;
+        }
+
+        // 临时截断, 回调结束后恢复
+        char saved = text[cut];
+        text[cut] = '\0';
+        TRACE_LOGI_STR(TAG, "送出子句: %s", text, cut);
+        s_response_callback(text);
+        text[cut] = saved;
+
+        s_first_chunk = false;
+        ollama_textbuf_consume(&s_accumulated, cut);
+    }
+}
+
+// 每解析出一行完整的JSON调用一次
+static void handle_stream_message(const ollama_ndjson_msg_t *msg, void *ctx)
+{
+    // 检查是否有响应文本
+    if (msg->has_response && msg->response_len > 0) {
+        const char *text = msg->response;
+        latency_trace_mark(LATENCY_TRACE_LLM_FIRST_TOKEN);
+
+        // 问号不送去合成, 但它表示一个子句结束
+        if (strcmp(text, "？") == 0) {
+            TRACE_LOGD(TAG, "跳过问号");
+            emit_chunks(true);
+            return;
+        }
+
+        // 累积文本; 达到容量上限时先把已有文本全部送出
+        if (!ollama_textbuf_append(&s_accumulated, text, msg->response_len)) {
+            emit_chunks(true);
+            if (!ollama_textbuf_append(&s_accumulated, text, msg->response_len)) {
+                ESP_LOGW(TAG, "文本缓冲区不足, 丢弃token");
+            }
+        }
+
+        // 子句完整时立即送去合成, 不再等整句或整个回复
+        emit_chunks(false);
+    }
+
+    if (msg->done && msg->has_context) {
+        update_context(msg);
+    }
+
+    // 检查是否完成
+    if (msg->done && s_response_callback && ollama_textbuf_len(&s_accumulated) > 0) {
+        // 如果还有未处理的文本，处理它
+        ESP_LOGI(TAG, "会话结束，处理剩余文本: %s", ollama_textbuf_data(&s_accumulated));
+        emit_chunks(true);
+    }
+}
 
 // HTTP事件处理函数
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
@@ -20,81 +173,43 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     static char *response_buffer = NULL;
     static int response_len = 0;
 
+    // 抓包(主机构建中按需开启), 只有数据事件带负载
+    traffic_capture_record(TRAFFIC_CAPTURE_OLLAMA, evt->event_id, 0,
+                           evt->event_id == HTTP_EVENT_ON_DATA ? evt->data : NULL, evt->data_len);
+
     switch(evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            // 新建了TCP连接(复用长连接时不会触发)
+            s_request_connected = true;
+            s_stats.connects++;
+            metric_inc(&s_m_connects);
+            break;
+
         case HTTP_EVENT_ON_DATA:
-            // 处理接收到的数据
-            ESP_LOGI(TAG, "Received data: %.*s", evt->data_len, (char*)evt->data);
-            
-            // 解析JSON响应
-            cJSON *root = cJSON_Parse(evt->data);
-            if (root) {
-                // 检查是否有响应文本
-                cJSON *response = cJSON_GetObjectItem(root, "response");
-                if (response && cJSON_IsString(response)) {
-                    // 累积响应文本
-                    const char *text = response->valuestring;
-                    if (text && strlen(text) > 0) {
-                        // 检查是否为问号，如果是则跳过
-                        if (strcmp(text, "？") == 0) {
-                            ESP_LOGI(TAG, "跳过问号");
-                            cJSON_Delete(root);
-                            break;
-                        }
-                        
-                        // 累积文本
-                        if (s_accumulated_text == NULL) {
-                            s_accumulated_text = strdup(text);
-                            if (s_accumulated_text) {
-                                s_accumulated_len = strlen(text);
-                            }
-                        } else {
-                            size_t new_len = s_accumulated_len + strlen(text);
-                            char *new_buffer = realloc(s_accumulated_text, new_len + 1);
-                            if (new_buffer) {
-                                s_accumulated_text = new_buffer;
-                                strcat(s_accumulated_text, text);
-                                s_accumulated_len = new_len;
-                            }
-                        }
-
-                        // 如果收到句号，触发回调
-                        if (strcmp(text, "。") == 0 && s_response_callback && s_accumulated_text) {
-                            ESP_LOGI(TAG, "收到句号，处理累积文本: %s", s_accumulated_text);
-                            s_response_callback(s_accumulated_text);
-                            
-                            // 清理累积的文本
-                            free(s_accumulated_text);
-                            s_accumulated_text = NULL;
-                            s_accumulated_len = 0;
-                        }
-                    }
+            // 被取消时在本任务内关闭连接, perform随即返回
+            if (cancel_token_is_cancelled(s_cancel)) {
+                if (!s_cancelled) {
+                    ESP_LOGI(TAG, "请求已取消, 中断连接");
+                    s_cancelled = true;
+                    esp_http_client_cancel_request(evt->client);
                 }
-                
-                // 检查是否完成
-                cJSON *done = cJSON_GetObjectItem(root, "done");
-                if (done && cJSON_IsTrue(done) && s_response_callback && s_accumulated_text) {
-                    // 如果还有未处理的文本，处理它
-                    ESP_LOGI(TAG, "会话结束，处理剩余文本: %s", s_accumulated_text);
-                    s_response_callback(s_accumulated_text);
-                    
-                    // 清理累积的文本
-                    free(s_accumulated_text);
-                    s_accumulated_text = NULL;
-                    s_accumulated_len = 0;
-                }
-                
-                cJSON_Delete(root);
+                break;
+            }
+            if (s_stats.last_first_byte_us == 0) {
+                s_stats.last_first_byte_us = esp_timer_get_time() - s_request_start_us;
             }
+            // 每个token一次, 只写延迟日志
+            TRACE_LOGD_STR(TAG, "Received data: %.*s", (const char *)evt->data, evt->data_len);
+            
+            // 增量解析, 数据可能包含半行或多行
+            ollama_ndjson_feed(&s_ndjson, (const char *)evt->data, evt->data_len, handle_stream_message, NULL);
             break;
             
         case HTTP_EVENT_ON_FINISH:
             // 请求完成，如果还有未处理的文本则处理
-            if (s_accumulated_text && s_response_callback) {
-                ESP_LOGI(TAG, "请求完成，处理剩余文本: %s", s_accumulated_text);
-                s_response_callback(s_accumulated_text);
-                free(s_accumulated_text);
-                s_accumulated_text = NULL;
-                s_accumulated_len = 0;
+            if (ollama_textbuf_len(&s_accumulated) > 0 && s_response_callback) {
+                ESP_LOGI(TAG, "请求完成，处理剩余文本: %s", ollama_textbuf_data(&s_accumulated));
+                emit_chunks(true);
             }
             if (response_buffer) {
                 free(response_buffer);
@@ -112,12 +227,9 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             }
             
             // 如果连接断开但还有累积的文本，也触发回调
-            if (s_accumulated_text && s_response_callback) {
-                ESP_LOGI(TAG, "连接断开，处理剩余文本: %s", s_accumulated_text);
-                s_response_callback(s_accumulated_text);
-                free(s_accumulated_text);
-                s_accumulated_text = NULL;
-                s_accumulated_len = 0;
+            if (ollama_textbuf_len(&s_accumulated) > 0 && s_response_callback) {
+                ESP_LOGI(TAG, "连接断开，处理剩余文本: %s", ollama_textbuf_data(&s_accumulated));
+                emit_chunks(true);
             }
             break;
             
@@ -132,72 +244,317 @@ void ollama_set_response_callback(ollama_response_callback_t callback)
     s_response_callback = callback;
 }
 
+void ollama_set_chunker_config(const ollama_chunker_config_t *config)
+{
+    if (config) {
+        s_chunker_config = *config;
+    }
+}
+
 esp_err_t ollama_init(const char *ollama_uri)
 {
     if (s_ollama_uri) {
         free(s_ollama_uri);
     }
     
+    metrics_register(&s_m_requests);
+    metrics_register(&s_m_failures);
+    metrics_register(&s_m_connects);
+    metrics_register(&s_m_reused);
+    metrics_register(&s_m_json_errors);
+    metrics_register(&s_m_first_byte_ms);
+
     s_ollama_uri = strdup(ollama_uri);
     if (!s_ollama_uri) {
         return ESP_ERR_NO_MEM;
     }
 
+    // 预分配上下文缓冲区
+    if (!s_context) {
+        s_context = malloc(OLLAMA_CONTEXT_MAX_TOKENS * sizeof(int32_t));
+        if (!s_context) {
+            free(s_ollama_uri);
+            s_ollama_uri = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_context_len = 0;
+
+    // 预分配回复文本缓冲区
+    ollama_textbuf_deinit(&s_accumulated);
+    esp_err_t err = ollama_textbuf_init(&s_accumulated, OLLAMA_TEXTBUF_INITIAL, OLLAMA_TEXTBUF_HIGH_WATER);
+    if (err != ESP_OK) {
+        free(s_ollama_uri);
+        s_ollama_uri = NULL;
+        return err;
+    }
+
     esp_http_client_config_t config = {
         .url = s_ollama_uri,
         .event_handler = http_event_handler,
         .timeout_ms = 10000,
+        .keep_alive_enable = true,      // TCP保活, 长连接空闲时不被中间设备断开
+        .keep_alive_idle = 5,
+        .keep_alive_interval = 5,
+        .keep_alive_count = 3,
     };
     
     s_client = esp_http_client_init(&config);
     if (!s_client) {
         free(s_ollama_uri);
         s_ollama_uri = NULL;
+        ollama_textbuf_deinit(&s_accumulated);
         return ESP_FAIL;
     }
 
     return ESP_OK;
 }
 
-esp_err_t ollama_chat(const char *text)
+// 发送一个POST请求并统计连接复用情况, 请求体由调用方构建
+static esp_err_t ollama_post(const char *post_data)
 {
-    if (!s_client || !text) {
+    // 设置HTTP请求参数
+    esp_http_client_set_url(s_client, s_ollama_uri);
+    esp_http_client_set_method(s_client, HTTP_METHOD_POST);
+    esp_http_client_set_header(s_client, "Content-Type", "application/json");
+    esp_http_client_set_post_field(s_client, post_data, strlen(post_data));
+
+    s_request_connected = false;
+    s_request_start_us = esp_timer_get_time();
+    s_stats.last_first_byte_us = 0;
+    s_stats.requests++;
+    metric_inc(&s_m_requests);
+    traffic_capture_record(TRAFFIC_CAPTURE_OLLAMA, TRAFFIC_CAPTURE_REQUEST, 0, post_data, strlen(post_data));
+
+    // 发送请求; 上次的连接仍然可用时esp_http_client会直接复用
+    esp_err_t err = esp_http_client_perform(s_client);
+
+    s_stats.last_total_us = esp_timer_get_time() - s_request_start_us;
+    // 解析器在每次请求前复位, 错误行数就是本次的
+    metric_add(&s_m_json_errors, s_ndjson.errors);
+    if (s_stats.last_first_byte_us > 0) {
+        metric_observe(&s_m_first_byte_ms, (uint32_t)(s_stats.last_first_byte_us / 1000));
+    }
+
+    if (err == ESP_OK) {
+        // 连接失败(拒绝连接, DNS失败等)同样不会触发ON_CONNECTED, 只有成功的请求才算复用
+        if (!s_request_connected) {
+            s_stats.reused++;
+            metric_inc(&s_m_reused);
+        }
+        int status_code = esp_http_client_get_status_code(s_client);
+        ESP_LOGI(TAG, "HTTP POST Status = %d, 首字节 %lld ms, 总耗时 %lld ms, %s连接",
+                 status_code, (long long)(s_stats.last_first_byte_us / 1000), (long long)(s_stats.last_total_us / 1000),
+                 s_request_connected ? "新建" : "复用");
+    } else {
+        s_stats.failures++;
+        metric_inc(&s_m_failures);
+        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+esp_err_t ollama_warmup(void)
+{
+    if (!s_client) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    // 清理之前可能存在的累积文本
-    if (s_accumulated_text) {
-        free(s_accumulated_text);
-        s_accumulated_text = NULL;
-        s_accumulated_len = 0;
+    ollama_textbuf_reset(&s_accumulated);
+    ollama_ndjson_set_context_buffer(&s_ndjson, NULL, 0);
+    ollama_ndjson_init(&s_ndjson);
+
+    // 不带prompt的请求只加载模型
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "model", s_model);
+    cJSON_AddStringToObject(root, "keep_alive", OLLAMA_KEEP_ALIVE);
+    char *post_data = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    if (!post_data) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "预热模型 %s", s_model);
+    esp_err_t err = ollama_post(post_data);
+    free(post_data);
+    return err;
+}
+
+void ollama_get_stats(ollama_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_stats;
+        stats->context_tokens = s_context_len;
+    }
+}
+
+esp_err_t ollama_set_model(const char *model)
+{
+    if (!model || strlen(model) >= sizeof(s_model)) {
+        return ESP_ERR_INVALID_ARG;
     }
+    // 不同模型的token不通用
+    if (strcmp(model, s_model) != 0) {
+        strcpy(s_model, model);
+        ollama_reset_context();
+    }
+    return ESP_OK;
+}
 
-    // 构建JSON请求体
+void ollama_set_context_config(const ollama_context_config_t *config)
+{
+    if (!config) {
+        return;
+    }
+    s_context_config = *config;
+    if (s_context_config.max_tokens > OLLAMA_CONTEXT_MAX_TOKENS) {
+        s_context_config.max_tokens = OLLAMA_CONTEXT_MAX_TOKENS;
+    }
+    if (s_context_len > s_context_config.max_tokens || !s_context_config.enable) {
+        ollama_reset_context();
+    }
+}
+
+void ollama_reset_context(void)
+{
+    s_context_len = 0;
+}
+
+// 构建请求体. context可能有上千个token, 不放进cJSON树, 直接拼接在末尾
+static char *build_chat_body(const char *text)
+{
     cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "model", "qwen2:0.5b");
+    cJSON_AddStringToObject(root, "model", s_model);
     cJSON_AddStringToObject(root, "prompt", text);
-    char *post_data = cJSON_PrintUnformatted(root);
+    cJSON_AddStringToObject(root, "keep_alive", OLLAMA_KEEP_ALIVE);
+    char *json = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
 
+    if (!json || s_context_len == 0) {
+        return json;
+    }
+
+    // 每个token最多11个字符加一个逗号
+    size_t json_len = strlen(json);
+    char *body = malloc(json_len + s_context_len * 12 + 16);
+    if (!body) {
+        free(json);
+        return NULL;
+    }
+
+    // 去掉结尾的'}', 追加 ,"context":[...]}
+    size_t pos = json_len - 1;
+    memcpy(body, json, pos);
+    free(json);
+    pos += sprintf(body + pos, ",\"context\":[");
+    for (size_t i = 0; i < s_context_len; i++) {
+        pos += sprintf(body + pos, i ? ",%ld" : "%ld", (long)s_context[i]);
+    }
+    strcpy(body + pos, "]}");
+    return body;
+}
+
+// 复位一次对话回复的解析状态
+static void begin_response(const cancel_token_t *cancel)
+{
+    // 清理之前可能存在的累积文本(保留内存)
+    ollama_textbuf_reset(&s_accumulated);
+    s_first_chunk = true;
+    ollama_ndjson_set_context_buffer(&s_ndjson, s_context_config.enable ? s_context : NULL,
+                                     s_context_config.max_tokens);
+    ollama_ndjson_init(&s_ndjson);
+    s_context_updated = false;
+    s_cancel = cancel;
+    s_cancelled = false;
+}
+
+// 一次回复结束(请求返回)后整理上下文
+static void end_response(void)
+{
+    // context边解析边写入s_context, 只要进入过数组旧内容就已被改写;
+    // 没有完整解析(update_context未执行)时缓冲区不可信, 只能清空.
+    // 还没开始写入(例如被取消)则上一轮的上下文仍然有效
+    if (!s_context_updated && s_ndjson.context_written) {
+        ESP_LOGW(TAG, "上下文解析不完整, 清空");
+        ollama_reset_context();
+    }
+    s_last_turn_us = esp_timer_get_time();
+}
+
+void ollama_replay_begin(void)
+{
+    begin_response(NULL);
+    s_request_start_us = esp_timer_get_time();
+    s_stats.last_first_byte_us = 0;
+}
+
+esp_err_t ollama_replay_event(int32_t event_id, const char *data, int len)
+{
+    esp_http_client_event_t evt = {
+        .event_id = (esp_http_client_event_id_t)event_id,
+        .client = s_client,
+        .data = (void *)data,
+        .data_len = len,
+    };
+    return http_event_handler(&evt);
+}
+
+void ollama_replay_end(void)
+{
+    end_response();
+}
+
+esp_err_t ollama_chat(const char *text)
+{
+    return ollama_chat_cancellable(text, NULL);
+}
+
+esp_err_t ollama_chat_cancellable(const char *text, const cancel_token_t *cancel)
+{
+    if (!s_client || !text) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (cancel_token_is_cancelled(cancel)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGD(TAG, "回复文本缓冲区历史峰值 %u 字节, 容量 %u 字节",
+             (unsigned)s_accumulated.peak, (unsigned)s_accumulated.cap);
+
+    // 长时间没有对话时开始新的会话
+    int64_t now = esp_timer_get_time();
+    if (s_context_config.idle_reset_ms > 0 && s_context_len > 0 &&
+        now - s_last_turn_us > (int64_t)s_context_config.idle_reset_ms * 1000) {
+        ESP_LOGI(TAG, "对话空闲超时, 清空上下文");
+        ollama_reset_context();
+    }
+    if (!s_context_config.enable) {
+        ollama_reset_context();
+    }
+
+    // 构建JSON请求体
+    char *post_data = build_chat_body(text);
     if (!post_data) {
         return ESP_ERR_NO_MEM;
     }
+    ESP_LOGI(TAG, "携带上下文 %u 个token", (unsigned)s_context_len);
 
-    // 设置HTTP请求参数
-    esp_http_client_set_url(s_client, s_ollama_uri);
-    esp_http_client_set_method(s_client, HTTP_METHOD_POST);
-    esp_http_client_set_header(s_client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(s_client, post_data, strlen(post_data));
+    // 请求体已经生成, 本轮返回的context可以直接覆盖旧的
+    begin_response(cancel);
 
-    // 发送请求
-    esp_err_t err = esp_http_client_perform(s_client);
+    esp_err_t err = ollama_post(post_data);
     free(post_data);
 
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(s_client);
-        ESP_LOGI(TAG, "HTTP POST Status = %d", status_code);
-    } else {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+    end_response();
+
+    bool cancelled = s_cancelled || cancel_token_is_cancelled(cancel);
+    s_cancel = NULL;
+    s_cancelled = false;
+    if (cancelled) {
+        ollama_textbuf_reset(&s_accumulated);
+        return ESP_ERR_INVALID_STATE;
     }
 
     return err;
@@ -215,10 +572,12 @@ void ollama_cleanup(void)
         s_ollama_uri = NULL;
     }
     
-    if (s_accumulated_text) {
-        free(s_accumulated_text);
-        s_accumulated_text = NULL;
-        s_accumulated_len = 0;
+    ollama_textbuf_deinit(&s_accumulated);
+
+    if (s_context) {
+        free(s_context);
+        s_context = NULL;
+        s_context_len = 0;
     }
     
     s_response_callback = NULL;
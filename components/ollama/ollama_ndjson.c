@@ -0,0 +1,418 @@
+/*
+ * Ollama流式响应的增量NDJSON解析器
+ *
+ * 原先对每个HTTP_EVENT_ON_DATA缓冲区调用cJSON_Parse, 假设一个缓冲区
+ * 恰好是一个以'\0'结尾的完整对象. 行被拆开或多行合并时都会出错,
+ * 而且每个token都要构建一棵完整的cJSON树.
+ * 这里逐字节推进状态机, 跨缓冲区保持状态, 只拷贝需要的字段.
+ */
+
+#include "ollama_ndjson.h"
+
+#include <string.h>
+
+enum {
+    ST_IDLE = 0,        // 等待'{'
+    ST_KEY_OR_END,      // 对象内, 等待字段名或'}'
+    ST_KEY,             // 字段名字符串内
+    ST_KEY_ESC,         // 字段名中的转义
+    ST_COLON,           // 等待':'
+    ST_VALUE,           // 等待值
+    ST_STR,             // 字符串值内
+    ST_STR_ESC,         // 字符串值中的转义
+    ST_STR_HEX,         // \uXXXX
+    ST_LITERAL,         // 数字/true/false/null
+    ST_NESTED,          // 跳过嵌套的对象/数组
+    ST_CONTEXT,         // context整数数组
+    ST_AFTER_VALUE,     // 等待','或'}'
+    ST_ERROR,           // 格式错误, 跳到下一行
+};
+
+enum {
+    FIELD_OTHER = 0,
+    FIELD_RESPONSE,
+    FIELD_DONE,
+    FIELD_CONTEXT,
+};
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void reset_message(ollama_ndjson_t *p)
+{
+    p->msg.response_len = 0;
+    p->msg.response[0] = '\0';
+    p->msg.has_response = false;
+    p->msg.truncated = false;
+    p->msg.done = false;
+    p->msg.has_context = false;
+    p->msg.context_total = 0;
+}
+
+void ollama_ndjson_init(ollama_ndjson_t *parser)
+{
+    int32_t *context_buf = parser->context_buf;
+    size_t context_cap = parser->context_cap;
+
+    // 复位时保留context缓冲区设置
+    memset(parser, 0, sizeof(*parser));
+    parser->state = ST_IDLE;
+    parser->context_buf = context_buf;
+    parser->context_cap = context_cap;
+}
+
+void ollama_ndjson_set_context_buffer(ollama_ndjson_t *parser, int32_t *buf, size_t cap)
+{
+    parser->context_buf = (buf && cap > 0) ? buf : NULL;
+    parser->context_cap = parser->context_buf ? cap : 0;
+}
+
+// 保存一个context元素
+static void put_context(ollama_ndjson_t *p)
+{
+    if (p->number_valid) {
+        p->context_buf[p->msg.context_total % p->context_cap] = p->number_neg ? -p->number : p->number;
+        p->msg.context_total++;
+    }
+    p->number = 0;
+    p->number_neg = false;
+    p->number_valid = false;
+}
+
+// 向response追加字节, 超长时截断
+static void put_byte(ollama_ndjson_t *p, char c)
+{
+    if (p->field != FIELD_RESPONSE) {
+        return;
+    }
+    if (p->msg.response_len < OLLAMA_NDJSON_TEXT_MAX) {
+        p->msg.response[p->msg.response_len++] = c;
+    } else {
+        p->msg.truncated = true;
+    }
+}
+
+// 把Unicode码点编码为UTF-8追加到response
+static void put_codepoint(ollama_ndjson_t *p, uint32_t cp)
+{
+    if (cp < 0x80) {
+        put_byte(p, (char)cp);
+    } else if (cp < 0x800) {
+        put_byte(p, (char)(0xC0 | (cp >> 6)));
+        put_byte(p, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        put_byte(p, (char)(0xE0 | (cp >> 12)));
+        put_byte(p, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        put_byte(p, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        put_byte(p, (char)(0xF0 | (cp >> 18)));
+        put_byte(p, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        put_byte(p, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        put_byte(p, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+// 未配对的高代理项输出为替换字符
+static void flush_surrogate(ollama_ndjson_t *p)
+{
+    if (p->high_surrogate) {
+        put_codepoint(p, 0xFFFD);
+        p->high_surrogate = 0;
+    }
+}
+
+// 截断时去掉末尾不完整的UTF-8字符
+static void trim_partial_utf8(ollama_ndjson_msg_t *msg)
+{
+    size_t len = msg->response_len;
+    size_t i = len;
+    while (i > 0 && ((unsigned char)msg->response[i - 1] & 0xC0) == 0x80) {
+        i--;
+    }
+    if (i > 0) {
+        unsigned char lead = (unsigned char)msg->response[i - 1];
+        size_t need = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : (lead >= 0xC0) ? 2 : 1;
+        if (len - (i - 1) < need) {
+            len = i - 1;
+        }
+    }
+    msg->response_len = len;
+}
+
+static void finish_literal(ollama_ndjson_t *p)
+{
+    p->literal[p->literal_len] = '\0';
+    if (p->field == FIELD_DONE) {
+        p->msg.done = (strcmp(p->literal, "true") == 0);
+    }
+}
+
+static void finish_key(ollama_ndjson_t *p)
+{
+    p->key[p->key_len] = '\0';
+    if (strcmp(p->key, "response") == 0) {
+        p->field = FIELD_RESPONSE;
+    } else if (strcmp(p->key, "done") == 0) {
+        p->field = FIELD_DONE;
+    } else if (strcmp(p->key, "context") == 0) {
+        p->field = FIELD_CONTEXT;
+    } else {
+        p->field = FIELD_OTHER;
+    }
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+size_t ollama_ndjson_feed(ollama_ndjson_t *p, const char *data, size_t len,
+                          ollama_ndjson_callback_t callback, void *ctx)
+{
+    size_t objects = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+
+        switch (p->state) {
+            case ST_IDLE:
+                if (c == '{') {
+                    reset_message(p);
+                    p->state = ST_KEY_OR_END;
+                } else if (!is_space(c)) {
+                    p->state = ST_ERROR;
+                }
+                break;
+
+            case ST_KEY_OR_END:
+                if (c == '"') {
+                    p->key_len = 0;
+                    p->state = ST_KEY;
+                } else if (c == '}') {
+                    goto object_done;
+                } else if (!is_space(c)) {
+                    p->state = ST_ERROR;
+                }
+                break;
+
+            case ST_KEY:
+                if (c == '"') {
+                    finish_key(p);
+                    p->state = ST_COLON;
+                } else if (c == '\\') {
+                    p->state = ST_KEY_ESC;
+                } else if (p->key_len < OLLAMA_NDJSON_KEY_MAX) {
+                    p->key[p->key_len++] = c;
+                } else {
+                    // 超长字段名不可能是我们关心的字段, 破坏它使其不匹配
+                    p->key[0] = '\0';
+                }
+                break;
+
+            case ST_KEY_ESC:
+                // 字段名中的转义只需要保证不被'"'提前结束
+                p->key[0] = '\0';
+                p->state = ST_KEY;
+                break;
+
+            case ST_COLON:
+                if (c == ':') {
+                    p->state = ST_VALUE;
+                } else if (!is_space(c)) {
+                    p->state = ST_ERROR;
+                }
+                break;
+
+            case ST_VALUE:
+                if (is_space(c)) {
+                    break;
+                }
+                if (c == '"') {
+                    if (p->field == FIELD_RESPONSE) {
+                        p->msg.has_response = true;
+                        p->msg.response_len = 0;
+                    }
+                    p->high_surrogate = 0;
+                    p->state = ST_STR;
+                } else if (c == '[' && p->field == FIELD_CONTEXT && p->context_buf) {
+                    p->msg.has_context = true;
+                    p->context_written = true;
+                    p->msg.context_total = 0;
+                    p->number = 0;
+                    p->number_neg = false;
+                    p->number_valid = false;
+                    p->state = ST_CONTEXT;
+                } else if (c == '{' || c == '[') {
+                    p->nest_depth = 1;
+                    p->nest_in_string = false;
+                    p->nest_escape = false;
+                    p->state = ST_NESTED;
+                } else if (c == ',' || c == '}' || c == ']' || c == ':') {
+                    p->state = ST_ERROR;
+                } else {
+                    p->literal[0] = c;
+                    p->literal_len = 1;
+                    p->state = ST_LITERAL;
+                }
+                break;
+
+            case ST_STR:
+                if (c == '"') {
+                    flush_surrogate(p);
+                    p->state = ST_AFTER_VALUE;
+                } else if (c == '\\') {
+                    p->state = ST_STR_ESC;
+                } else if (c == '\n') {
+                    // 字符串中不可能出现裸换行, 说明本行不完整
+                    p->errors++;
+                    p->state = ST_IDLE;
+                } else {
+                    flush_surrogate(p);
+                    put_byte(p, c);
+                }
+                break;
+
+            case ST_STR_ESC:
+                p->state = ST_STR;
+                if (c == 'u') {
+                    p->hex_count = 0;
+                    p->hex_value = 0;
+                    p->state = ST_STR_HEX;
+                    break;
+                }
+                flush_surrogate(p);
+                switch (c) {
+                    case 'n': put_byte(p, '\n'); break;
+                    case 't': put_byte(p, '\t'); break;
+                    case 'r': put_byte(p, '\r'); break;
+                    case 'b': put_byte(p, '\b'); break;
+                    case 'f': put_byte(p, '\f'); break;
+                    default:  put_byte(p, c);    break;   // \" \\ \/
+                }
+                break;
+
+            case ST_STR_HEX: {
+                int d = hex_digit(c);
+                if (d < 0) {
+                    p->state = ST_ERROR;
+                    break;
+                }
+                p->hex_value = (uint16_t)((p->hex_value << 4) | d);
+                if (++p->hex_count < 4) {
+                    break;
+                }
+                uint16_t u = p->hex_value;
+                if (u >= 0xD800 && u < 0xDC00) {
+                    flush_surrogate(p);
+                    p->high_surrogate = u;
+                } else if (u >= 0xDC00 && u < 0xE000) {
+                    if (p->high_surrogate) {
+                        put_codepoint(p, 0x10000 + (((uint32_t)p->high_surrogate - 0xD800) << 10) + (u - 0xDC00));
+                        p->high_surrogate = 0;
+                    } else {
+                        put_codepoint(p, 0xFFFD);
+                    }
+                } else {
+                    flush_surrogate(p);
+                    put_codepoint(p, u);
+                }
+                p->state = ST_STR;
+                break;
+            }
+
+            case ST_LITERAL:
+                if (c == ',' || c == '}' || is_space(c)) {
+                    finish_literal(p);
+                    p->state = ST_AFTER_VALUE;
+                    if (c == ',') {
+                        p->state = ST_KEY_OR_END;
+                    } else if (c == '}') {
+                        goto object_done;
+                    }
+                } else if (p->literal_len < sizeof(p->literal) - 1) {
+                    p->literal[p->literal_len++] = c;
+                }
+                break;
+
+            case ST_NESTED:
+                if (p->nest_in_string) {
+                    if (p->nest_escape) {
+                        p->nest_escape = false;
+                    } else if (c == '\\') {
+                        p->nest_escape = true;
+                    } else if (c == '"') {
+                        p->nest_in_string = false;
+                    }
+                } else if (c == '"') {
+                    p->nest_in_string = true;
+                } else if (c == '{' || c == '[') {
+                    p->nest_depth++;
+                } else if (c == '}' || c == ']') {
+                    if (--p->nest_depth == 0) {
+                        p->state = ST_AFTER_VALUE;
+                    }
+                }
+                break;
+
+            case ST_CONTEXT:
+                if (c >= '0' && c <= '9') {
+                    p->number = p->number * 10 + (c - '0');
+                    p->number_valid = true;
+                } else if (c == '-' && !p->number_valid) {
+                    p->number_neg = true;
+                } else if (c == ',') {
+                    put_context(p);
+                } else if (c == ']') {
+                    put_context(p);
+                    p->state = ST_AFTER_VALUE;
+                } else if (!is_space(c)) {
+                    p->msg.has_context = false;
+                    p->state = ST_ERROR;
+                }
+                break;
+
+            case ST_AFTER_VALUE:
+                if (c == ',') {
+                    p->state = ST_KEY_OR_END;
+                } else if (c == '}') {
+                    goto object_done;
+                } else if (!is_space(c)) {
+                    p->state = ST_ERROR;
+                }
+                break;
+
+            case ST_ERROR:
+                // 丢弃本行剩余内容, 从下一行重新同步
+                if (c == '\n') {
+                    p->errors++;
+                    p->state = ST_IDLE;
+                }
+                break;
+        }
+        continue;
+
+    object_done:
+        if (p->msg.truncated) {
+            trim_partial_utf8(&p->msg);
+        }
+        p->msg.response[p->msg.response_len] = '\0';
+        if (callback) {
+            callback(&p->msg, ctx);
+        }
+        objects++;
+        p->state = ST_IDLE;
+    }
+
+    return objects;
+}
@@ -0,0 +1,103 @@
+/*
+ * 大模型回复文本缓冲区
+ *
+ * 原先每个token都realloc一次再strcat, strcat每次从头找结尾,
+ * 总开销随回复长度平方增长, 长对话还会把堆切得很碎.
+ */
+
+#include "ollama_textbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+esp_err_t ollama_textbuf_init(ollama_textbuf_t *tb, size_t initial, size_t high_water)
+{
+    if (!tb || initial == 0 || high_water < initial) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tb->buf = malloc(initial);
+    if (!tb->buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    tb->buf[0] = '\0';
+    tb->cap = initial;
+    tb->start = 0;
+    tb->len = 0;
+    tb->high_water = high_water;
+    tb->peak = 0;
+    return ESP_OK;
+}
+
+void ollama_textbuf_deinit(ollama_textbuf_t *tb)
+{
+    if (tb && tb->buf) {
+        free(tb->buf);
+        tb->buf = NULL;
+        tb->cap = 0;
+        tb->start = 0;
+        tb->len = 0;
+    }
+}
+
+bool ollama_textbuf_append(ollama_textbuf_t *tb, const char *text, size_t len)
+{
+    if (!tb->buf) {
+        return false;
+    }
+
+    size_t need = tb->len + len + 1;
+    if (need > tb->high_water) {
+        return false;
+    }
+
+    if (tb->start + need > tb->cap) {
+        // 先把未消费部分移到开头
+        if (tb->start > 0) {
+            memmove(tb->buf, tb->buf + tb->start, tb->len + 1);
+            tb->start = 0;
+        }
+        // 仍然不够则按倍数扩容, 不超过上限
+        if (need > tb->cap) {
+            size_t cap = tb->cap;
+            while (cap < need) {
+                cap *= 2;
+            }
+            if (cap > tb->high_water) {
+                cap = tb->high_water;
+            }
+            char *buf = realloc(tb->buf, cap);
+            if (!buf) {
+                return false;
+            }
+            tb->buf = buf;
+            tb->cap = cap;
+        }
+    }
+
+    memcpy(tb->buf + tb->start + tb->len, text, len);
+    tb->len += len;
+    tb->buf[tb->start + tb->len] = '\0';
+    if (tb->len > tb->peak) {
+        tb->peak = tb->len;
+    }
+    return true;
+}
+
+void ollama_textbuf_consume(ollama_textbuf_t *tb, size_t n)
+{
+    if (n >= tb->len) {
+        ollama_textbuf_reset(tb);
+        return;
+    }
+    tb->start += n;
+    tb->len -= n;
+}
+
+void ollama_textbuf_reset(ollama_textbuf_t *tb)
+{
+    tb->start = 0;
+    tb->len = 0;
+    if (tb->buf) {
+        tb->buf[0] = '\0';
+    }
+}
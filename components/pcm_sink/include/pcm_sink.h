@@ -0,0 +1,104 @@
+#ifndef PCM_SINK_H
+#define PCM_SINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "cancel_token.h"
+
+/* 每个PCM块的样本数 */
+#define PCM_SINK_BLOCK_SAMPLES  1024
+
+/* 播放队列深度 */
+#define PCM_SINK_DEPTH          8
+
+/* 块池大小: 播放队列深度 + 合成任务和播放任务手上各一块 */
+#define PCM_SINK_POOL_BLOCKS    (PCM_SINK_DEPTH + 2)
+
+/* 写入时没有空块, 每隔多久检查一次是否被打断(毫秒) */
+#define PCM_SINK_ACQUIRE_POLL_MS    20
+
+/**
+ * @brief 一块待播放的PCM, 存放在静态分配的块池中
+ */
+typedef struct {
+    uint32_t epoch;
+    uint16_t samples;
+    int16_t data[PCM_SINK_BLOCK_SAMPLES];
+} pcm_block_t;
+
+/**
+ * @brief 统计信息
+ */
+typedef struct {
+    uint32_t submitted;     // 提交播放的块数
+    uint32_t waits;         // 取空块时需要等待(播放跟不上合成)的次数
+    uint32_t flushed;       // 被打断丢弃的块数
+} pcm_sink_stats_t;
+
+/**
+ * @brief 初始化块池和队列(只在启动时创建两个指针队列)
+ */
+esp_err_t pcm_sink_init(void);
+
+/**
+ * @brief 生产者取一个空块, 直接把合成结果写入其中
+ *
+ * @param wait 最长等待时间, 所有块都在排队播放时形成背压
+ * @return 空块, 超时返回NULL
+ */
+pcm_block_t *pcm_sink_acquire(TickType_t wait);
+
+/**
+ * @brief 生产者提交写好的块
+ */
+void pcm_sink_submit(pcm_block_t *block);
+
+/**
+ * @brief 生产者写入一段PCM: 拷贝进当前块, 写满的块提交播放, 没有空块时等待
+ *
+ * 不足一块的尾部留在当前块, 与下一次写入拼在一起, 由pcm_sink_write_end提交.
+ * 块的epoch取自令牌. 只能在一个任务中调用.
+ *
+ * @param token 等待和拷贝期间被取消时丢弃当前块并返回
+ * @return 本次提交的块数, 被取消返回-1
+ */
+int pcm_sink_write(const int16_t *pcm, size_t len, const cancel_token_t *token);
+
+/**
+ * @brief 提交当前块中不足一块的尾部, 令牌已被取消时丢弃
+ *
+ * @return 是否提交了块
+ */
+bool pcm_sink_write_end(void);
+
+/**
+ * @brief 消费者取下一块待播放的PCM
+ *
+ * @return 超时返回NULL
+ */
+pcm_block_t *pcm_sink_receive(TickType_t wait);
+
+/**
+ * @brief 消费者播放完后归还块
+ */
+void pcm_sink_release(pcm_block_t *block);
+
+/**
+ * @brief 排队中的块数
+ */
+uint32_t pcm_sink_pending(void);
+
+/**
+ * @brief 丢弃所有排队中的块(打断时调用)
+ */
+void pcm_sink_flush(void);
+
+/**
+ * @brief 获取统计信息
+ */
+void pcm_sink_get_stats(pcm_sink_stats_t *stats);
+
+#endif /* PCM_SINK_H */
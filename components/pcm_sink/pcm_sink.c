@@ -0,0 +1,164 @@
+/*
+ * 播放块池
+ *
+ * 合成任务把PCM写入静态分配的块, 队列中只传递指针:
+ *   free队列 -> 合成任务写入 -> ready队列 -> 播放任务写入喇叭 -> free队列
+ * 运行期间没有堆分配.
+ *
+ * 每个样本仍拷贝两次, 与最初的实现相同: esp_tts的输出缓冲区每段都会被下一段覆盖,
+ * 要先拷贝进块才能和播放解耦; i2s_write再把块拷贝进驱动自己的DMA缓冲区.
+ * 块本身不经DMA读取, 所以放在普通内存中, 不占用内部DMA内存.
+ * 相比按值传块的播放队列, 省掉的是块进出FreeRTOS队列的两次拷贝.
+ */
+
+#include "pcm_sink.h"
+
+#include <string.h>
+#include "freertos/queue.h"
+#include "metrics.h"
+
+static pcm_block_t s_pool[PCM_SINK_POOL_BLOCKS];
+
+static QueueHandle_t s_free = NULL;
+static QueueHandle_t s_ready = NULL;
+static pcm_sink_stats_t s_stats;
+
+// pcm_sink_write正在填写的块和它的令牌, 不足一块的尾部和下一次写入拼在一起
+static pcm_block_t *s_open = NULL;
+static cancel_token_t s_open_token;
+
+// 取空块需要等待的次数(播放跟不上合成)
+METRIC_COUNTER_DEFINE(s_m_waits, "pcm.acquire_waits");
+
+esp_err_t pcm_sink_init(void)
+{
+    metrics_register(&s_m_waits);
+    s_free = xQueueCreate(PCM_SINK_POOL_BLOCKS, sizeof(pcm_block_t *));
+    s_ready = xQueueCreate(PCM_SINK_POOL_BLOCKS, sizeof(pcm_block_t *));
+    if (!s_free || !s_ready) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < PCM_SINK_POOL_BLOCKS; i++) {
+        pcm_block_t *block = &s_pool[i];
+        xQueueSend(s_free, &block, 0);
+    }
+    return ESP_OK;
+}
+
+pcm_block_t *pcm_sink_acquire(TickType_t wait)
+{
+    pcm_block_t *block = NULL;
+
+    if (xQueueReceive(s_free, &block, 0) == pdTRUE) {
+        return block;
+    }
+    s_stats.waits++;
+    metric_inc(&s_m_waits);
+    if (xQueueReceive(s_free, &block, wait) == pdTRUE) {
+        return block;
+    }
+    return NULL;
+}
+
+void pcm_sink_submit(pcm_block_t *block)
+{
+    s_stats.submitted++;
+    xQueueSend(s_ready, &block, portMAX_DELAY);
+}
+
+int pcm_sink_write(const int16_t *pcm, size_t len, const cancel_token_t *token)
+{
+    size_t off = 0;
+    int submitted = 0;
+
+    while (off < len) {
+        if (cancel_token_is_cancelled(token)) {
+            pcm_sink_release(s_open);
+            s_open = NULL;
+            return -1;
+        }
+        if (!s_open) {
+            // 等待期间也定期检查是否被打断
+            s_open = pcm_sink_acquire(pdMS_TO_TICKS(PCM_SINK_ACQUIRE_POLL_MS));
+            if (!s_open) {
+                continue;
+            }
+            s_open_token = *token;
+            s_open->epoch = token->epoch;
+            s_open->samples = 0;
+        }
+
+        size_t n = len - off;
+        size_t room = PCM_SINK_BLOCK_SAMPLES - s_open->samples;
+        if (n > room) {
+            n = room;
+        }
+        memcpy(s_open->data + s_open->samples, pcm + off, n * sizeof(int16_t));
+        s_open->samples += n;
+        off += n;
+
+        if (s_open->samples == PCM_SINK_BLOCK_SAMPLES) {
+            pcm_sink_submit(s_open);
+            s_open = NULL;
+            submitted++;
+        }
+    }
+    return submitted;
+}
+
+bool pcm_sink_write_end(void)
+{
+    bool submitted = false;
+
+    if (!s_open) {
+        return false;
+    }
+    if (s_open->samples > 0 && !cancel_token_is_cancelled(&s_open_token)) {
+        pcm_sink_submit(s_open);
+        submitted = true;
+    } else {
+        pcm_sink_release(s_open);
+    }
+    s_open = NULL;
+    return submitted;
+}
+
+pcm_block_t *pcm_sink_receive(TickType_t wait)
+{
+    pcm_block_t *block = NULL;
+
+    if (xQueueReceive(s_ready, &block, wait) == pdTRUE) {
+        return block;
+    }
+    return NULL;
+}
+
+void pcm_sink_release(pcm_block_t *block)
+{
+    if (block) {
+        xQueueSend(s_free, &block, portMAX_DELAY);
+    }
+}
+
+uint32_t pcm_sink_pending(void)
+{
+    return uxQueueMessagesWaiting(s_ready);
+}
+
+void pcm_sink_flush(void)
+{
+    pcm_block_t *block = NULL;
+
+    // 块必须归还到free队列, 不能直接xQueueReset
+    while (xQueueReceive(s_ready, &block, 0) == pdTRUE) {
+        xQueueSend(s_free, &block, 0);
+        s_stats.flushed++;
+    }
+}
+
+void pcm_sink_get_stats(pcm_sink_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_stats;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* 抽取比例: 48kHz -> 16kHz */
+#define RESAMPLER_DECIMATION    3
+
+/* FIR抽头数(72 = 每相24个抽头, 是8的倍数便于esp-dsp内核处理) */
+#define RESAMPLER_TAPS          72
+
+/* 每次内部处理的输入样本数, 决定状态结构体中工作缓冲区的大小 */
+#define RESAMPLER_BLOCK         480
+
+/* 是否使用esp-dsp定点点积内核, 设为0时按内核算法用C模拟 */
+#ifndef RESAMPLER_USE_ESP_DSP
+#ifdef ESP_PLATFORM
+#define RESAMPLER_USE_ESP_DSP   1
+#else
+#define RESAMPLER_USE_ESP_DSP   0
+#endif
+#endif
+
+/**
+ * @brief 多相FIR抽取器状态
+ *
+ * 滤波器历史保存在结构体内部, 因此连续多次i2s_read得到的数据块
+ * 可以无缝衔接, 不会在块边界产生不连续.
+ */
+typedef struct {
+    int16_t buf[RESAMPLER_TAPS - 1 + RESAMPLER_DECIMATION + RESAMPLER_BLOCK];  // 历史 + 新输入(半幅)
+    size_t fill;                                                                // buf中有效样本数
+} resampler_t;
+
+/**
+ * @brief 初始化(或复位)抽取器状态
+ *
+ * @param rs 抽取器状态
+ * @return esp_err_t
+ */
+esp_err_t resampler_init(resampler_t *rs);
+
+/**
+ * @brief 对一块48kHz输入进行抗混叠滤波并抽取到16kHz
+ *
+ * 输出样本数不一定等于 in_len / 3, 余下的相位会保留到下一次调用.
+ * 输出缓冲区至少需要 in_len / 3 + 1 个样本的空间.
+ *
+ * @param rs 抽取器状态
+ * @param in 输入样本
+ * @param in_len 输入样本数
+ * @param out 输出样本
+ * @return size_t 实际写入的输出样本数
+ */
+size_t resampler_process(resampler_t *rs, const int16_t *in, size_t in_len, int16_t *out);
+
+/**
+ * @brief 标量参考实现, 用于对比验证
+ *
+ * 累加和舍入与resampler_process相同, 但不经过esp-dsp内核(不截断到int16),
+ * 两者对任意输入(包括削顶的满幅输入)的输出都应逐点相同.
+ */
+size_t resampler_process_ref(resampler_t *rs, const int16_t *in, size_t in_len, int16_t *out);
+
+#endif /* RESAMPLER_H */
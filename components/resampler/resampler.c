@@ -0,0 +1,131 @@
+/*
+ * 48kHz -> 16kHz 抗混叠多相FIR抽取器
+ *
+ * 原先的resample_data()直接每3个点取1个, 没有低通滤波,
+ * 8kHz以上的噪声会全部混叠进FunASR使用的频带.
+ * 这里使用72阶Kaiser窗(beta=6.5, fc=7kHz)线性相位低通, 只计算
+ * 抽取后需要保留的输出点(等价于多相结构), 每个输入点24次乘加.
+ *
+ * 频响(Q15量化后): 0~6kHz 波动 < 0.25dB, 8kHz处 -31dB, 10kHz以上 < -70dB
+ *
+ * 系数绝对值和约为1.75, 削顶的麦克风输入经过滤波后会超出int16(过冲).
+ * esp-dsp点积内核只截断不饱和, 超出部分会回绕成满幅的反相咔嗒声,
+ * 因此输入先右移一位存入历史缓冲区, 点积结果最大约为28672, 不会回绕,
+ * 再乘2并饱和. 代价是输出最低位恒为0.
+ */
+
+#include "resampler.h"
+
+#include <string.h>
+
+#if RESAMPLER_USE_ESP_DSP
+#include "dsps_dotprod.h"
+#endif
+
+/* Q15低通系数, 和为32768(直流增益为1), 对称故无需翻转 */
+static const int16_t s_coeffs[RESAMPLER_TAPS] __attribute__((aligned(16))) = {
+        2,     1,    -5,   -11,    -8,     7,    26,    29,
+        3,   -42,   -67,   -37,    45,   119,   109,   -11,
+     -168,  -224,   -89,   178,   370,   282,   -96,  -511,
+     -590,  -148,   582,  1029,   675,  -466, -1671, -1837,
+     -189,  3091,  6784,  9222,  9222,  6784,  3091,  -189,
+    -1837, -1671,  -466,   675,  1029,   582,  -148,  -590,
+     -511,   -96,   282,   370,   178,   -89,  -224,  -168,
+      -11,   109,   119,    45,   -37,   -67,   -42,     3,
+       29,    26,     7,    -8,   -11,    -5,     1,     2,
+};
+
+#define RESAMPLER_BUF_LEN   (sizeof(((resampler_t *)0)->buf) / sizeof(int16_t))
+
+// 半幅点积结果乘2还原幅度, 饱和到int16
+static inline int16_t restore_scale(int32_t half)
+{
+    half *= 2;
+    if (half > INT16_MAX) {
+        half = INT16_MAX;
+    } else if (half < INT16_MIN) {
+        half = INT16_MIN;
+    }
+    return (int16_t)half;
+}
+
+// 标量点积(舍入方式与esp-dsp一致, 累加结果不截断)
+static inline int16_t dot_ref(const int16_t *x)
+{
+    int32_t acc = 0x7fff;  // 与dsps_dotprod_s16相同的舍入常数
+    for (int i = 0; i < RESAMPLER_TAPS; i++) {
+        acc += (int32_t)x[i] * s_coeffs[i];
+    }
+    return restore_scale(acc >> 15);
+}
+
+// 定点点积内核. 主机构建按dsps_dotprod_s16_ansi的算法逐位模拟, 包括截断到int16时的回绕,
+// 这样主机测试也能发现缺少余量的问题
+static inline int16_t dot_dsp(const int16_t *x)
+{
+    int16_t y;
+#if RESAMPLER_USE_ESP_DSP
+    dsps_dotprod_s16(x, s_coeffs, &y, RESAMPLER_TAPS, 0);
+#else
+    int32_t acc = 0x7fff;  // 满幅输入时绝对值也不超过2^31
+    for (int i = 0; i < RESAMPLER_TAPS; i++) {
+        acc += (int32_t)x[i] * s_coeffs[i];
+    }
+    y = (int16_t)(uint16_t)(acc >> 15);
+#endif
+    return restore_scale(y);
+}
+
+esp_err_t resampler_init(resampler_t *rs)
+{
+    if (!rs) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // 预置TAPS-1个零作为初始历史, 第一个输入点即可产生输出
+    memset(rs->buf, 0, sizeof(rs->buf));
+    rs->fill = RESAMPLER_TAPS - 1;
+    return ESP_OK;
+}
+
+static size_t resampler_run(resampler_t *rs, const int16_t *in, size_t in_len, int16_t *out, int use_dsp)
+{
+    size_t produced = 0;
+
+    while (in_len > 0) {
+        // 把新输入右移一位追加到历史之后, 给点积留出余量
+        size_t n = RESAMPLER_BUF_LEN - rs->fill;
+        if (n > in_len) {
+            n = in_len;
+        }
+        for (size_t i = 0; i < n; i++) {
+            rs->buf[rs->fill + i] = (int16_t)(in[i] >> 1);
+        }
+        rs->fill += n;
+        in += n;
+        in_len -= n;
+
+        // 只计算抽取后保留的输出点
+        size_t pos = 0;
+        while (pos + RESAMPLER_TAPS <= rs->fill) {
+            out[produced] = use_dsp ? dot_dsp(rs->buf + pos) : dot_ref(rs->buf + pos);
+            produced++;
+            pos += RESAMPLER_DECIMATION;
+        }
+
+        // 保留未消费的样本(滤波历史和剩余相位)到缓冲区开头
+        rs->fill -= pos;
+        memmove(rs->buf, rs->buf + pos, rs->fill * sizeof(int16_t));
+    }
+
+    return produced;
+}
+
+size_t resampler_process(resampler_t *rs, const int16_t *in, size_t in_len, int16_t *out)
+{
+    return resampler_run(rs, in, in_len, out, 1);
+}
+
+size_t resampler_process_ref(resampler_t *rs, const int16_t *in, size_t in_len, int16_t *out)
+{
+    return resampler_run(rs, in, in_len, out, 0);
+}
@@ -0,0 +1,104 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+/*
+ * 延迟日志
+ *
+ * 热路径(每帧, 每个token)上不做格式化和串口输出, 只把时间戳, 格式串指针,
+ * 原始参数和最多一段字符串拷贝进环形缓冲区, 由低优先级任务稍后格式化输出.
+ * 缓冲区满时覆盖最旧的记录, 丢弃条数计入指标trace_log.dropped.
+ *
+ * 参数限制: 整数参数最多TRACE_LOG_MAX_ARGS个, 按32位保存(64位值需自行截断);
+ * 格式串中的%s(或%.*s)对应TRACE_LOGx_STR传入的字符串, 最多一个.
+ * 格式串和tag必须是常量(只保存指针).
+ */
+
+/* 环形缓冲区记录数, 必须是2的幂 */
+#define TRACE_LOG_DEPTH         64
+
+/* 每条记录的整数参数个数上限 */
+#define TRACE_LOG_MAX_ARGS      4
+
+/* 每条记录拷贝的字符串字节数上限, 超出部分在UTF-8字符边界截断, 输出时加"..." */
+#define TRACE_LOG_STR_MAX       64
+
+/* 输出任务的轮询间隔(ms) */
+#define TRACE_LOG_FLUSH_MS      50
+
+/* 编译期日志级别, 高于此级别的调用整条编译掉, 默认与ESP_LOG一致 */
+#ifndef TRACE_LOG_LEVEL
+#define TRACE_LOG_LEVEL         LOG_LOCAL_LEVEL
+#endif
+
+/**
+ * @brief 一条记录
+ *
+ * seq为0表示空槽或正在写入, 否则为写入序号加1, 读方据此检测被覆盖的记录.
+ */
+typedef struct {
+    _Atomic uint32_t seq;
+    uint8_t level;
+    uint8_t nargs;
+    uint8_t str_len;
+    uint8_t str_cut;    // 字符串被截断
+    int64_t time_us;
+    const char *tag;
+    const char *fmt;
+    uint32_t args[TRACE_LOG_MAX_ARGS];
+    char str[TRACE_LOG_STR_MAX];
+} trace_log_record_t;
+
+/**
+ * @brief 创建输出任务, 在此之前写入的记录在任务启动后输出
+ *
+ * @param priority 输出任务优先级, 应低于音频相关任务
+ */
+esp_err_t trace_log_init(UBaseType_t priority);
+
+/**
+ * @brief 写入一条记录, 一般通过下面的宏调用
+ *
+ * 可在任意任务中调用, 不加锁, 不分配内存.
+ *
+ * @param str 字符串参数, 没有时为NULL
+ * @param str_len 字符串长度, 超过TRACE_LOG_STR_MAX时在字符边界截断
+ */
+void trace_log_write(esp_log_level_t level, const char *tag, const char *fmt,
+                     const uint32_t *args, size_t nargs, const char *str, size_t str_len);
+
+/**
+ * @brief 立即格式化输出缓冲区中的全部记录(例如退出前)
+ */
+void trace_log_flush(void);
+
+/* 把可变参数收集成uint32_t数组, 第一个元素占位以允许没有参数 */
+#define TRACE_LOG_ARGS_(...)    ((const uint32_t[]){0, ##__VA_ARGS__})
+#define TRACE_LOG_NARGS_(...)   (sizeof(TRACE_LOG_ARGS_(__VA_ARGS__)) / sizeof(uint32_t) - 1)
+
+#define TRACE_LOG_AT_(level, tag, fmt, str, len, ...) do {                          \
+        _Static_assert(TRACE_LOG_NARGS_(__VA_ARGS__) <= TRACE_LOG_MAX_ARGS,          \
+                       "too many trace_log args");                                   \
+        if ((level) <= TRACE_LOG_LEVEL) {                                            \
+            trace_log_write((level), (tag), (fmt), TRACE_LOG_ARGS_(__VA_ARGS__) + 1, \
+                            TRACE_LOG_NARGS_(__VA_ARGS__), (str), (len));            \
+        }                                                                            \
+    } while (0)
+
+#define TRACE_LOGW(tag, fmt, ...)   TRACE_LOG_AT_(ESP_LOG_WARN, tag, fmt, NULL, 0, ##__VA_ARGS__)
+#define TRACE_LOGI(tag, fmt, ...)   TRACE_LOG_AT_(ESP_LOG_INFO, tag, fmt, NULL, 0, ##__VA_ARGS__)
+#define TRACE_LOGD(tag, fmt, ...)   TRACE_LOG_AT_(ESP_LOG_DEBUG, tag, fmt, NULL, 0, ##__VA_ARGS__)
+
+/* 带一段字符串的版本, len为字符串字节数 */
+#define TRACE_LOGI_STR(tag, fmt, str, len, ...) \
+    TRACE_LOG_AT_(ESP_LOG_INFO, tag, fmt, str, len, ##__VA_ARGS__)
+#define TRACE_LOGD_STR(tag, fmt, str, len, ...) \
+    TRACE_LOG_AT_(ESP_LOG_DEBUG, tag, fmt, str, len, ##__VA_ARGS__)
+
+#endif /* TRACE_LOG_H */
@@ -0,0 +1,216 @@
+/*
+ * 延迟日志
+ *
+ * 写入方先原子地取一个序号, 把槽位的seq清零后写内容, 最后发布seq=序号+1;
+ * 输出方按序号顺序读, 读前读后各检查一次seq, 被覆盖或正在改写的记录丢弃.
+ * 写入只有一次原子加和几次内存拷贝, 格式化全部在输出任务中进行.
+ */
+
+#include "trace_log.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+_Static_assert((TRACE_LOG_DEPTH & (TRACE_LOG_DEPTH - 1)) == 0, "TRACE_LOG_DEPTH must be a power of 2");
+
+/* 格式化后单行的最大长度 */
+#define TRACE_LOG_LINE_MAX      256
+
+static trace_log_record_t s_ring[TRACE_LOG_DEPTH];
+static _Atomic uint32_t s_head;             // 下一个写入序号
+static uint32_t s_tail;                     // 下一个输出序号, 持有s_flush_lock时使用
+static SemaphoreHandle_t s_flush_lock;
+static TaskHandle_t s_task;
+
+METRIC_COUNTER_DEFINE(s_m_dropped, "trace_log.dropped");
+
+void trace_log_write(esp_log_level_t level, const char *tag, const char *fmt,
+                     const uint32_t *args, size_t nargs, const char *str, size_t str_len)
+{
+    uint32_t n = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    trace_log_record_t *rec = &s_ring[n & (TRACE_LOG_DEPTH - 1)];
+
+    // 先作废旧内容再改写
+    atomic_store_explicit(&rec->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (nargs > TRACE_LOG_MAX_ARGS) {
+        nargs = TRACE_LOG_MAX_ARGS;
+    }
+    bool cut = false;
+    if (!str) {
+        str_len = 0;
+    } else if (str_len > TRACE_LOG_STR_MAX) {
+        // 退到字符边界, 不把一个汉字的3个字节拆开
+        str_len = TRACE_LOG_STR_MAX;
+        while (str_len > 0 && ((uint8_t)str[str_len] & 0xC0) == 0x80) {
+            str_len--;
+        }
+        cut = true;
+    }
+    rec->level = (uint8_t)level;
+    rec->nargs = (uint8_t)nargs;
+    rec->str_len = (uint8_t)str_len;
+    rec->str_cut = cut;
+    rec->time_us = esp_timer_get_time();
+    rec->tag = tag;
+    rec->fmt = fmt;
+    memcpy(rec->args, args, nargs * sizeof(uint32_t));
+    memcpy(rec->str, str, str_len);
+
+    // 序号回绕到0时记为1, 输出方当作被覆盖丢弃, 不会卡住
+    uint32_t seq = n + 1;
+    atomic_store_explicit(&rec->seq, seq ? seq : 1, memory_order_release);
+}
+
+// 按格式串展开一条记录; 参数统一按32位保存, 长度修饰符和*宽度被忽略
+static void format_record(const trace_log_record_t *rec, char *out, size_t len)
+{
+    const char *f = rec->fmt;
+    size_t pos = 0;
+    uint8_t arg = 0;
+
+    while (*f && pos + 1 < len) {
+        if (*f != '%') {
+            out[pos++] = *f++;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[pos++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // 复制标志/宽度/精度, 留出长度修饰符, 转换字符和结尾的位置
+        char spec[16];
+        size_t s = 0;
+        spec[s++] = *f++;
+        while (*f && strchr("-+ #0123456789.*", *f)) {
+            if (*f != '*' && s < sizeof(spec) - 3) {
+                spec[s++] = *f;
+            }
+            f++;
+        }
+        while (*f && strchr("hlqjzt", *f)) {
+            f++;
+        }
+        char conv = *f ? *f++ : '\0';
+
+        int n;
+        if (conv == 's') {
+            n = snprintf(out + pos, len - pos, "%.*s%s", (int)rec->str_len, rec->str, rec->str_cut ? "..." : "");
+        } else if (conv && strchr("diuxXoc", conv)) {
+            uint32_t v = arg < rec->nargs ? rec->args[arg] : 0;
+            arg++;
+            if (conv == 'c') {
+                spec[s++] = conv;
+                spec[s] = '\0';
+                n = snprintf(out + pos, len - pos, spec, (int)v);
+            } else {
+                spec[s++] = 'l';
+                spec[s++] = conv;
+                spec[s] = '\0';
+                if (conv == 'd' || conv == 'i') {
+                    n = snprintf(out + pos, len - pos, spec, (long)(int32_t)v);
+                } else {
+                    n = snprintf(out + pos, len - pos, spec, (unsigned long)v);
+                }
+            }
+        } else {
+            n = snprintf(out + pos, len - pos, "?");
+        }
+        if (n > 0) {
+            pos += (size_t)n < len - pos ? (size_t)n : len - pos - 1;
+        }
+    }
+    out[pos] = '\0';
+}
+
+static void print_record(const trace_log_record_t *rec)
+{
+    static const char letters[] = "NEWIDV";
+    char line[TRACE_LOG_LINE_MAX];
+    esp_log_level_t level = (esp_log_level_t)rec->level;
+
+    format_record(rec, line, sizeof(line));
+    esp_log_write(level, rec->tag, "%c (%lu) %s: %s\n",
+                  level < sizeof(letters) - 1 ? letters[level] : '?',
+                  (unsigned long)(rec->time_us / 1000), rec->tag, line);
+}
+
+// 输出到当前写入位置为止的所有记录, 持有s_flush_lock时调用
+static void drain(void)
+{
+    uint32_t head = atomic_load_explicit(&s_head, memory_order_acquire);
+
+    if (head - s_tail > TRACE_LOG_DEPTH) {
+        metric_add(&s_m_dropped, head - s_tail - TRACE_LOG_DEPTH);
+        s_tail = head - TRACE_LOG_DEPTH;
+    }
+
+    while (s_tail != head) {
+        trace_log_record_t *rec = &s_ring[s_tail & (TRACE_LOG_DEPTH - 1)];
+        uint32_t expect = s_tail + 1;
+        uint32_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+
+        if (seq != expect) {
+            if ((int32_t)(seq - expect) > 0) {
+                // 已被更新的记录覆盖
+                metric_inc(&s_m_dropped);
+                s_tail++;
+                continue;
+            }
+            // 还在写入, 下次再读
+            break;
+        }
+
+        trace_log_record_t copy;
+        memcpy(&copy, rec, sizeof(copy));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&rec->seq, memory_order_relaxed) != seq) {
+            metric_inc(&s_m_dropped);
+            s_tail++;
+            continue;
+        }
+        s_tail++;
+        print_record(&copy);
+    }
+}
+
+void trace_log_flush(void)
+{
+    if (!s_flush_lock) {
+        return;
+    }
+    xSemaphoreTake(s_flush_lock, portMAX_DELAY);
+    drain();
+    xSemaphoreGive(s_flush_lock);
+}
+
+static void trace_log_task(void *arg)
+{
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(TRACE_LOG_FLUSH_MS));
+        trace_log_flush();
+    }
+}
+
+esp_err_t trace_log_init(UBaseType_t priority)
+{
+    if (s_task) {
+        return ESP_OK;
+    }
+    s_flush_lock = xSemaphoreCreateMutex();
+    if (!s_flush_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    metrics_register(&s_m_dropped);
+    if (xTaskCreate(trace_log_task, "trace_log", 4096, NULL, priority, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
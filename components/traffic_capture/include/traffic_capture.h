@@ -0,0 +1,81 @@
+#ifndef TRAFFIC_CAPTURE_H
+#define TRAFFIC_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * 网络流量抓包与回放
+ *
+ * 抓包: 在FunASR WebSocket和Ollama HTTP事件处理函数入口记录收到的原始字节和时刻,
+ * 写入文件(只在有文件系统的环境中可用, 即主机构建). 回放程序见 replay/.
+ *
+ * 文件格式(本机字节序, 只在同一类主机上读写):
+ *   文件头 traffic_capture_file_header_t
+ *   记录   traffic_capture_header_t + len字节负载, 按时间顺序
+ */
+
+#define TRAFFIC_CAPTURE_MAGIC       0x43525456      // "VTRC"
+#define TRAFFIC_CAPTURE_VERSION     1
+
+/* 通道 */
+typedef enum {
+    TRAFFIC_CAPTURE_FUNASR = 0,     // event为esp_websocket_event_id_t, op_code为帧类型
+    TRAFFIC_CAPTURE_OLLAMA = 1,     // event为esp_http_client_event_id_t
+} traffic_capture_channel_t;
+
+/* 请求边界: Ollama每次发出请求时记录一条, 负载为请求体 */
+#define TRAFFIC_CAPTURE_REQUEST     (-1)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+} traffic_capture_file_header_t;
+
+typedef struct {
+    int64_t time_us;                // 相对开始抓包的时刻
+    int32_t event;
+    uint32_t len;                   // 负载字节数
+    uint8_t channel;
+    uint8_t op_code;
+    uint8_t reserved[6];
+} traffic_capture_header_t;
+
+/* 加载到内存的一条记录, 负载后面补了'\0' */
+typedef struct {
+    traffic_capture_header_t hdr;
+    char *data;
+} traffic_capture_entry_t;
+
+/**
+ * @brief 开始抓包, 之后的记录写入path(覆盖)
+ */
+esp_err_t traffic_capture_open(const char *path);
+
+/**
+ * @brief 记录一个事件, 没有开始抓包时直接返回
+ *
+ * 可在多个任务中调用.
+ */
+void traffic_capture_record(traffic_capture_channel_t channel, int32_t event, uint8_t op_code,
+                            const void *data, size_t len);
+
+/**
+ * @brief 结束抓包并关闭文件
+ */
+void traffic_capture_close(void);
+
+/**
+ * @brief 把抓包文件全部读入内存
+ *
+ * @param[out] entries 记录数组, 用traffic_capture_free释放
+ * @param[out] count 记录数
+ * @return ESP_ERR_NOT_FOUND: 文件打不开; ESP_ERR_INVALID_VERSION: 不是抓包文件或版本不符
+ */
+esp_err_t traffic_capture_load(const char *path, traffic_capture_entry_t **entries, size_t *count);
+
+void traffic_capture_free(traffic_capture_entry_t *entries, size_t count);
+
+#endif /* TRAFFIC_CAPTURE_H */
@@ -0,0 +1,163 @@
+/*
+ * 网络流量抓包与回放文件读写
+ *
+ * 没有开始抓包时记录函数只读一次指针; 开始后每条记录在互斥锁内整条写入,
+ * 两个网络任务的记录不会交错.
+ */
+
+#include "traffic_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "TRAFFIC_CAPTURE";
+
+_Static_assert(sizeof(traffic_capture_header_t) == 24, "capture record header must not be padded");
+
+static FILE *volatile s_fp;
+static SemaphoreHandle_t s_lock;
+static int64_t s_start_us;
+
+esp_err_t traffic_capture_open(const char *path)
+{
+    if (!path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    traffic_capture_close();
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        ESP_LOGE(TAG, "无法创建抓包文件 %s", path);
+        return ESP_FAIL;
+    }
+    traffic_capture_file_header_t file_hdr = {
+        .magic = TRAFFIC_CAPTURE_MAGIC,
+        .version = TRAFFIC_CAPTURE_VERSION,
+    };
+    fwrite(&file_hdr, sizeof(file_hdr), 1, fp);
+
+    s_start_us = esp_timer_get_time();
+    s_fp = fp;
+    ESP_LOGI(TAG, "抓包写入 %s", path);
+    return ESP_OK;
+}
+
+void traffic_capture_record(traffic_capture_channel_t channel, int32_t event, uint8_t op_code,
+                            const void *data, size_t len)
+{
+    if (!s_fp) {
+        return;
+    }
+    traffic_capture_header_t hdr = {
+        .event = event,
+        .len = data ? (uint32_t)len : 0,
+        .channel = (uint8_t)channel,
+        .op_code = op_code,
+    };
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_fp) {
+        hdr.time_us = esp_timer_get_time() - s_start_us;
+        fwrite(&hdr, sizeof(hdr), 1, s_fp);
+        if (hdr.len) {
+            fwrite(data, 1, hdr.len, s_fp);
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void traffic_capture_close(void)
+{
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_fp) {
+        fclose(s_fp);
+        s_fp = NULL;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t traffic_capture_load(const char *path, traffic_capture_entry_t **entries, size_t *count)
+{
+    if (!path || !entries || !count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *entries = NULL;
+    *count = 0;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    traffic_capture_file_header_t file_hdr;
+    if (fread(&file_hdr, sizeof(file_hdr), 1, fp) != 1 ||
+        file_hdr.magic != TRAFFIC_CAPTURE_MAGIC || file_hdr.version != TRAFFIC_CAPTURE_VERSION) {
+        fclose(fp);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    traffic_capture_entry_t *list = NULL;
+    size_t n = 0;
+    size_t cap = 0;
+    esp_err_t err = ESP_OK;
+    traffic_capture_header_t hdr;
+
+    while (fread(&hdr, sizeof(hdr), 1, fp) == 1) {
+        if (n == cap) {
+            size_t new_cap = cap ? cap * 2 : 256;
+            traffic_capture_entry_t *grown = realloc(list, new_cap * sizeof(*list));
+            if (!grown) {
+                err = ESP_ERR_NO_MEM;
+                break;
+            }
+            list = grown;
+            cap = new_cap;
+        }
+        char *data = malloc(hdr.len + 1);
+        if (!data) {
+            err = ESP_ERR_NO_MEM;
+            break;
+        }
+        if (hdr.len && fread(data, 1, hdr.len, fp) != hdr.len) {
+            // 抓包被中断时最后一条可能不完整, 丢弃
+            free(data);
+            break;
+        }
+        data[hdr.len] = '\0';
+        list[n].hdr = hdr;
+        list[n].data = data;
+        n++;
+    }
+    fclose(fp);
+
+    if (err != ESP_OK) {
+        traffic_capture_free(list, n);
+        return err;
+    }
+    *entries = list;
+    *count = n;
+    return ESP_OK;
+}
+
+void traffic_capture_free(traffic_capture_entry_t *entries, size_t count)
+{
+    if (!entries) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].data);
+    }
+    free(entries);
+}
@@ -0,0 +1,121 @@
+#ifndef TTS_CACHE_H
+#define TTS_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* 最多缓存的短语条数 */
+#define TTS_CACHE_MAX_ENTRIES       32
+
+/* 单条短语最多缓存的样本数(16kHz下8秒), 更长的不缓存 */
+#define TTS_CACHE_MAX_ENTRY_SAMPLES (16000 * 8)
+
+/**
+ * @brief 统计信息
+ */
+typedef struct {
+    uint32_t hits;          // 命中次数
+    uint32_t misses;        // 未命中次数
+    uint32_t inserts;       // 写入条数
+    uint32_t evictions;     // 因预算不足淘汰的条数
+    uint32_t skipped;       // 过长或超出预算未能缓存的条数
+    uint32_t compactions;   // 为放下新条目而紧凑arena的次数
+    size_t   bytes_used;    // 当前占用字节数
+    size_t   entries;       // 当前条数
+} tts_cache_stats_t;
+
+/**
+ * @brief 单条缓存, 以双向链表按最近使用排序
+ */
+typedef struct {
+    uint64_t key;
+    int16_t *pcm;           // 指向arena内部, NULL表示空闲
+    size_t   samples;
+    int8_t   prev;
+    int8_t   next;
+} tts_cache_entry_t;
+
+/**
+ * @brief 短语级PCM缓存(LRU)
+ *
+ * 以归一化文本的哈希为键, 把合成好的16kHz PCM保存在PSRAM中.
+ * 初始化时一次性分配预算大小的arena和暂存区, 之后写入和淘汰都只在arena内
+ * 移动数据, 不再有堆分配. 空隙放不下新条目时把现有条目向前紧凑.
+ * 查询和写入都只能在同一个任务(语音合成任务)中进行,
+ * 查到的PCM在该任务下一次写入缓存之前一直有效.
+ */
+typedef struct {
+    tts_cache_entry_t entries[TTS_CACHE_MAX_ENTRIES];
+    int8_t   mru;               // 最近使用
+    int8_t   lru;               // 最久未使用
+    size_t   budget_bytes;
+    uint8_t *arena;             // 所有条目的PCM, budget_bytes字节
+
+    // 正在合成的短语先写入暂存区, 完成后再按实际长度存入
+    int16_t *staging;
+    size_t   staging_samples;
+    uint64_t staging_key;
+    bool     staging_active;
+
+    tts_cache_stats_t stats;
+} tts_cache_t;
+
+/**
+ * @brief 初始化缓存
+ *
+ * arena和暂存区只分配在PSRAM中(主机构建为普通堆), 之后不再分配内存.
+ *
+ * @param cache 缓存
+ * @param budget_bytes 所有缓存PCM的总字节预算
+ * @return esp_err_t ESP_ERR_NOT_SUPPORTED: 没有PSRAM; ESP_ERR_NO_MEM: PSRAM不足
+ */
+esp_err_t tts_cache_init(tts_cache_t *cache, size_t budget_bytes);
+
+/**
+ * @brief 释放所有缓存
+ */
+void tts_cache_deinit(tts_cache_t *cache);
+
+/**
+ * @brief 计算文本的缓存键
+ *
+ * 去掉空白, ASCII字母转小写, 全角ASCII字符转半角后做64位FNV-1a哈希.
+ * 标点会影响停顿, 因此保留.
+ */
+uint64_t tts_cache_key(const char *text);
+
+/**
+ * @brief 查询缓存, 命中时移到最近使用位置
+ *
+ * @return true: 命中, pcm/samples指向缓存数据
+ */
+bool tts_cache_lookup(tts_cache_t *cache, const char *text, const int16_t **pcm, size_t *samples);
+
+/**
+ * @brief 开始记录一条短语的合成结果
+ */
+void tts_cache_begin(tts_cache_t *cache, const char *text);
+
+/**
+ * @brief 追加合成出的PCM, 超过单条上限时放弃本条
+ */
+void tts_cache_append(tts_cache_t *cache, const int16_t *pcm, size_t samples);
+
+/**
+ * @brief 本条合成完整结束, 存入缓存(必要时淘汰最久未使用的条目)
+ */
+void tts_cache_commit(tts_cache_t *cache);
+
+/**
+ * @brief 放弃本条(合成被打断等)
+ */
+void tts_cache_abort(tts_cache_t *cache);
+
+/**
+ * @brief 获取统计信息
+ */
+void tts_cache_get_stats(const tts_cache_t *cache, tts_cache_stats_t *stats);
+
+#endif /* TTS_CACHE_H */
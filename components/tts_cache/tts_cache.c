@@ -0,0 +1,304 @@
+/*
+ * 短语级TTS PCM缓存
+ *
+ * 开机问候和大模型常用的短句("好的", "没问题"等)反复出现,
+ * 每次都重新做esp_tts_parse_chinese + esp_tts_stream_play.
+ * 这里按LRU缓存合成结果, 命中时直接播放缓存的PCM.
+ * 所有条目放在初始化时分配的一块arena中, 运行期没有堆分配,
+ * 也就不会在PSRAM堆上留下碎片.
+ * 数据只放在PSRAM中: 1MB的预算放进内部RAM会挤占WiFi/LWIP和DMA缓冲,
+ * 没有PSRAM时初始化失败, 调用方不使用缓存.
+ */
+
+#include "tts_cache.h"
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+
+#define NIL (-1)
+
+// 主机构建没有PSRAM之分, 用普通堆
+#if CONFIG_IDF_TARGET_LINUX
+#define CACHE_CAPS  MALLOC_CAP_8BIT
+#else
+#define CACHE_CAPS  (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#endif
+
+static void *cache_alloc(size_t bytes)
+{
+    return heap_caps_malloc(bytes, CACHE_CAPS);
+}
+
+esp_err_t tts_cache_init(tts_cache_t *cache, size_t budget_bytes)
+{
+    if (!cache) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(cache, 0, sizeof(*cache));
+    cache->mru = NIL;
+    cache->lru = NIL;
+    cache->budget_bytes = budget_bytes;
+    for (int i = 0; i < TTS_CACHE_MAX_ENTRIES; i++) {
+        cache->entries[i].prev = NIL;
+        cache->entries[i].next = NIL;
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+    cache->arena = cache_alloc(budget_bytes ? budget_bytes : 1);
+    cache->staging = cache_alloc(TTS_CACHE_MAX_ENTRY_SAMPLES * sizeof(int16_t));
+    if (!cache->arena || !cache->staging) {
+        tts_cache_deinit(cache);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void tts_cache_deinit(tts_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+    for (int i = 0; i < TTS_CACHE_MAX_ENTRIES; i++) {
+        cache->entries[i].pcm = NULL;
+    }
+    heap_caps_free(cache->arena);
+    cache->arena = NULL;
+    heap_caps_free(cache->staging);
+    cache->staging = NULL;
+}
+
+uint64_t tts_cache_key(const char *text)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const unsigned char *p = (const unsigned char *)text;
+
+    while (*p) {
+        unsigned char c = *p;
+        // 全角ASCII(U+FF01..U+FF5E, UTF-8为EF BC 81..EF BD 9E)转半角
+        if (c == 0xEF && (p[1] == 0xBC || p[1] == 0xBD) && p[2] >= 0x80 && p[2] <= 0xBF) {
+            unsigned cp = 0xFF00 + ((p[1] & 0x03) << 6) + (p[2] & 0x3F);
+            if (cp >= 0xFF01 && cp <= 0xFF5E) {
+                c = (unsigned char)(cp - 0xFF01 + 0x21);
+                p += 2;
+            }
+        }
+        p++;
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            continue;
+        }
+        if (c >= 'A' && c <= 'Z') {
+            c = c - 'A' + 'a';
+        }
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void list_unlink(tts_cache_t *cache, int idx)
+{
+    tts_cache_entry_t *e = &cache->entries[idx];
+    if (e->prev != NIL) {
+        cache->entries[e->prev].next = e->next;
+    } else {
+        cache->mru = e->next;
+    }
+    if (e->next != NIL) {
+        cache->entries[e->next].prev = e->prev;
+    } else {
+        cache->lru = e->prev;
+    }
+    e->prev = NIL;
+    e->next = NIL;
+}
+
+static void list_push_front(tts_cache_t *cache, int idx)
+{
+    tts_cache_entry_t *e = &cache->entries[idx];
+    e->prev = NIL;
+    e->next = cache->mru;
+    if (cache->mru != NIL) {
+        cache->entries[cache->mru].prev = idx;
+    }
+    cache->mru = idx;
+    if (cache->lru == NIL) {
+        cache->lru = idx;
+    }
+}
+
+static int find_entry(const tts_cache_t *cache, uint64_t key)
+{
+    for (int i = cache->mru; i != NIL; i = cache->entries[i].next) {
+        if (cache->entries[i].key == key) {
+            return i;
+        }
+    }
+    return NIL;
+}
+
+static void evict_lru(tts_cache_t *cache)
+{
+    int idx = cache->lru;
+    if (idx == NIL) {
+        return;
+    }
+    tts_cache_entry_t *e = &cache->entries[idx];
+    list_unlink(cache, idx);
+    cache->stats.bytes_used -= e->samples * sizeof(int16_t);
+    cache->stats.entries--;
+    cache->stats.evictions++;
+    e->pcm = NULL;
+    e->samples = 0;
+}
+
+// 在用的条目按PCM地址排序, 返回条数
+static int sort_by_address(const tts_cache_t *cache, int *order)
+{
+    int count = 0;
+    for (int i = 0; i < TTS_CACHE_MAX_ENTRIES; i++) {
+        if (!cache->entries[i].pcm) {
+            continue;
+        }
+        int j = count++;
+        while (j > 0 && cache->entries[order[j - 1]].pcm > cache->entries[i].pcm) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    return count;
+}
+
+// 在arena中找一段bytes字节的连续空间: 按地址顺序首次适配条目之间的空隙,
+// 都放不下时把所有条目向前紧凑, 空闲空间合并到末尾.
+// 调用前已保证 已用 + bytes <= 预算, 因此紧凑后一定放得下
+static uint8_t *arena_place(tts_cache_t *cache, size_t bytes)
+{
+    int order[TTS_CACHE_MAX_ENTRIES];
+    int count = sort_by_address(cache, order);
+    uint8_t *end = cache->arena + cache->budget_bytes;
+    uint8_t *pos = cache->arena;
+
+    for (int i = 0; i < count; i++) {
+        tts_cache_entry_t *e = &cache->entries[order[i]];
+        if ((size_t)((uint8_t *)e->pcm - pos) >= bytes) {
+            return pos;
+        }
+        pos = (uint8_t *)(e->pcm + e->samples);
+    }
+    if ((size_t)(end - pos) >= bytes) {
+        return pos;
+    }
+
+    pos = cache->arena;
+    for (int i = 0; i < count; i++) {
+        tts_cache_entry_t *e = &cache->entries[order[i]];
+        size_t len = e->samples * sizeof(int16_t);
+        memmove(pos, e->pcm, len);
+        e->pcm = (int16_t *)pos;
+        pos += len;
+    }
+    cache->stats.compactions++;
+    return pos;
+}
+
+bool tts_cache_lookup(tts_cache_t *cache, const char *text, const int16_t **pcm, size_t *samples)
+{
+    int idx = find_entry(cache, tts_cache_key(text));
+    if (idx == NIL) {
+        cache->stats.misses++;
+        return false;
+    }
+
+    list_unlink(cache, idx);
+    list_push_front(cache, idx);
+    *pcm = cache->entries[idx].pcm;
+    *samples = cache->entries[idx].samples;
+    cache->stats.hits++;
+    return true;
+}
+
+void tts_cache_begin(tts_cache_t *cache, const char *text)
+{
+    cache->staging_key = tts_cache_key(text);
+    cache->staging_samples = 0;
+    cache->staging_active = cache->staging != NULL;
+}
+
+void tts_cache_append(tts_cache_t *cache, const int16_t *pcm, size_t samples)
+{
+    if (!cache->staging_active) {
+        return;
+    }
+    if (cache->staging_samples + samples > TTS_CACHE_MAX_ENTRY_SAMPLES) {
+        cache->staging_active = false;
+        cache->stats.skipped++;
+        return;
+    }
+    memcpy(cache->staging + cache->staging_samples, pcm, samples * sizeof(int16_t));
+    cache->staging_samples += samples;
+}
+
+void tts_cache_commit(tts_cache_t *cache)
+{
+    if (!cache->staging_active) {
+        return;
+    }
+    cache->staging_active = false;
+
+    size_t bytes = cache->staging_samples * sizeof(int16_t);
+    if (bytes == 0 || find_entry(cache, cache->staging_key) != NIL) {
+        return;
+    }
+    if (bytes > cache->budget_bytes) {
+        cache->stats.skipped++;
+        return;
+    }
+
+    // 按预算和条数淘汰最久未使用的条目
+    while (cache->stats.bytes_used + bytes > cache->budget_bytes ||
+           cache->stats.entries >= TTS_CACHE_MAX_ENTRIES) {
+        evict_lru(cache);
+    }
+
+    int idx = NIL;
+    for (int i = 0; i < TTS_CACHE_MAX_ENTRIES; i++) {
+        if (!cache->entries[i].pcm) {
+            idx = i;
+            break;
+        }
+    }
+    if (idx == NIL) {
+        cache->stats.skipped++;
+        return;
+    }
+    int16_t *copy = (int16_t *)arena_place(cache, bytes);
+    memcpy(copy, cache->staging, bytes);
+
+    tts_cache_entry_t *e = &cache->entries[idx];
+    e->key = cache->staging_key;
+    e->pcm = copy;
+    e->samples = cache->staging_samples;
+    list_push_front(cache, idx);
+    cache->stats.bytes_used += bytes;
+    cache->stats.entries++;
+    cache->stats.inserts++;
+}
+
+void tts_cache_abort(tts_cache_t *cache)
+{
+    cache->staging_active = false;
+}
+
+void tts_cache_get_stats(const tts_cache_t *cache, tts_cache_stats_t *stats)
+{
+    if (stats) {
+        *stats = cache->stats;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef TTS_ENGINE_H
+#define TTS_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* 输出采样率 */
+#define TTS_ENGINE_SAMPLE_RATE  16000
+
+/* 合成语速(esp_tts的0~5) */
+#define TTS_ENGINE_SPEED        3
+
+/**
+ * @brief 流式语音合成引擎
+ *
+ * 设备上封装esp_tts(语音数据来自voice_data分区);
+ * 主机构建用确定性的音调序列代替, 每个字一段音调, 标点处停顿,
+ * 输出时长和文本长度相关, 便于在工作站上测量流水线.
+ */
+typedef struct tts_engine tts_engine_t;
+
+/**
+ * @brief 创建合成引擎
+ *
+ * @param[out] out 引擎句柄
+ * @return esp_err_t
+ */
+esp_err_t tts_engine_create(tts_engine_t **out);
+
+/**
+ * @brief 开始合成一条文本
+ *
+ * @return false: 文本无法解析
+ */
+bool tts_engine_begin(tts_engine_t *engine, const char *text);
+
+/**
+ * @brief 取下一段合成结果
+ *
+ * @param[out] samples 本段样本数
+ * @return PCM数据(在下次调用前有效), NULL表示本条已合成完
+ */
+const int16_t *tts_engine_next(tts_engine_t *engine, size_t *samples);
+
+/**
+ * @brief 结束本条合成, 丢弃未取走的部分
+ */
+void tts_engine_reset(tts_engine_t *engine);
+
+#endif /* TTS_ENGINE_H */
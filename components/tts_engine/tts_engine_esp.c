@@ -0,0 +1,86 @@
+/*
+ * 设备端合成引擎: esp_tts, 语音数据从voice_data分区映射
+ */
+
+#include "tts_engine.h"
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_partition.h"            // 分区表操作
+#include "esp_tts.h"                  // 语音合成库头文件
+#include "esp_tts_voice_template.h"   // 语音模板
+
+static const char *TAG = "TTS_ENGINE";
+
+struct tts_engine {
+    esp_tts_handle_t *tts;
+};
+
+esp_err_t tts_engine_create(tts_engine_t **out)
+{
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 查找名为"voice_data"的数据分区
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "voice_data");
+    if (part == NULL) {
+        ESP_LOGE(TAG, "Couldn't find voice data partition!");
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "voice_data paration size:%ld", part->size);
+
+    // 将分区数据映射到内存中,便于访问
+    void *voicedata;
+    esp_partition_mmap_handle_t mmap;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &voicedata, &mmap);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Couldn't map voice data partition!");
+        return err;
+    }
+
+    // 使用语音模板和映射的语音数据初始化语音配置
+    esp_tts_voice_t *voice = esp_tts_voice_set_init(&esp_tts_voice_template, (int16_t *)voicedata);
+    if (voice == NULL) {
+        ESP_LOGE(TAG, "Failed to init voice set");
+        esp_partition_munmap(mmap);
+        return ESP_FAIL;
+    }
+
+    tts_engine_t *engine = calloc(1, sizeof(*engine));
+    if (!engine) {
+        esp_partition_munmap(mmap);
+        return ESP_ERR_NO_MEM;
+    }
+    // 使用初始化好的语音配置创建TTS句柄
+    engine->tts = esp_tts_create(voice);
+    if (!engine->tts) {
+        free(engine);
+        esp_partition_munmap(mmap);
+        return ESP_FAIL;
+    }
+
+    *out = engine;
+    return ESP_OK;
+}
+
+bool tts_engine_begin(tts_engine_t *engine, const char *text)
+{
+    return esp_tts_parse_chinese(engine->tts, text) != 0;
+}
+
+const int16_t *tts_engine_next(tts_engine_t *engine, size_t *samples)
+{
+    int len[1] = {0};
+    short *pcm = esp_tts_stream_play(engine->tts, len, TTS_ENGINE_SPEED);
+    if (!pcm || len[0] <= 0) {
+        *samples = 0;
+        return NULL;
+    }
+    *samples = (size_t)len[0];
+    return pcm;
+}
+
+void tts_engine_reset(tts_engine_t *engine)
+{
+    esp_tts_stream_reset(engine->tts);
+}
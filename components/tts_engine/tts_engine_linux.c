@@ -0,0 +1,153 @@
+/*
+ * 主机(linux目标)合成引擎: 确定性的音调序列
+ *
+ * 每个字输出一段音调(频率由码点决定)和短暂间隔, 标点输出停顿, 空白跳过.
+ * 可用环境变量按音频时长的百分比模拟合成耗时, 用来复现合成跟不上播放的情况.
+ */
+
+#include "tts_engine.h"
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* 合成耗时占音频时长的百分比, 未设置时为0(立即返回) */
+#define TTS_ENGINE_ENV_RTF      "VOICE_TTS_RTF_PCT"
+
+#define TTS_TONE_MS             120     // 每个字的音调时长
+#define TTS_GAP_MS              30      // 字间间隔
+#define TTS_PAUSE_MS            150     // 标点停顿
+#define TTS_FADE_MS             10      // 音调首尾渐变, 避免爆音
+#define TTS_AMPLITUDE           8000
+#define TTS_MAX_SEGMENT         ((TTS_TONE_MS + TTS_GAP_MS) * TTS_ENGINE_SAMPLE_RATE / 1000)
+
+struct tts_engine {
+    const char *text;               // 正在合成的文本(调用方持有)
+    const char *cursor;
+    uint32_t rtf_pct;
+    int16_t pcm[TTS_MAX_SEGMENT];
+};
+
+esp_err_t tts_engine_create(tts_engine_t **out)
+{
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tts_engine_t *engine = calloc(1, sizeof(*engine));
+    if (!engine) {
+        return ESP_ERR_NO_MEM;
+    }
+    const char *rtf = getenv(TTS_ENGINE_ENV_RTF);
+    engine->rtf_pct = rtf ? (uint32_t)strtoul(rtf, NULL, 10) : 0;
+    *out = engine;
+    return ESP_OK;
+}
+
+bool tts_engine_begin(tts_engine_t *engine, const char *text)
+{
+    engine->text = text;
+    engine->cursor = text;
+    return text != NULL && *text != '\0';
+}
+
+// 解码一个UTF-8码点, 非法字节按单字节处理
+static uint32_t next_codepoint(const char **p)
+{
+    const uint8_t *s = (const uint8_t *)*p;
+    uint32_t cp = s[0];
+    int extra = 0;
+
+    if (cp >= 0xF0) {
+        cp &= 0x07;
+        extra = 3;
+    } else if (cp >= 0xE0) {
+        cp &= 0x0F;
+        extra = 2;
+    } else if (cp >= 0xC0) {
+        cp &= 0x1F;
+        extra = 1;
+    }
+    int i = 1;
+    for (; i <= extra && (s[i] & 0xC0) == 0x80; i++) {
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    *p += i;
+    return cp;
+}
+
+static bool is_pause(uint32_t cp)
+{
+    switch (cp) {
+    case ',': case '.': case '!': case '?': case ';': case ':':
+    case 0x3001: case 0x3002:                       // 、。
+    case 0xFF0C: case 0xFF01: case 0xFF1F:          // ，！？
+    case 0xFF1B: case 0xFF1A:                       // ；：
+        return true;
+    default:
+        return false;
+    }
+}
+
+// 三角波音调, 首尾线性渐变
+static size_t render_tone(int16_t *out, uint32_t cp)
+{
+    const size_t tone = TTS_TONE_MS * TTS_ENGINE_SAMPLE_RATE / 1000;
+    const size_t gap = TTS_GAP_MS * TTS_ENGINE_SAMPLE_RATE / 1000;
+    const size_t fade = TTS_FADE_MS * TTS_ENGINE_SAMPLE_RATE / 1000;
+    const uint32_t freq = 180 + (cp % 40) * 10;
+    const uint32_t step = (uint32_t)(((uint64_t)freq << 32) / TTS_ENGINE_SAMPLE_RATE);
+    uint32_t phase = 0;
+
+    for (size_t i = 0; i < tone; i++) {
+        // 相位高16位折成三角波: -32768..32767
+        int32_t x = (int32_t)(phase >> 16);
+        int32_t tri = x < 32768 ? 2 * x - 32768 : 3 * 32768 - 2 * x - 1;
+        int32_t v = tri * TTS_AMPLITUDE / 32768;
+        size_t edge = i < tone - i ? i : tone - i;
+        if (edge < fade) {
+            v = v * (int32_t)edge / (int32_t)fade;
+        }
+        out[i] = (int16_t)v;
+        phase += step;
+    }
+    memset(out + tone, 0, gap * sizeof(int16_t));
+    return tone + gap;
+}
+
+const int16_t *tts_engine_next(tts_engine_t *engine, size_t *samples)
+{
+    *samples = 0;
+    if (!engine->cursor) {
+        return NULL;
+    }
+
+    size_t n = 0;
+    while (n == 0 && *engine->cursor) {
+        uint32_t cp = next_codepoint(&engine->cursor);
+        if (cp == ' ' || cp == '\t' || cp == '\r' || cp == '\n' || cp == 0x3000) {
+            continue;
+        }
+        if (is_pause(cp)) {
+            n = TTS_PAUSE_MS * TTS_ENGINE_SAMPLE_RATE / 1000;
+            memset(engine->pcm, 0, n * sizeof(int16_t));
+        } else {
+            n = render_tone(engine->pcm, cp);
+        }
+    }
+    if (n == 0) {
+        return NULL;
+    }
+
+    if (engine->rtf_pct) {
+        uint32_t ms = (uint32_t)(n * 1000 / TTS_ENGINE_SAMPLE_RATE) * engine->rtf_pct / 100;
+        vTaskDelay(pdMS_TO_TICKS(ms));
+    }
+    *samples = n;
+    return engine->pcm;
+}
+
+void tts_engine_reset(tts_engine_t *engine)
+{
+    engine->text = NULL;
+    engine->cursor = NULL;
+}
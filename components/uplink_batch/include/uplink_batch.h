@@ -0,0 +1,68 @@
+#ifndef UPLINK_BATCH_H
+#define UPLINK_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/* 发送耗时占音频时长的比例超过该值视为拥塞, 批量加倍(Q8, 128 = 50%) */
+#define UPLINK_BATCH_CONGESTED_Q8   128
+
+/* 低于该值且没有积压视为链路空闲, 批量减一帧(Q8, 38 约15%) */
+#define UPLINK_BATCH_IDLE_Q8        38
+
+/* 积压超过该帧数也视为拥塞 */
+#define UPLINK_BATCH_BACKLOG_FRAMES 2
+
+/* 发送耗时的平滑系数(1/2^N) */
+#define UPLINK_BATCH_EWMA_SHIFT     2
+
+/**
+ * @brief 自适应上传批量控制器
+ *
+ * 以每条消息的发送耗时(阻塞在TCP发送窗口上的时间, 反映带宽和往返时延)
+ * 与这条消息所含音频时长之比作为链路负载:
+ * 空闲时逐帧发送以降低延迟, 拥塞时成倍合并以减少每条消息的开销.
+ */
+typedef struct {
+    uint32_t frame_samples;     // 每帧样本数
+    uint32_t sample_rate;
+    uint32_t min_frames;
+    uint32_t max_frames;
+    uint32_t target_frames;     // 当前每条消息的帧数
+    int64_t  ewma_load_q8;      // 平滑后的负载(Q8)
+    uint32_t increases;         // 加大批量的次数
+    uint32_t decreases;         // 减小批量的次数
+} uplink_batch_t;
+
+/**
+ * @brief 初始化
+ *
+ * @param b 控制器
+ * @param frame_samples 每帧样本数
+ * @param sample_rate 采样率
+ * @param min_frames 最小批量(帧)
+ * @param max_frames 最大批量(帧), 应保证编码后不超过WebSocket缓冲区
+ */
+esp_err_t uplink_batch_init(uplink_batch_t *b, uint32_t frame_samples, uint32_t sample_rate,
+                            uint32_t min_frames, uint32_t max_frames);
+
+/**
+ * @brief 当前每条消息应包含的帧数
+ */
+static inline uint32_t uplink_batch_target(const uplink_batch_t *b)
+{
+    return b->target_frames;
+}
+
+/**
+ * @brief 报告一条消息的发送结果, 更新批量
+ *
+ * @param b 控制器
+ * @param frames 本条消息的帧数
+ * @param send_us 发送耗时
+ * @param backlog 发送完成时队列中积压的帧数
+ */
+void uplink_batch_report(uplink_batch_t *b, uint32_t frames, int64_t send_us, uint32_t backlog);
+
+#endif /* UPLINK_BATCH_H */
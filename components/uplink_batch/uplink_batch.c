@@ -0,0 +1,50 @@
+/*
+ * 自适应上传批量
+ *
+ * 拥塞时乘性增加批量, 空闲时加性减小, 避免在两个批量之间来回振荡.
+ */
+
+#include "uplink_batch.h"
+
+esp_err_t uplink_batch_init(uplink_batch_t *b, uint32_t frame_samples, uint32_t sample_rate,
+                            uint32_t min_frames, uint32_t max_frames)
+{
+    if (!b || frame_samples == 0 || sample_rate == 0 || min_frames == 0 || max_frames < min_frames) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    b->frame_samples = frame_samples;
+    b->sample_rate = sample_rate;
+    b->min_frames = min_frames;
+    b->max_frames = max_frames;
+    b->target_frames = min_frames;
+    b->ewma_load_q8 = 0;
+    b->increases = 0;
+    b->decreases = 0;
+    return ESP_OK;
+}
+
+void uplink_batch_report(uplink_batch_t *b, uint32_t frames, int64_t send_us, uint32_t backlog)
+{
+    if (frames == 0) {
+        return;
+    }
+
+    int64_t audio_us = (int64_t)frames * b->frame_samples * 1000000 / b->sample_rate;
+    int64_t load_q8 = send_us * 256 / audio_us;
+    b->ewma_load_q8 += (load_q8 - b->ewma_load_q8) >> UPLINK_BATCH_EWMA_SHIFT;
+
+    if (b->ewma_load_q8 > UPLINK_BATCH_CONGESTED_Q8 || backlog > UPLINK_BATCH_BACKLOG_FRAMES) {
+        if (b->target_frames < b->max_frames) {
+            b->target_frames *= 2;
+            if (b->target_frames > b->max_frames) {
+                b->target_frames = b->max_frames;
+            }
+            b->increases++;
+        }
+    } else if (b->ewma_load_q8 < UPLINK_BATCH_IDLE_Q8 && backlog == 0) {
+        if (b->target_frames > b->min_frames) {
+            b->target_frames--;
+            b->decreases++;
+        }
+    }
+}
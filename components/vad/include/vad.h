@@ -0,0 +1,97 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* 帧参数: 16kHz, 20ms一帧 */
+#define VAD_SAMPLE_RATE         16000
+#define VAD_FRAME_SAMPLES       320
+
+/* 连续多少帧语音判定为语音开始(3帧 = 60ms) */
+#define VAD_START_FRAMES        3
+
+/* 语音结束前的拖尾帧数(25帧 = 500ms) */
+#define VAD_HANGOVER_FRAMES     25
+
+/* 帧能量高于噪声底多少倍才可能是语音(Q4, 64 = 4倍 = 6dB) */
+#define VAD_SNR_THRESHOLD_Q4    64
+
+/* 帧能量高于噪声底多少倍时无需频谱特征直接判为语音(Q4, 256 = 16倍 = 12dB) */
+#define VAD_SNR_STRONG_Q4       256
+
+/* 差分能量/帧能量之比上限(Q8), 低于该值说明能量集中在低频(浊音) */
+#define VAD_TILT_MAX_Q8         307
+
+/* 过零次数下限, 高于该值认为是清音/摩擦音 */
+#define VAD_ZCR_FRICATIVE       96
+
+/* 噪声底下限(均方值), 避免完全静音时阈值为0 */
+#define VAD_NOISE_FLOOR_MIN     64
+
+/**
+ * @brief VAD状态
+ */
+typedef enum {
+    VAD_STATE_SILENCE = 0,  // 静音
+    VAD_STATE_ONSET,        // 疑似语音开始, 等待确认
+    VAD_STATE_SPEECH,       // 语音中
+    VAD_STATE_HANGOVER,     // 语音后的拖尾
+} vad_state_t;
+
+/**
+ * @brief 单帧处理后产生的事件
+ */
+typedef enum {
+    VAD_EVENT_NONE = 0,
+    VAD_EVENT_SPEECH_START,
+    VAD_EVENT_SPEECH_END,
+} vad_event_t;
+
+/**
+ * @brief 单帧特征, 便于调试和调参
+ */
+typedef struct {
+    uint32_t energy;        // 去直流后的均方值
+    uint32_t noise;         // 当前噪声底估计
+    uint16_t tilt_q8;       // 差分能量/帧能量(Q8)
+    uint16_t zcr;           // 过零次数
+    bool is_speech;         // 本帧判决结果
+} vad_frame_info_t;
+
+/**
+ * @brief VAD实例
+ */
+typedef struct {
+    vad_state_t state;
+    int counter;            // ONSET/HANGOVER状态下的帧计数
+    uint32_t noise;         // 噪声底(均方值)
+    bool noise_valid;       // 噪声底是否已用第一帧初始化
+    int16_t last_sample;    // 上一帧最后一个样本, 用于跨帧差分
+    vad_frame_info_t info;  // 最近一帧的特征
+} vad_t;
+
+/**
+ * @brief 初始化(或复位)VAD
+ *
+ * @param vad VAD实例
+ * @return esp_err_t
+ */
+esp_err_t vad_init(vad_t *vad);
+
+/**
+ * @brief 处理一帧(VAD_FRAME_SAMPLES个样本)16kHz音频
+ *
+ * @param vad VAD实例
+ * @param frame 音频帧
+ * @return vad_event_t 状态切换事件
+ */
+vad_event_t vad_process_frame(vad_t *vad, const int16_t *frame);
+
+/**
+ * @brief 当前是否处于语音段(包括拖尾)
+ */
+bool vad_is_speech(const vad_t *vad);
+
+#endif /* VAD_H */
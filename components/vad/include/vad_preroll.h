@@ -0,0 +1,63 @@
+#ifndef VAD_PREROLL_H
+#define VAD_PREROLL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "vad.h"
+
+/* 预录最大长度(毫秒), 决定缓冲区大小; 语音开始时把这段音频补发给服务器, 避免丢失字头 */
+#ifndef VAD_PREROLL_MS
+#define VAD_PREROLL_MS          320
+#endif
+
+#define VAD_PREROLL_SAMPLES     (VAD_SAMPLE_RATE / 1000 * VAD_PREROLL_MS)
+
+/**
+ * @brief 预录环形缓冲区
+ *
+ * 固定大小, 不做任何动态内存分配. 写满后覆盖最旧的数据.
+ */
+typedef struct {
+    int16_t buf[VAD_PREROLL_SAMPLES];
+    size_t capacity;    // 实际使用的长度(样本)
+    size_t head;        // 下一个写入位置
+    size_t count;       // 有效样本数
+} vad_preroll_t;
+
+/**
+ * @brief 初始化(或清空)预录缓冲区
+ *
+ * @param pr 预录缓冲区
+ * @param capacity 预录长度(样本), 1 ~ VAD_PREROLL_SAMPLES
+ * @return esp_err_t
+ */
+esp_err_t vad_preroll_init(vad_preroll_t *pr, size_t capacity);
+
+/**
+ * @brief 写入样本, 超出容量时覆盖最旧的样本
+ *
+ * @param pr 预录缓冲区
+ * @param samples 样本
+ * @param len 样本数
+ */
+void vad_preroll_push(vad_preroll_t *pr, const int16_t *samples, size_t len);
+
+/**
+ * @brief 按时间顺序取出全部样本并清空缓冲区
+ *
+ * @param pr 预录缓冲区
+ * @param out 输出缓冲区, 至少capacity个样本
+ * @return size_t 取出的样本数
+ */
+size_t vad_preroll_drain(vad_preroll_t *pr, int16_t *out);
+
+/**
+ * @brief 当前缓冲的样本数
+ */
+static inline size_t vad_preroll_count(const vad_preroll_t *pr)
+{
+    return pr->count;
+}
+
+#endif /* VAD_PREROLL_H */
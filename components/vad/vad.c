@@ -0,0 +1,132 @@
+/*
+ * 帧级语音活动检测
+ *
+ * 每20ms帧计算三个特征:
+ * - 去直流后的帧能量, 与自适应噪声底比较
+ * - 差分能量与帧能量之比(频谱倾斜), 浊音能量集中在低频, 比值小
+ * - 过零次数, 用于识别能量较低的清音/摩擦音
+ * 帧判决之后经过 静音 -> 起始确认 -> 语音 -> 拖尾 状态机平滑,
+ * 避免短噪声误触发和词间停顿误截断.
+ */
+
+#include "vad.h"
+
+#include <string.h>
+
+esp_err_t vad_init(vad_t *vad)
+{
+    if (!vad) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(vad, 0, sizeof(*vad));
+    vad->state = VAD_STATE_SILENCE;
+    vad->noise = VAD_NOISE_FLOOR_MIN;
+    return ESP_OK;
+}
+
+// 计算单帧特征并给出语音/非语音判决
+static bool vad_classify(vad_t *vad, const int16_t *frame)
+{
+    vad_frame_info_t *info = &vad->info;
+
+    int32_t sum = 0;
+    for (int i = 0; i < VAD_FRAME_SAMPLES; i++) {
+        sum += frame[i];
+    }
+    int32_t dc = sum / VAD_FRAME_SAMPLES;
+
+    uint64_t energy = 0;
+    uint64_t diff_energy = 0;
+    uint32_t zcr = 0;
+    int32_t prev = vad->last_sample - dc;
+    for (int i = 0; i < VAD_FRAME_SAMPLES; i++) {
+        int32_t x = frame[i] - dc;
+        int32_t d = x - prev;
+        energy += (int64_t)x * x;
+        diff_energy += (int64_t)d * d;
+        if ((x ^ prev) < 0) {
+            zcr++;
+        }
+        prev = x;
+    }
+    vad->last_sample = frame[VAD_FRAME_SAMPLES - 1];
+
+    energy /= VAD_FRAME_SAMPLES;
+    diff_energy /= VAD_FRAME_SAMPLES;
+
+    info->energy = (uint32_t)energy;
+    uint64_t tilt = energy ? diff_energy * 256 / energy : 0;
+    info->tilt_q8 = tilt > UINT16_MAX ? UINT16_MAX : (uint16_t)tilt;
+    info->zcr = (uint16_t)zcr;
+
+    // 第一帧直接作为噪声底初值
+    if (!vad->noise_valid) {
+        vad->noise = info->energy > VAD_NOISE_FLOOR_MIN ? info->energy : VAD_NOISE_FLOOR_MIN;
+        vad->noise_valid = true;
+    }
+    info->noise = vad->noise;
+
+    uint64_t scaled = (uint64_t)info->energy * 16;
+    bool loud = scaled > (uint64_t)vad->noise * VAD_SNR_THRESHOLD_Q4;
+    bool strong = scaled > (uint64_t)vad->noise * VAD_SNR_STRONG_Q4;
+    bool voiced = info->tilt_q8 < VAD_TILT_MAX_Q8;
+    bool fricative = info->zcr >= VAD_ZCR_FRICATIVE;
+    info->is_speech = strong || (loud && (voiced || fricative));
+
+    // 噪声底跟踪: 低于噪声底时快速下降, 非语音帧缓慢上升, 语音帧极慢上升(应对噪声环境变化)
+    uint32_t e = info->energy;
+    if (e < vad->noise) {
+        vad->noise -= (vad->noise - e) >> 2;
+    } else if (!info->is_speech) {
+        vad->noise += (e - vad->noise) >> 4;
+    } else {
+        vad->noise += (e - vad->noise) >> 10;
+    }
+    if (vad->noise < VAD_NOISE_FLOOR_MIN) {
+        vad->noise = VAD_NOISE_FLOOR_MIN;
+    }
+
+    return info->is_speech;
+}
+
+vad_event_t vad_process_frame(vad_t *vad, const int16_t *frame)
+{
+    bool speech = vad_classify(vad, frame);
+
+    switch (vad->state) {
+        case VAD_STATE_SILENCE:
+            if (speech) {
+                vad->counter = 1;
+                vad->state = VAD_STATE_ONSET;
+            }
+            break;
+        case VAD_STATE_ONSET:
+            if (!speech) {
+                vad->state = VAD_STATE_SILENCE;
+            } else if (++vad->counter >= VAD_START_FRAMES) {
+                vad->state = VAD_STATE_SPEECH;
+                return VAD_EVENT_SPEECH_START;
+            }
+            break;
+        case VAD_STATE_SPEECH:
+            if (!speech) {
+                vad->counter = 1;
+                vad->state = VAD_STATE_HANGOVER;
+            }
+            break;
+        case VAD_STATE_HANGOVER:
+            if (speech) {
+                vad->state = VAD_STATE_SPEECH;
+            } else if (++vad->counter >= VAD_HANGOVER_FRAMES) {
+                vad->state = VAD_STATE_SILENCE;
+                return VAD_EVENT_SPEECH_END;
+            }
+            break;
+    }
+    return VAD_EVENT_NONE;
+}
+
+bool vad_is_speech(const vad_t *vad)
+{
+    return vad->state == VAD_STATE_SPEECH || vad->state == VAD_STATE_HANGOVER;
+}
@@ -0,0 +1,63 @@
+/*
+ * 语音预录环形缓冲区
+ *
+ * VAD需要连续几帧才能确认语音开始, 再加上字头通常能量较低,
+ * 如果只发送确认之后的音频, 每句话开头的200~400ms会丢失.
+ * 静音期间把重采样后的音频持续写入这里, 语音开始时一次性补发.
+ */
+
+#include "vad_preroll.h"
+
+#include <string.h>
+
+esp_err_t vad_preroll_init(vad_preroll_t *pr, size_t capacity)
+{
+    if (!pr || capacity == 0 || capacity > VAD_PREROLL_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pr->capacity = capacity;
+    pr->head = 0;
+    pr->count = 0;
+    return ESP_OK;
+}
+
+void vad_preroll_push(vad_preroll_t *pr, const int16_t *samples, size_t len)
+{
+    // 只有最后capacity个样本有意义
+    if (len > pr->capacity) {
+        samples += len - pr->capacity;
+        len = pr->capacity;
+    }
+
+    // 最多分两段写入(环尾 + 环头)
+    size_t first = pr->capacity - pr->head;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(pr->buf + pr->head, samples, first * sizeof(int16_t));
+    memcpy(pr->buf, samples + first, (len - first) * sizeof(int16_t));
+
+    pr->head = (pr->head + len) % pr->capacity;
+    pr->count += len;
+    if (pr->count > pr->capacity) {
+        pr->count = pr->capacity;
+    }
+}
+
+size_t vad_preroll_drain(vad_preroll_t *pr, int16_t *out)
+{
+    size_t count = pr->count;
+    // 最旧样本的位置
+    size_t tail = (pr->head + pr->capacity - count) % pr->capacity;
+
+    size_t first = pr->capacity - tail;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(out, pr->buf + tail, first * sizeof(int16_t));
+    memcpy(out + first, pr->buf, (count - first) * sizeof(int16_t));
+
+    pr->head = 0;
+    pr->count = 0;
+    return count;
+}
@@ -13,8 +13,9 @@
 #include "freertos/FreeRTOS.h"  // FreeRTOS操作系统
 #include "freertos/task.h"
 #include "esp_log.h"    // ESP日志系统
-#include "driver/i2s.h"
+#include "sdkconfig.h"
 
+#if !CONFIG_IDF_TARGET_LINUX
 #include "audio_idf_version.h" // IDF版本信息
 #include "const.h"
 // ESP32网络接口头文件
@@ -23,16 +24,26 @@
 #include "nvs_flash.h"
 // WiFi应用头文件
 #include "app_wifi.h"
+#include "esp_system.h"
+#endif
 #include "esp_timer.h"  // 添加ESP定时器头文件
 #include "funasr_main.h"
+#include "resampler.h"
+#include "vad.h"
+#include "vad_preroll.h"
+#include "audio_queue.h"
+#include "uplink_batch.h"
+#include "aec.h"
+#include "latency_trace.h"
+#include "metrics.h"
+#include "trace_log.h"
+#include "traffic_capture.h"
 
 #include "ollama_main.h"
+#include "voice_pipeline.h"
+#include "audio_hal.h"
+#include "tts_engine.h"
 
-#include "esp_tts.h"                  // 语音合成库头文件
-#include "esp_tts_voice_template.h"   // 语音模板
-
-#include "wav_encoder.h"              // WAV编码器
-#include "esp_partition.h"            // 分区表操作
 #include "esp_idf_version.h"          // ESP-IDF版本信息
 
 /* 定义日志标签 */
@@ -59,60 +70,296 @@ static const char *TAG = "MIC-STREAM";
 #define RESAMPLED_POINTS    (CHUNK_SIZE * TARGET_SAMPLE_RATE / I2S_SAMPLE_RATE)  // 重采样后的点数
 #define RESAMPLED_BUFFER_SIZE (BUFFER_SIZE * TARGET_SAMPLE_RATE / I2S_SAMPLE_RATE + CHUNK_SIZE)  // 增加额外的CHUNK_SIZE作为安全边界
 
-// 定义I2S端口
-#define I2S_MIC_PORT       I2S_NUM_0
-#define I2S_SPK_PORT       I2S_NUM_1
+// 采集->上传队列: 深度(帧, 2的幂)和溢出策略
+#define UPLOAD_QUEUE_DEPTH  16     // 16帧 x 60ms 约1秒
+#define UPLOAD_QUEUE_POLICY AUDIO_QUEUE_DROP_OLDEST
+
+// 每条上传消息最多合并的帧数(另受WebSocket缓冲区大小限制)
+#define UPLOAD_BATCH_MAX_FRAMES 5
+#define UPLOAD_FRAME_MS     (CHUNK_SIZE * 1000 / TARGET_SAMPLE_RATE)
+
+// 上传编码: AUDIO_CODEC_PCM16直连FunASR; AUDIO_CODEC_IMA_ADPCM需经tools/funasr_adpcm_proxy.py解码中转
+#define UPLOAD_CODEC        AUDIO_CODEC_PCM16
+
+// 开机欢迎语
+#define GREETING_TEXT       "你好,我是小豆包"
+
+// 回声抑制模式及统计输出间隔
+#define ECHO_MODE           AEC_MODE_NLMS
+#define ECHO_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+#if CONFIG_IDF_TARGET_LINUX
+// 主机构建没有const.h, 服务地址默认指向本机的模拟服务, 可用环境变量覆盖
+#define FUNASR_URI_ENV      "VOICE_FUNASR_URI"
+#define OLLAMA_URI_ENV      "VOICE_OLLAMA_URI"
+// 设置后把收到的FunASR/Ollama流量抓包到此文件, 供replay/回放
+#define CAPTURE_FILE_ENV    "VOICE_CAPTURE_FILE"
+#define FUNASR_WEBSOCKET_URI host_uri(FUNASR_URI_ENV, "ws://127.0.0.1:10095")
+#define OLLAMA_URI          host_uri(OLLAMA_URI_ENV, "http://127.0.0.1:11434/api/generate")
+
+static const char *host_uri(const char *env, const char *fallback)
+{
+    const char *uri = getenv(env);
+    return uri && *uri ? uri : fallback;
+}
+#endif
 
 // 全局TTS句柄
-static esp_tts_handle_t *g_tts_handle = NULL;
+static tts_engine_t *g_tts_handle = NULL;
+
+// 48k->16k抗混叠抽取器状态, 跨i2s_read块保持滤波历史
+static resampler_t s_resampler;
+
+// 语音活动检测, 只有语音段才上传到FunASR
+static vad_t s_vad;
+static bool s_speaking = false;
+
+// 语音开始前的预录音频, 开始时一次性补发以免丢失字头
+static vad_preroll_t s_preroll;
+static int16_t s_preroll_flush[VAD_PREROLL_SAMPLES];
+
+// 回声抑制, 参考信号来自播放任务写入喇叭的PCM
+static aec_t s_aec;
+
+// 采集任务和上传任务之间的无锁队列, 采集任务永远不会因网络阻塞
+static audio_queue_t s_upload_queue;
+static TaskHandle_t s_upload_task = NULL;
+
+// 上传编码器, 只在上传任务中使用
+static audio_encoder_t s_upload_encoder;
+
+// 自适应上传批量及合并缓冲区
+static uplink_batch_t s_upload_batcher;
+static int16_t s_upload_batch[UPLOAD_BATCH_MAX_FRAMES * CHUNK_SIZE];
+
+// 运行期指标
+METRIC_COUNTER_DEFINE(s_m_mic_short, "mic.read_short");
+METRIC_COUNTER_DEFINE(s_m_mic_errors, "mic.read_errors");
+METRIC_GAUGE_DEFINE(s_m_upload_dropped, "upload.queue_dropped");
+METRIC_GAUGE_DEFINE(s_m_heap_min_free, "heap.min_free");
+
+// FunASR识别结果回调: 在WebSocket任务中执行, 只做入队
+static void asr_result_handler(const char *text)
+{
+    latency_trace_mark(LATENCY_TRACE_ASR_FINAL);
+    voice_pipeline_submit_asr(text);
+}
+
+// 把一帧交给上传任务(不阻塞)
+static void upload_enqueue(audio_frame_type_t type, const int16_t *samples, size_t len)
+{
+    audio_queue_push(&s_upload_queue, type, samples, len);
+    if (s_upload_task) {
+        xTaskNotifyGive(s_upload_task);
+    }
+}
+
+// 播放任务的旁路回调: 把写入喇叭的PCM作为回声参考
+static void echo_reference_tap(const int16_t *pcm, size_t samples)
+{
+    if (pcm) {
+        aec_feed_reference(&s_aec, pcm, samples);
+    } else {
+        aec_discard_reference(&s_aec);
+    }
+}
 
-// Ollama响应回调函数
-static void ollama_response_handler(const char *response)
+// 定期输出回声抑制的CPU开销和效果
+static void echo_log_stats(void)
 {
-    if (!response) {
+    static int64_t last_us = 0;
+    static uint32_t last_blocks = 0;
+    int64_t now = esp_timer_get_time();
+    if (now - last_us < ECHO_STATS_INTERVAL_US) {
         return;
     }
-    
-    ESP_LOGI(TAG, "收到Ollama响应: %s", response);
-    
-    // 如果TTS句柄有效，使用TTS播放响应
-    if (g_tts_handle) {
-        // 分配缓冲区用于播放
-        int16_t *audio_buffer = malloc(8192 * sizeof(int16_t));
-        if (!audio_buffer) {
-            ESP_LOGE(TAG, "无法分配音频缓冲区");
-            return;
+    last_us = now;
+
+    aec_stats_t st;
+    aec_get_stats(&s_aec, &st);
+    if (st.gated_blocks + st.doubletalk_blocks == 0 || st.blocks == last_blocks) {
+        return;
+    }
+    last_blocks = st.blocks;
+    ESP_LOGI(TAG, "回声抑制: 每块(20ms) %lu us, 最大 %lu us, 时延 %lu ms, ERLE %lu.%02lu倍, 门限 %lu块, 双讲 %lu块, 参考欠载 %lu, 溢出 %lu",
+             (unsigned long)st.last_block_us, (unsigned long)st.max_block_us,
+             (unsigned long)(st.delay_samples / 16),
+             (unsigned long)(st.erle_q8 >> 8), (unsigned long)((st.erle_q8 & 0xFF) * 100 / 256),
+             (unsigned long)st.gated_blocks, (unsigned long)st.doubletalk_blocks,
+             (unsigned long)st.ref_underflow, (unsigned long)st.ref_overflow);
+}
+
+// 对一个发送块做VAD, 只上传语音段, 语音开始/结束时插入开始帧/结束帧
+static void vad_gate_send(const int16_t *chunk)
+{
+    bool end_of_speech = false;
+
+    for (int i = 0; i < CHUNK_SIZE; i += VAD_FRAME_SAMPLES) {
+        vad_event_t event = vad_process_frame(&s_vad, chunk + i);
+        if (event == VAD_EVENT_SPEECH_START && !s_speaking) {
+            ESP_LOGI(TAG, "检测到语音开始");
+            upload_enqueue(AUDIO_FRAME_START, NULL, 0);
+            s_speaking = true;
+
+            // 先补发预录音频(连续入队, 由上传任务连续发出), 再发送当前块
+            size_t preroll = vad_preroll_drain(&s_preroll, s_preroll_flush);
+            for (size_t off = 0; off < preroll; off += AUDIO_QUEUE_FRAME_SAMPLES) {
+                size_t n = preroll - off;
+                if (n > AUDIO_QUEUE_FRAME_SAMPLES) {
+                    n = AUDIO_QUEUE_FRAME_SAMPLES;
+                }
+                upload_enqueue(AUDIO_FRAME_AUDIO, s_preroll_flush + off, n);
+            }
+        } else if (event == VAD_EVENT_SPEECH_END) {
+            end_of_speech = true;
         }
-        
-        // 解析中文文本并播放
-        if (esp_tts_parse_chinese(g_tts_handle, response)) {
-            int len[1] = {0};
-            size_t bytes_written = 0;
-            
-            do {
-                short *pcm_data = esp_tts_stream_play(g_tts_handle, len, 3);
-                if (pcm_data && len[0] > 0) {
-                    // 复制数据到缓冲区并通过I2S播放
-                    memcpy(audio_buffer, pcm_data, len[0] * 2);
-                    i2s_write(I2S_SPK_PORT, audio_buffer, len[0] * 2, &bytes_written, 100 / portTICK_PERIOD_MS);
+    }
+
+    if (s_speaking) {
+        upload_enqueue(AUDIO_FRAME_AUDIO, chunk, CHUNK_SIZE);
+    } else {
+        vad_preroll_push(&s_preroll, chunk, CHUNK_SIZE);
+    }
+
+    if (end_of_speech && s_speaking) {
+        ESP_LOGI(TAG, "检测到语音结束");
+        upload_enqueue(AUDIO_FRAME_FINISH, NULL, 0);
+        s_speaking = false;
+    }
+}
+
+// 输出本段语音的上传统计: 编码压缩比, 批量和发送耗时直方图
+static void upload_log_stats(void)
+{
+    static const uint32_t bounds[] = { FUNASR_SEND_HIST_BOUNDS_US };
+    funasr_send_stats_t st;
+    char hist[128];
+    int pos = 0;
+
+    funasr_get_send_stats(&st);
+    for (int i = 0; i < FUNASR_SEND_HIST_BUCKETS && pos < (int)sizeof(hist); i++) {
+        if (i < FUNASR_SEND_HIST_BUCKETS - 1) {
+            pos += snprintf(hist + pos, sizeof(hist) - pos, " <%lums:%lu",
+                            (unsigned long)(bounds[i] / 1000), (unsigned long)st.hist[i]);
+        } else {
+            pos += snprintf(hist + pos, sizeof(hist) - pos, " 更长:%lu", (unsigned long)st.hist[i]);
+        }
+    }
+
+    ESP_LOGI(TAG, "累计上传 %lu 字节, 压缩比 %lu%%, 批量 %lu 帧, 最大发送耗时 %lu us, 失败 %lu",
+             (unsigned long)s_upload_encoder.bytes_out,
+             (unsigned long)((uint64_t)s_upload_encoder.bytes_out * 100 /
+                             ((uint64_t)s_upload_encoder.samples_in * sizeof(int16_t) + 1)),
+             (unsigned long)uplink_batch_target(&s_upload_batcher),
+             (unsigned long)st.max_us, (unsigned long)st.failures);
+    ESP_LOGI(TAG, "发送耗时分布:%s", hist);
+
+    funasr_conn_stats_t conn;
+    funasr_get_conn_stats(&conn);
+    if (conn.disconnects > 0) {
+        ESP_LOGI(TAG, "断线 %lu 次, 补发 %lu 段共 %lu 个样本, 超出补发缓冲 %lu 个样本",
+                 (unsigned long)conn.disconnects, (unsigned long)conn.replays,
+                 (unsigned long)conn.replayed_samples, (unsigned long)conn.replay_overflow_samples);
+    }
+}
+
+// 更新采样型指标并输出全部指标
+static void metrics_log(void)
+{
+    metric_set(&s_m_upload_dropped, audio_queue_dropped(&s_upload_queue));
+#if !CONFIG_IDF_TARGET_LINUX
+    metric_set(&s_m_heap_min_free, esp_get_minimum_free_heap_size());
+#endif
+    metrics_dump();
+}
+
+// 从当前音频帧开始合并后续音频帧作为一条消息发送, 批量由链路负载决定.
+// 遇到控制帧时停止合并, 控制帧留在frame中返回true, 由调用方处理
+static bool upload_send_batch(audio_frame_t *frame)
+{
+    uint32_t target = uplink_batch_target(&s_upload_batcher);
+    const int16_t *data = frame->data;
+    uint32_t frames = 1;
+    size_t samples = frame->samples;
+    bool pending_control = false;
+
+    if (target > 1) {
+        memcpy(s_upload_batch, frame->data, samples * sizeof(int16_t));
+        data = s_upload_batch;
+        while (frames < target) {
+            // 拥塞时积压的帧可以直接取到; 队列空时最多再等一帧的时间
+            if (!audio_queue_pop(&s_upload_queue, frame)) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UPLOAD_FRAME_MS));
+                if (!audio_queue_pop(&s_upload_queue, frame)) {
+                    break;
                 }
-            } while (len[0] > 0);
+            }
+            if (frame->type != AUDIO_FRAME_AUDIO) {
+                pending_control = true;
+                break;
+            }
+            memcpy(s_upload_batch + samples, frame->data, frame->samples * sizeof(int16_t));
+            samples += frame->samples;
+            frames++;
         }
-        
-        // 重置TTS流
-        esp_tts_stream_reset(g_tts_handle);
-        free(audio_buffer);
     }
+
+    int64_t start_us = esp_timer_get_time();
+    funasr_websocket_send_pcm(data, samples);
+    uplink_batch_report(&s_upload_batcher, frames, esp_timer_get_time() - start_us,
+                        audio_queue_count(&s_upload_queue));
+    return pending_control;
 }
 
-// 重采样函数优化
-static void resample_data(int16_t *input, int input_len, int16_t *output, int channels) {
-    int step = (I2S_SAMPLE_RATE / TARGET_SAMPLE_RATE);
-    int j = 0;
-    
-    // 简单抽取重采样
-    for (int i = 0; i < input_len; i += step) {
-        output[j++] = input[i];
+// 音频上传任务: 从队列取帧发送到FunASR, 网络阻塞只影响本任务
+static void upload_task(void *arg)
+{
+    static audio_frame_t frame;
+    bool stream_open = false;
+    bool have_frame = false;        // frame中有一个合并时取出的控制帧待处理
+    uint32_t reported_drops = 0;
+
+    while (1) {
+        if (!have_frame && !audio_queue_pop(&s_upload_queue, &frame)) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            continue;
+        }
+        have_frame = false;
+
+        // 溢出时控制帧也可能被丢弃, 这里根据帧序列补齐开始/结束帧
+        switch (frame.type) {
+            case AUDIO_FRAME_START:
+                if (stream_open) {
+                    funasr_send_finish_frame();
+                }
+                funasr_send_start_frame();
+                stream_open = true;
+                break;
+            case AUDIO_FRAME_AUDIO:
+                if (!stream_open) {
+                    funasr_send_start_frame();
+                    stream_open = true;
+                }
+                have_frame = upload_send_batch(&frame);
+                break;
+            case AUDIO_FRAME_FINISH:
+                if (stream_open) {
+                    // 最后一帧语音已经发出, 新的一段从这里开始计时, 顺带输出已结束的上一段
+                    latency_trace_begin();
+                    funasr_send_finish_frame();
+                    latency_trace_dump(false);
+                    upload_log_stats();
+                    metrics_log();
+                }
+                stream_open = false;
+                break;
+        }
+
+        uint32_t drops = audio_queue_dropped(&s_upload_queue);
+        if (drops != reported_drops) {
+            ESP_LOGW(TAG, "上传队列溢出, 累计丢弃 %lu 帧", (unsigned long)drops);
+            reported_drops = drops;
+        }
     }
 }
 
@@ -127,155 +374,118 @@ static void mic_task(void *arg) {
     // 缓冲区大小根据重采样比例调整,并额外增加一个CHUNK_SIZE作为安全边界
     int16_t *resampled_buffer = (int16_t *)malloc(RESAMPLED_BUFFER_SIZE * sizeof(int16_t));
     
-    // 用于跟踪实际读取的字节数
-    size_t bytes_read = 0;
+    // 用于跟踪实际读取的样本数
+    size_t samples_read = 0;
     
-    // 用于跟踪实际写入的字节数 
-    size_t bytes_written = 0;
+    // 重采样缓冲区中尚未发送的样本数
+    size_t pending_samples = 0;
 
     if (!raw_buffer || !resampled_buffer) {
         ESP_LOGE(TAG, "内存分配失败!");
         goto cleanup;
     }
 
-    // MIC I2S配置
-    i2s_config_t i2s_mic_config = {
-        .mode = I2S_MODE_MASTER | I2S_MODE_RX,
-        .sample_rate = I2S_SAMPLE_RATE,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,  // 单声道
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 8,        // 增加DMA缓冲区数量
-        .dma_buf_len = 1024,       // 增加DMA缓冲区长度
-        .use_apll = true,          // 使用APLL提供更精确的采样率
-        .tx_desc_auto_clear = false,
-        .fixed_mclk = 0
-    };
-
-    // 喇叭I2S配置
-    i2s_config_t i2s_spk_config = {
-        .mode = I2S_MODE_MASTER | I2S_MODE_TX,
-        .sample_rate = 16000,  // 设置为16kHz
-        .bits_per_sample = I2S_BITS_PER_SAMPLE,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 8,
-        .dma_buf_len = 1024,
-        .use_apll = true,  // 使用APLL获得更准确的时钟
-        .tx_desc_auto_clear = true,
-        .fixed_mclk = 0
+    // 麦克风/喇叭配置, 设备上是两路I2S, 主机构建是WAV文件
+    audio_hal_config_t hal_config = {
+        .mic_sample_rate = I2S_SAMPLE_RATE,
+        .spk_sample_rate = VOICE_PIPELINE_SAMPLE_RATE,
+        .mic_bck_io = I2S_MIC_BCK_IO,
+        .mic_ws_io = I2S_MIC_WS_IO,
+        .mic_data_io = I2S_MIC_DATA_IO,
+        .spk_bck_io = I2S_SPK_BCK_IO,
+        .spk_ws_io = I2S_SPK_WS_IO,
+        .spk_data_io = I2S_SPK_DATA_IO,
     };
 
-    // MIC I2S引脚配置
-    i2s_pin_config_t mic_pin_config = {
-        .bck_io_num = I2S_MIC_BCK_IO,
-        .ws_io_num = I2S_MIC_WS_IO,
-        .data_out_num = -1,
-        .data_in_num = I2S_MIC_DATA_IO
-    };
+    // 初始化重采样器和VAD
+    ESP_ERROR_CHECK(resampler_init(&s_resampler));
+    ESP_ERROR_CHECK(vad_init(&s_vad));
+    ESP_ERROR_CHECK(vad_preroll_init(&s_preroll, VAD_PREROLL_SAMPLES));
+    metrics_register(&s_m_mic_short);
+    metrics_register(&s_m_mic_errors);
+    metrics_register(&s_m_upload_dropped);
+    metrics_register(&s_m_heap_min_free);
 
-    // 喇叭I2S引脚配置
-    i2s_pin_config_t spk_pin_config = {
-        .bck_io_num = I2S_SPK_BCK_IO,
-        .ws_io_num = I2S_SPK_WS_IO,
-        .data_out_num = I2S_SPK_DATA_IO,
-        .data_in_num = -1
-    };
-
-    // 初始化I2S
-    ESP_ERROR_CHECK(i2s_driver_install(I2S_MIC_PORT, &i2s_mic_config, 0, NULL));
-    ESP_ERROR_CHECK(i2s_set_pin(I2S_MIC_PORT, &mic_pin_config));
-    ESP_ERROR_CHECK(i2s_driver_install(I2S_SPK_PORT, &i2s_spk_config, 0, NULL));
-    ESP_ERROR_CHECK(i2s_set_pin(I2S_SPK_PORT, &spk_pin_config));
+    // 初始化麦克风和喇叭
+    ESP_ERROR_CHECK(audio_hal_init(&hal_config));
 
+#if !CONFIG_IDF_TARGET_LINUX
     // 等待WiFi连接
     while (!app_wifi_get_connect_status()) {
         ESP_LOGI(TAG, "等待WiFi连接...");
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
+#endif
     /*** 1. 创建语音合成句柄 ***/
-    // 从voice_data分区加载语音数据
-    // 查找名为"voice_data"的数据分区
-    const esp_partition_t* part=esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "voice_data");
-    if (part==NULL) { 
-        printf("Couldn't find voice data partition!\n"); // 找不到voice_data分区时报错
-    } else {
-        printf("voice_data paration size:%ld\n", part->size); // 打印分区大小
-    }
-    void* voicedata; // 用于存储语音数据的指针
-    
-    // 用于存储内存映射句柄
-    esp_partition_mmap_handle_t mmap;
-    // 将分区数据映射到内存中,便于访问
-    esp_err_t err=esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &voicedata, &mmap);
-
-    if (err != ESP_OK) {
-        printf("Couldn't map voice data partition!\n"); // 内存映射失败时报错
-    }
-    // 使用语音模板和映射的语音数据初始化语音配置
-    esp_tts_voice_t *voice = esp_tts_voice_set_init(&esp_tts_voice_template, (int16_t*)voicedata);
-    if (voice == NULL) {
-        ESP_LOGE(TAG, "Failed to init voice set");
+    if (tts_engine_create(&g_tts_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "语音合成初始化失败");
         goto cleanup;
     }
-    
-    // 使用初始化好的语音配置创建TTS句柄
-    g_tts_handle = esp_tts_create(voice);
 
-    /*** 2. 播放欢迎提示语 ***/
-    char *prompt1="你好,我是小豆包";  // 定义欢迎语
-    printf("%s\n", prompt1); // 在控制台打印欢迎语
-    // 解析中文文本
-    if (esp_tts_parse_chinese(g_tts_handle, prompt1)) {
-            int len[1]={0}; // 用于存储生成的音频数据长度
-            do {
-                // 获取合成的PCM音频数据流
-                short *pcm_data = esp_tts_stream_play(g_tts_handle, len, 3);
-                // esp_audio_play(pcm_data, len[0]*2, portMAX_DELAY); // 注释掉的音频播放接口
-                
-                // 将PCM数据复制到原始缓冲区
-                memcpy(raw_buffer, pcm_data, len[0]*2);
-                // 通过I2S接口输出音频数据到扬声器
-                i2s_write(I2S_SPK_PORT, raw_buffer, len[0]*2, &bytes_written, 100 / portTICK_PERIOD_MS);
-            } while(len[0]>0); // 持续处理直到所有音频数据都播放完
-    }
-    // 重置TTS流,为下一次合成做准备
-    esp_tts_stream_reset(g_tts_handle);
-    
     // 初始化Ollama客户端
     ESP_ERROR_CHECK(ollama_init(OLLAMA_URI));
     
-    // 设置Ollama响应回调函数
-    ollama_set_response_callback(ollama_response_handler);
+    // 启动应答流水线(大模型请求/语音合成/播放各自独立运行), 识别结果直接入队
+    aec_init(&s_aec, ECHO_MODE);
+    voice_pipeline_set_playback_tap(echo_reference_tap);
+    ESP_ERROR_CHECK(voice_pipeline_init(g_tts_handle));
+    funasr_set_result_callback(asr_result_handler);
+
+    /*** 2. 播放欢迎提示语 ***/
+    // 与应答走同一条合成/播放路径, 直接写入播放块池, 不再经过raw_buffer中转
+    printf("%s\n", GREETING_TEXT);
+    voice_pipeline_speak(GREETING_TEXT);
+
+    // 上传编码器在连接前设置, 开始帧据此声明音频格式
+    ESP_ERROR_CHECK(audio_encoder_init(&s_upload_encoder, UPLOAD_CODEC));
+    funasr_set_encoder(&s_upload_encoder);
+
+    // 合并后的一条消息编码后不超过WebSocket缓冲区, 避免被拆成多个分片
+    uint32_t batch_max = 1;
+    while (batch_max < UPLOAD_BATCH_MAX_FRAMES &&
+           audio_encoder_max_bytes(&s_upload_encoder, (batch_max + 1) * CHUNK_SIZE) <= FUNASR_WS_BUFFER_SIZE) {
+        batch_max++;
+    }
+    ESP_ERROR_CHECK(uplink_batch_init(&s_upload_batcher, CHUNK_SIZE, TARGET_SAMPLE_RATE, 1, batch_max));
 
     // 初始化WebSocket连接
+    // 开始帧由VAD在检测到语音时发送
     funasr_websocket_init(FUNASR_WEBSOCKET_URI, false);
-    vTaskDelay(pdMS_TO_TICKS(3000));
-    funasr_send_start_frame();
+
+    // 创建上传任务, 采集循环只负责读I2S/重采样/VAD
+    if (audio_queue_init(&s_upload_queue, UPLOAD_QUEUE_DEPTH, UPLOAD_QUEUE_POLICY) != ESP_OK) {
+        ESP_LOGE(TAG, "上传队列分配失败!");
+        goto cleanup;
+    }
+    xTaskCreate(upload_task, "upload_task", 4096, NULL, 4, &s_upload_task);
     // ollama_chat("你好");
     // 主循环
     while (1) {
-        // 读取I2S数据
-        esp_err_t ret = i2s_read(I2S_MIC_PORT, raw_buffer, BUFFER_SIZE * sizeof(int16_t), &bytes_read, 100 / portTICK_PERIOD_MS);
-        
-        if (ret == ESP_OK && bytes_read > 0) {
-            // 直接播放原始音频
-            // i2s_write(I2S_SPK_PORT, raw_buffer, bytes_read, &bytes_written, 100 / portTICK_PERIOD_MS);
-            
-            // 重采样用于发送
-            resample_data(raw_buffer, bytes_read / sizeof(int16_t), resampled_buffer, I2S_CHANNEL_NUM);
-            
-            // 计算实际重采样后的样本数
-            size_t samples = (bytes_read / sizeof(int16_t)) * TARGET_SAMPLE_RATE / I2S_SAMPLE_RATE;
-            size_t remaining_samples = samples;
+        // 读取麦克风数据
+        esp_err_t ret = audio_hal_mic_read(raw_buffer, BUFFER_SIZE, &samples_read, 100 / portTICK_PERIOD_MS);
+        if (ret == ESP_ERR_NOT_FOUND) {
+            ESP_LOGI(TAG, "麦克风输入结束");
+            break;
+        }
+
+        if (ret != ESP_OK) {
+            metric_inc(&s_m_mic_errors);
+        } else if (samples_read < BUFFER_SIZE) {
+            metric_inc(&s_m_mic_short);
+        }
+
+        if (ret == ESP_OK && samples_read > 0) {
+            // 抗混叠滤波并抽取到16kHz, 追加到未发送数据之后
+            size_t samples = resampler_process(&s_resampler, raw_buffer, samples_read,
+                                               resampled_buffer + pending_samples);
+            // 先去除喇叭回声, 避免设备听到自己的播报
+            aec_process(&s_aec, resampled_buffer + pending_samples, samples);
+            size_t remaining_samples = pending_samples + samples;
             size_t offset = 0;
             
-            // 当累积了足够的数据时发送
+            // 当累积了足够的数据时经过VAD门控入队
             while (remaining_samples >= CHUNK_SIZE) {
-                // 发送到服务器
-                funasr_websocket_send_audio((const uint8_t *)(resampled_buffer + offset), CHUNK_SIZE * sizeof(int16_t));
+                vad_gate_send(resampled_buffer + offset);
                 
                 offset += CHUNK_SIZE;
                 remaining_samples -= CHUNK_SIZE;
@@ -285,6 +495,8 @@ static void mic_task(void *arg) {
             if (remaining_samples > 0 && offset > 0) {
                 memmove(resampled_buffer, resampled_buffer + offset, remaining_samples * sizeof(int16_t));
             }
+            pending_samples = remaining_samples;
+            echo_log_stats();
         }
 
         // 让出一些CPU时间
@@ -295,9 +507,16 @@ cleanup:
     // 清理资源
     if (raw_buffer) free(raw_buffer);
     if (resampled_buffer) free(resampled_buffer);
-    i2s_driver_uninstall(I2S_MIC_PORT);
-    i2s_driver_uninstall(I2S_SPK_PORT);
     funasr_websocket_cleanup();
+    audio_hal_deinit();
+    traffic_capture_close();
+    trace_log_flush();
+    latency_trace_dump(true);
+    metrics_log();
+#if CONFIG_IDF_TARGET_LINUX
+    // 主机构建: 输入跑完即退出, 输出文件已在audio_hal_deinit中补全
+    exit(0);
+#endif
     vTaskDelete(NULL);
 }
 
@@ -306,7 +525,17 @@ void app_main()
     // 设置日志级别
     esp_log_level_set("*", ESP_LOG_INFO);
     esp_log_level_set(TAG, ESP_LOG_INFO);
+    // 热路径日志由低优先级任务输出
+    ESP_ERROR_CHECK(trace_log_init(1));
+
+#if CONFIG_IDF_TARGET_LINUX
+    const char *capture = getenv(CAPTURE_FILE_ENV);
+    if (capture && *capture) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(traffic_capture_open(capture));
+    }
+#endif
 
+#if !CONFIG_IDF_TARGET_LINUX
     // 初始化NVS Flash
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -321,6 +550,7 @@ void app_main()
     // 初始化WiFi
     app_wifi_init();
     app_wifi_connect(WIFI_SSID, WIFI_PASSWORD);
+#endif
 
     // 创建音频采集任务，增加堆栈大小
     xTaskCreate(mic_task, "mic_task", 8192 * 2, NULL, 5, NULL);
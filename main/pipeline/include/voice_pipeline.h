@@ -0,0 +1,87 @@
+#ifndef VOICE_PIPELINE_H
+#define VOICE_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "tts_engine.h"
+
+/* 各级队列中单条文本的最大字节数(含结尾'\0') */
+#define VOICE_PIPELINE_TEXT_MAX     512
+
+/* 各级队列深度(播放队列的块大小和深度见pcm_sink.h) */
+#define VOICE_PIPELINE_ASR_DEPTH    2
+#define VOICE_PIPELINE_TTS_DEPTH    4
+
+/* 合成输出/喇叭采样率 */
+#define VOICE_PIPELINE_SAMPLE_RATE  16000
+
+/* 新应答开始播放前预存的块数及最长等待时间 */
+#define VOICE_PIPELINE_PREFILL_BLOCKS   2
+#define VOICE_PIPELINE_PREFILL_MS       60
+
+/* 合成任务和播放任务所在的核 */
+#define VOICE_PIPELINE_TTS_CORE         1
+#define VOICE_PIPELINE_PLAYBACK_CORE    0
+
+/* 短语级PCM缓存的字节预算(存放在PSRAM, 1MB约32秒语音) */
+#define VOICE_PIPELINE_TTS_CACHE_BYTES  (1024 * 1024)
+
+/**
+ * @brief 播放统计
+ */
+typedef struct {
+    uint32_t blocks;        // 写入喇叭的PCM块数
+    uint32_t underruns;     // 合成没跟上导致DMA播空的次数
+    uint32_t underrun_ms;   // 欠载造成的断流总时长
+} voice_pipeline_stats_t;
+
+/**
+ * @brief 播放旁路回调: 每块PCM写入喇叭后调用, pcm为NULL表示已写入的音频被清空
+ */
+typedef void (*voice_pipeline_playback_tap_t)(const int16_t *pcm, size_t samples);
+
+/**
+ * @brief 初始化应答流水线并创建各级任务
+ *
+ * 识别结果 -> 大模型请求任务 -> 语音合成任务 -> 播放任务,
+ * 各级之间通过有界队列连接, 可以同时运行.
+ *
+ * 播放经audio_hal写入喇叭, 调用前需完成audio_hal_init.
+ *
+ * @param tts 已创建的合成引擎
+ * @return esp_err_t
+ */
+esp_err_t voice_pipeline_init(tts_engine_t *tts);
+
+/**
+ * @brief 提交一条识别结果(不阻塞, 可在WebSocket任务中调用)
+ *
+ * 空白结果(只有空格或全角空格)直接丢弃, 不打断当前应答.
+ *
+ * @param text 识别文本
+ * @return esp_err_t ESP_ERR_INVALID_ARG: 空白结果; ESP_ERR_TIMEOUT: 队列已满, 本条被丢弃
+ */
+esp_err_t voice_pipeline_submit_asr(const char *text);
+
+/**
+ * @brief 提交一段需要播报的文本(队列满时阻塞, 形成背压)
+ *
+ * @param text 播报文本
+ * @return esp_err_t
+ */
+esp_err_t voice_pipeline_speak(const char *text);
+
+/**
+ * @brief 设置播放旁路回调(回声消除的参考信号), 在voice_pipeline_init之前调用
+ *
+ * @param tap 回调函数, NULL表示取消
+ */
+void voice_pipeline_set_playback_tap(voice_pipeline_playback_tap_t tap);
+
+/**
+ * @brief 获取播放统计
+ */
+void voice_pipeline_get_stats(voice_pipeline_stats_t *stats);
+
+#endif /* VOICE_PIPELINE_H */
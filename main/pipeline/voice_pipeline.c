@@ -0,0 +1,455 @@
+/*
+ * 语音应答流水线
+ *
+ * 原先WebSocket事件处理函数中同步调用ollama_chat(), HTTP回调里再
+ * 同步做语音合成和阻塞的i2s_write, 播报期间WebSocket任务完全停滞.
+ * 现在拆成三个任务:
+ *   llm_task:      取识别结果, 请求大模型, 流式结果进入合成队列
+ *   tts_task:      取文本合成PCM, 切成固定大小的块进入播放队列
+ *   playback_task: 取PCM块写入喇叭(audio_hal)
+ * 合成任务和播放任务分别固定在两个核上: 播放队列加上I2S DMA构成
+ * 约1秒的缓冲, 播放第N段时第N+1段已在另一个核上合成, 段与段之间无缝衔接.
+ * WebSocket任务只负责解析和入队.
+ *
+ * 打断(barge-in): 每条识别结果都会使取消源的代数加一, 队列中的每一项
+ * 都带有产生时的代数. 各级任务发现代数过期就丢弃当前工作:
+ * HTTP请求被中断, 合成循环退出, 已进入DMA的音频被清零.
+ */
+
+#include "voice_pipeline.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ollama_main.h"
+#include "cancel_token.h"
+#include "tts_cache.h"
+#include "pcm_sink.h"
+#include "audio_hal.h"
+#include "latency_trace.h"
+#include "metrics.h"
+#include "trace_log.h"
+
+static const char *TAG = "PIPELINE";
+
+typedef struct {
+    uint32_t epoch;
+    char text[VOICE_PIPELINE_TEXT_MAX];
+} pipeline_text_t;
+
+static tts_engine_t *s_tts = NULL;
+
+static QueueHandle_t s_asr_queue = NULL;
+static QueueHandle_t s_tts_queue = NULL;
+
+// 应答的取消源; 新的识别结果到达时取消当前应答
+static cancel_source_t s_reply_cancel;
+
+// llm_task当前处理的识别结果的代数, 大模型回调产生的文本沿用它
+static uint32_t s_llm_epoch = 0;
+
+// 最近一次打断的时间, 用于统计打断延迟
+static volatile int64_t s_cancel_us = 0;
+
+// 短语级PCM缓存, 只在tts_task中访问
+static tts_cache_t s_tts_cache;
+static bool s_tts_cache_ready = false;
+
+// 合成任务手上是否有尚未送入播放队列的文本, 用于区分欠载和正常的停顿
+static volatile bool s_tts_busy = false;
+
+// 播放统计
+static voice_pipeline_stats_t s_stats;
+
+// 运行期指标
+METRIC_COUNTER_DEFINE(s_m_underruns, "playback.underruns");
+METRIC_COUNTER_DEFINE(s_m_underrun_ms, "playback.underrun_ms");
+METRIC_COUNTER_DEFINE(s_m_cache_hits, "tts.cache_hits");
+METRIC_COUNTER_DEFINE(s_m_cache_misses, "tts.cache_misses");
+METRIC_HISTOGRAM_DEFINE(s_m_barge_in_ms, "playback.barge_in_ms", 20, 40, 80, 160, 320);
+
+// 播放旁路(回声消除参考信号)
+static voice_pipeline_playback_tap_t s_playback_tap = NULL;
+
+static inline bool epoch_is_current(uint32_t epoch)
+{
+    return epoch == cancel_source_epoch(&s_reply_cancel);
+}
+
+// 按UTF-8字符边界截断复制, 避免把半个汉字送进合成
+static void copy_text(pipeline_text_t *item, const char *text)
+{
+    size_t len = strlen(text);
+    if (len >= VOICE_PIPELINE_TEXT_MAX) {
+        len = VOICE_PIPELINE_TEXT_MAX - 1;
+        while (len > 0 && ((unsigned char)text[len] & 0xC0) == 0x80) {
+            len--;
+        }
+        ESP_LOGW(TAG, "文本过长, 截断为 %u 字节", (unsigned)len);
+    }
+    memcpy(item->text, text, len);
+    item->text[len] = '\0';
+}
+
+// 空白识别结果(咳嗽, 噪声等): ASCII空白和全角空格
+static bool text_is_blank(const char *text)
+{
+    while (*text) {
+        if (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') {
+            text++;
+        } else if (!strncmp(text, "\xE3\x80\x80", 3)) {
+            text += 3;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t voice_pipeline_submit_asr(const char *text)
+{
+    static pipeline_text_t item;  // 只在WebSocket任务中使用
+
+    if (!s_asr_queue || !text) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // 没有内容的结果不打断正在进行的应答
+    if (text_is_blank(text)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 新的一句话打断正在进行的应答, 排队中的旧工作全部作废
+    s_cancel_us = esp_timer_get_time();
+    item.epoch = cancel_source_cancel(&s_reply_cancel);
+    xQueueReset(s_asr_queue);
+    xQueueReset(s_tts_queue);
+    pcm_sink_flush();
+
+    copy_text(&item, text);
+    if (xQueueSend(s_asr_queue, &item, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "识别结果队列已满, 丢弃: %s", text);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+// 以指定代数提交播报文本, 队列满时等待(背压)
+static esp_err_t enqueue_speech(const char *text, uint32_t epoch)
+{
+    pipeline_text_t item;
+
+    if (!s_tts_queue || !text) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!epoch_is_current(epoch)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    item.epoch = epoch;
+    copy_text(&item, text);
+    xQueueSend(s_tts_queue, &item, portMAX_DELAY);
+    return ESP_OK;
+}
+
+esp_err_t voice_pipeline_speak(const char *text)
+{
+    return enqueue_speech(text, cancel_source_epoch(&s_reply_cancel));
+}
+
+// Ollama响应回调: 在llm_task中执行, 只负责把文本交给合成任务
+static void ollama_response_handler(const char *response)
+{
+    if (!response) {
+        return;
+    }
+    TRACE_LOGD_STR(TAG, "收到Ollama响应: %s", response, strlen(response));
+    enqueue_speech(response, s_llm_epoch);
+}
+
+// 大模型请求任务
+static void llm_task(void *arg)
+{
+    static pipeline_text_t item;
+
+    // 先预热模型并建立长连接, 第一个问题不再承担建连和加载模型的延迟
+    ollama_warmup();
+
+    while (1) {
+        if (xQueueReceive(s_asr_queue, &item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (!epoch_is_current(item.epoch)) {
+            continue;
+        }
+        s_llm_epoch = item.epoch;
+        cancel_token_t token = cancel_token_make(&s_reply_cancel, item.epoch);
+        ollama_chat_cancellable(item.text, &token);
+    }
+}
+
+// 提交合成任务手上不足一块的尾部
+static void flush_open_block(int64_t *first_us)
+{
+    if (pcm_sink_write_end() && *first_us == 0) {
+        *first_us = esp_timer_get_time();
+    }
+}
+
+// 把PCM写入播放块池, 没有空块时等待播放; 被打断返回false
+static bool send_pcm(const int16_t *pcm, size_t len, uint32_t epoch, int64_t *first_us)
+{
+    cancel_token_t token = cancel_token_make(&s_reply_cancel, epoch);
+
+    if (len > 0) {
+        latency_trace_mark(LATENCY_TRACE_TTS_FIRST_SAMPLE);
+    }
+
+    int submitted = pcm_sink_write(pcm, len, &token);
+    if (submitted > 0 && *first_us == 0) {
+        *first_us = esp_timer_get_time();
+    }
+    return submitted >= 0;
+}
+
+// 合成一条文本并送入播放队列, 完整合成的结果写入缓存
+static void synthesize(const pipeline_text_t *item, int64_t *first_us)
+{
+    bool complete = true;
+
+    if (s_tts_cache_ready) {
+        tts_cache_begin(&s_tts_cache, item->text);
+    }
+    if (tts_engine_begin(s_tts, item->text)) {
+        const int16_t *pcm_data;
+        size_t len = 0;
+        do {
+            // 每合成一段检查一次是否被打断
+            if (!epoch_is_current(item->epoch)) {
+                ESP_LOGI(TAG, "合成被打断");
+                complete = false;
+                break;
+            }
+            pcm_data = tts_engine_next(s_tts, &len);
+            if (pcm_data) {
+                if (s_tts_cache_ready) {
+                    tts_cache_append(&s_tts_cache, pcm_data, len);
+                }
+                if (!send_pcm(pcm_data, len, item->epoch, first_us)) {
+                    complete = false;
+                    break;
+                }
+            }
+        } while (pcm_data);
+    } else {
+        complete = false;
+    }
+
+    if (s_tts_cache_ready) {
+        if (complete) {
+            tts_cache_commit(&s_tts_cache);
+        } else {
+            tts_cache_abort(&s_tts_cache);
+        }
+    }
+
+    // 重置TTS流
+    tts_engine_reset(s_tts);
+}
+
+// 语音合成任务
+static void tts_task(void *arg)
+{
+    static pipeline_text_t item;
+
+    while (1) {
+        if (xQueueReceive(s_tts_queue, &item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (!epoch_is_current(item.epoch)) {
+            continue;
+        }
+
+        s_tts_busy = true;
+        int64_t start_us = esp_timer_get_time();
+        int64_t first_us = 0;
+        const int16_t *cached = NULL;
+        size_t cached_samples = 0;
+        bool hit = s_tts_cache_ready &&
+                   tts_cache_lookup(&s_tts_cache, item.text, &cached, &cached_samples);
+
+        metric_inc(hit ? &s_m_cache_hits : &s_m_cache_misses);
+        if (hit) {
+            send_pcm(cached, cached_samples, item.epoch, &first_us);
+        } else {
+            synthesize(&item, &first_us);
+        }
+        flush_open_block(&first_us);
+
+        if (first_us != 0 && s_tts_cache_ready) {
+            tts_cache_stats_t st;
+            tts_cache_get_stats(&s_tts_cache, &st);
+            ESP_LOGI(TAG, "首包 %lld us (%s), 缓存命中 %lu/未命中 %lu, %u条 %u字节",
+                     (long long)(first_us - start_us), hit ? "命中" : "合成",
+                     (unsigned long)st.hits, (unsigned long)st.misses,
+                     (unsigned)st.entries, (unsigned)st.bytes_used);
+        }
+        s_tts_busy = false;
+    }
+}
+
+// 是否还有已知要播放但尚未到达播放队列的音频
+static inline bool audio_owed(void)
+{
+    return s_tts_busy || uxQueueMessagesWaiting(s_tts_queue) > 0;
+}
+
+// 新应答开始播放前等待播放队列预存几块, 避免开头刚播就断流
+static void prefill(uint32_t epoch)
+{
+    int64_t deadline = esp_timer_get_time() + VOICE_PIPELINE_PREFILL_MS * 1000;
+
+    while (pcm_sink_pending() + 1 < VOICE_PIPELINE_PREFILL_BLOCKS &&
+           audio_owed() && epoch_is_current(epoch) &&
+           esp_timer_get_time() < deadline) {
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+}
+
+// 播放任务
+static void playback_task(void *arg)
+{
+    size_t written = 0;
+    bool playing = false;           // DMA中是否可能还有未播完的音频
+    uint32_t playing_epoch = 0;
+    int64_t drained_us = 0;         // 按已写入的样本数推算DMA播空的时刻
+    bool in_gap = false;            // 是否处于欠载造成的断流中
+
+    while (1) {
+        // 空闲时也定期醒来, 以便及时发现打断并清空DMA
+        pcm_block_t *block = pcm_sink_receive(pdMS_TO_TICKS(20));
+        int64_t now = esp_timer_get_time();
+
+        // 正在播放的应答被打断: 清零DMA中尚未播出的音频
+        if (playing && !epoch_is_current(playing_epoch)) {
+            audio_hal_spk_clear();
+            if (s_playback_tap) {
+                s_playback_tap(NULL, 0);
+            }
+            uint32_t latency_ms = (uint32_t)((now - s_cancel_us) / 1000);
+            metric_observe(&s_m_barge_in_ms, latency_ms);
+            ESP_LOGI(TAG, "播放被打断, 延迟 %lu ms", (unsigned long)latency_ms);
+            playing = false;
+            in_gap = false;
+        }
+
+        if (!block) {
+            if (playing && now > drained_us) {
+                if (audio_owed()) {
+                    // DMA已播空而合成还没跟上: 记一次欠载
+                    if (!in_gap) {
+                        in_gap = true;
+                        s_stats.underruns++;
+                        metric_inc(&s_m_underruns);
+                    }
+                } else {
+                    playing = false;
+                    in_gap = false;
+                }
+            }
+            continue;
+        }
+        if (!epoch_is_current(block->epoch)) {
+            pcm_sink_release(block);
+            continue;
+        }
+
+        if (!playing || block->epoch != playing_epoch) {
+            prefill(block->epoch);
+            now = esp_timer_get_time();
+            drained_us = now;
+            in_gap = false;
+        } else if (in_gap) {
+            uint32_t gap_ms = (uint32_t)((now - drained_us) / 1000);
+            s_stats.underrun_ms += gap_ms;
+            metric_add(&s_m_underrun_ms, gap_ms);
+            in_gap = false;
+            ESP_LOGW(TAG, "播放欠载 %lu ms (累计 %lu 次)", (unsigned long)gap_ms, (unsigned long)s_stats.underruns);
+        }
+
+        playing = true;
+        playing_epoch = block->epoch;
+        audio_hal_spk_write(block->data, block->samples, &written, portMAX_DELAY);
+        latency_trace_mark(LATENCY_TRACE_PLAYBACK_START);
+        if (drained_us < now) {
+            drained_us = now;
+        }
+        drained_us += (int64_t)written * 1000000 / VOICE_PIPELINE_SAMPLE_RATE;
+        s_stats.blocks++;
+        if (s_playback_tap) {
+            s_playback_tap(block->data, written);
+        }
+        pcm_sink_release(block);
+    }
+}
+
+void voice_pipeline_get_stats(voice_pipeline_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_stats;
+    }
+}
+
+void voice_pipeline_set_playback_tap(voice_pipeline_playback_tap_t tap)
+{
+    s_playback_tap = tap;
+}
+
+// 按配置固定到核上; 核数不够(单核芯片或主机构建)时不指定核
+static void create_pinned_task(TaskFunction_t fn, const char *name, uint32_t stack,
+                               UBaseType_t prio, BaseType_t core)
+{
+    if (core >= portNUM_PROCESSORS) {
+        core = tskNO_AFFINITY;
+    }
+    xTaskCreatePinnedToCore(fn, name, stack, NULL, prio, NULL, core);
+}
+
+esp_err_t voice_pipeline_init(tts_engine_t *tts)
+{
+    if (!tts) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_tts = tts;
+    cancel_source_init(&s_reply_cancel);
+    metrics_register(&s_m_underruns);
+    metrics_register(&s_m_underrun_ms);
+    metrics_register(&s_m_cache_hits);
+    metrics_register(&s_m_cache_misses);
+    metrics_register(&s_m_barge_in_ms);
+
+    s_asr_queue = xQueueCreate(VOICE_PIPELINE_ASR_DEPTH, sizeof(pipeline_text_t));
+    s_tts_queue = xQueueCreate(VOICE_PIPELINE_TTS_DEPTH, sizeof(pipeline_text_t));
+    if (!s_asr_queue || !s_tts_queue || pcm_sink_init() != ESP_OK) {
+        ESP_LOGE(TAG, "队列创建失败");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 没有PSRAM或分配失败不影响播报, 只是每次都重新合成
+    esp_err_t cache_err = tts_cache_init(&s_tts_cache, VOICE_PIPELINE_TTS_CACHE_BYTES);
+    s_tts_cache_ready = cache_err == ESP_OK;
+    if (!s_tts_cache_ready) {
+        ESP_LOGW(TAG, "TTS缓存不可用(%s), 不使用缓存", esp_err_to_name(cache_err));
+    }
+
+    ollama_set_response_callback(ollama_response_handler);
+
+    // 播放优先级最高, 保证DMA不断流; 大模型请求最低
+    // 合成和播放固定在不同的核上, 合成下一段时不影响当前段写入DMA
+    create_pinned_task(playback_task, "playback_task", 3072, 6, VOICE_PIPELINE_PLAYBACK_CORE);
+    create_pinned_task(tts_task, "tts_task", 8192, 4, VOICE_PIPELINE_TTS_CORE);
+    xTaskCreate(llm_task, "llm_task", 8192, NULL, 3, NULL);
+
+    return ESP_OK;
+}
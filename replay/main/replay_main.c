@@ -0,0 +1,303 @@
+/*
+ * 抓包回放
+ *
+ * 读入主机构建用VOICE_CAPTURE_FILE抓到的流量, 把FunASR的每条WebSocket消息和
+ * Ollama的每个HTTP事件依次交给客户端的事件处理函数, 统计处理耗时和吞吐.
+ * 网络和服务器都不参与, 结果只取决于抓包内容, 可用于比较不同提交的解析性能,
+ * 并用输出的识别结果/子句检查解析行为是否变化.
+ *
+ * 环境变量:
+ *   VOICE_REPLAY_FILE   抓包文件(必需)
+ *   VOICE_REPLAY_SPEED  fast(默认, 全速) 或 real(按抓包时刻)
+ *   VOICE_REPLAY_LOOPS  全速回放的遍数, 默认1
+ *   VOICE_REPLAY_PRINT  为1时输出每条识别结果(ASR)和送出的子句(LLM)
+ *   VOICE_REPLAY_CHUNKER  分句参数"首块最小字节,最小字节,最大字节", 默认OLLAMA_CHUNKER_DEFAULT_CONFIG()
+ *
+ * 统计每通道输出一行:
+ *   REPLAY <通道> events=<事件数> bytes=<字节数> busy_us=<处理耗时> ns_per_event=<> mb_per_s=<> outputs=<回调次数>
+ *
+ * 另外按抓包时刻统计每次Ollama回复的首段时间(第一个子句送去合成的时刻), 与回放速度无关:
+ *   REPLAY ttfc responses=<回复数> first_token_ms=<平均> first_chunk_ms=<平均> first_chunk_p50_ms=<>
+ *          first_chunk_max_ms=<> reply_ms=<平均>
+ * 时刻都从请求发出算起; reply_ms是整个回复结束的时刻, 即只在回复结束时才送去合成的情况.
+ * VOICE_REPLAY_PRINT=1时每次回复另有一行 TTFC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "funasr_main.h"
+#include "ollama_main.h"
+#include "traffic_capture.h"
+
+static const char *TAG = "REPLAY";
+
+#define REPLAY_FILE_ENV     "VOICE_REPLAY_FILE"
+#define REPLAY_SPEED_ENV    "VOICE_REPLAY_SPEED"
+#define REPLAY_LOOPS_ENV    "VOICE_REPLAY_LOOPS"
+#define REPLAY_PRINT_ENV    "VOICE_REPLAY_PRINT"
+#define REPLAY_CHUNKER_ENV  "VOICE_REPLAY_CHUNKER"
+
+/* 统计首段时间的回复数上限 */
+#define REPLAY_MAX_RESPONSES    1024
+
+typedef struct {
+    const char *name;
+    uint32_t events;
+    uint64_t bytes;
+    int64_t busy_us;
+    uint32_t outputs;
+} replay_stats_t;
+
+static replay_stats_t s_stats[2] = {
+    [TRAFFIC_CAPTURE_FUNASR] = { .name = "funasr" },
+    [TRAFFIC_CAPTURE_OLLAMA] = { .name = "ollama" },
+};
+static bool s_print;
+
+/* 首段时间统计, 只在第一遍回放时记录 */
+typedef struct {
+    int64_t first_token_us;
+    int64_t first_chunk_us;
+    int64_t reply_us;
+} replay_ttfc_t;
+
+static replay_ttfc_t s_ttfc[REPLAY_MAX_RESPONSES];
+static size_t s_responses;
+static bool s_measure;
+static int64_t s_entry_time_us;     // 正在回放的记录的抓包时刻
+static int64_t s_request_time_us;   // 当前回复的请求时刻, -1表示不在回复中
+
+static void asr_result_handler(const char *text)
+{
+    s_stats[TRAFFIC_CAPTURE_FUNASR].outputs++;
+    if (s_print) {
+        printf("ASR %s\n", text);
+    }
+}
+
+static void llm_response_handler(const char *text)
+{
+    s_stats[TRAFFIC_CAPTURE_OLLAMA].outputs++;
+    if (s_measure && s_request_time_us >= 0 && s_responses > 0) {
+        replay_ttfc_t *t = &s_ttfc[s_responses - 1];
+        if (t->first_chunk_us < 0) {
+            t->first_chunk_us = s_entry_time_us - s_request_time_us;
+        }
+    }
+    if (s_print) {
+        printf("LLM %s\n", text);
+    }
+}
+
+// 按抓包时刻记录一次回复的首个token, 首段和结束时刻
+static void track_ollama_event(const traffic_capture_header_t *h)
+{
+    if (h->event == TRAFFIC_CAPTURE_REQUEST) {
+        s_request_time_us = -1;
+        if (s_responses < REPLAY_MAX_RESPONSES) {
+            s_ttfc[s_responses++] = (replay_ttfc_t) { -1, -1, -1 };
+            s_request_time_us = h->time_us;
+        }
+        return;
+    }
+    if (s_request_time_us < 0) {
+        return;
+    }
+    replay_ttfc_t *t = &s_ttfc[s_responses - 1];
+    if (h->event == HTTP_EVENT_ON_DATA && t->first_token_us < 0) {
+        t->first_token_us = h->time_us - s_request_time_us;
+    }
+    if (h->event == HTTP_EVENT_ON_FINISH || h->event == HTTP_EVENT_DISCONNECTED) {
+        t->reply_us = h->time_us - s_request_time_us;
+        s_request_time_us = -1;
+    }
+}
+
+static void replay_entry(const traffic_capture_entry_t *e)
+{
+    const traffic_capture_header_t *h = &e->hdr;
+    replay_stats_t *st;
+    int64_t start;
+
+    s_entry_time_us = h->time_us;
+
+    switch (h->channel) {
+    case TRAFFIC_CAPTURE_FUNASR:
+        st = &s_stats[TRAFFIC_CAPTURE_FUNASR];
+        start = esp_timer_get_time();
+        funasr_replay_event(h->event, h->op_code, e->data, (int)h->len);
+        break;
+    case TRAFFIC_CAPTURE_OLLAMA:
+        st = &s_stats[TRAFFIC_CAPTURE_OLLAMA];
+        start = esp_timer_get_time();
+        if (h->event == TRAFFIC_CAPTURE_REQUEST) {
+            ollama_replay_begin();
+        } else {
+            ollama_replay_event(h->event, h->len ? e->data : NULL, (int)h->len);
+            // 请求在完成或断开时返回, 整理本轮的上下文
+            if (h->event == HTTP_EVENT_ON_FINISH || h->event == HTTP_EVENT_DISCONNECTED) {
+                ollama_replay_end();
+            }
+        }
+        if (s_measure) {
+            // 在处理之后记录, 结束事件中送出的剩余文本仍算在本次回复内
+            track_ollama_event(h);
+        }
+        break;
+    default:
+        return;
+    }
+    st->busy_us += esp_timer_get_time() - start;
+    st->events++;
+    st->bytes += h->len;
+}
+
+// 按抓包时刻回放, 处理本身的耗时不会累积成漂移
+static void replay_real_time(const traffic_capture_entry_t *entries, size_t count)
+{
+    int64_t base = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        int64_t wait_us = base + entries[i].hdr.time_us - esp_timer_get_time();
+        if (wait_us >= 1000) {
+            vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+        }
+        replay_entry(&entries[i]);
+    }
+}
+
+static void print_stats(int64_t wall_us)
+{
+    for (int c = 0; c < 2; c++) {
+        const replay_stats_t *st = &s_stats[c];
+        double ns = st->events ? st->busy_us * 1000.0 / st->events : 0;
+        double mbps = st->busy_us ? st->bytes / (double)st->busy_us : 0;
+        printf("REPLAY %s events=%lu bytes=%llu busy_us=%lld ns_per_event=%.0f mb_per_s=%.2f outputs=%lu\n",
+               st->name, (unsigned long)st->events, (unsigned long long)st->bytes,
+               (long long)st->busy_us, ns, mbps, (unsigned long)st->outputs);
+    }
+    printf("REPLAY wall_us=%lld\n", (long long)wall_us);
+}
+
+static int compare_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// 只统计有首段的回复(被取消或没有文本的回复不计入)
+static void print_ttfc(bool verbose)
+{
+    static int64_t chunks[REPLAY_MAX_RESPONSES];
+    int64_t token_sum = 0;
+    int64_t chunk_sum = 0;
+    int64_t reply_sum = 0;
+    size_t n = 0;
+
+    for (size_t i = 0; i < s_responses; i++) {
+        const replay_ttfc_t *t = &s_ttfc[i];
+        if (verbose) {
+            printf("TTFC %u first_token_ms=%.1f first_chunk_ms=%.1f reply_ms=%.1f\n", (unsigned)i,
+                   t->first_token_us / 1000.0, t->first_chunk_us / 1000.0, t->reply_us / 1000.0);
+        }
+        if (t->first_token_us < 0 || t->first_chunk_us < 0 || t->reply_us < 0) {
+            continue;
+        }
+        token_sum += t->first_token_us;
+        chunk_sum += t->first_chunk_us;
+        reply_sum += t->reply_us;
+        chunks[n++] = t->first_chunk_us;
+    }
+    if (n == 0) {
+        return;
+    }
+    qsort(chunks, n, sizeof(chunks[0]), compare_i64);
+    printf("REPLAY ttfc responses=%u first_token_ms=%.1f first_chunk_ms=%.1f first_chunk_p50_ms=%.1f "
+           "first_chunk_max_ms=%.1f reply_ms=%.1f\n",
+           (unsigned)n, token_sum / 1000.0 / n, chunk_sum / 1000.0 / n, chunks[n / 2] / 1000.0,
+           chunks[n - 1] / 1000.0, reply_sum / 1000.0 / n);
+}
+
+// 解析"首块最小字节,最小字节,最大字节"
+static bool parse_chunker(const char *spec, ollama_chunker_config_t *cfg)
+{
+    unsigned first_min, min, max;
+    if (sscanf(spec, "%u,%u,%u", &first_min, &min, &max) != 3 || max == 0) {
+        return false;
+    }
+    cfg->first_min_bytes = first_min;
+    cfg->min_bytes = min;
+    cfg->max_bytes = max;
+    return true;
+}
+
+void app_main(void)
+{
+    const char *path = getenv(REPLAY_FILE_ENV);
+    const char *speed = getenv(REPLAY_SPEED_ENV);
+    const char *loops_env = getenv(REPLAY_LOOPS_ENV);
+    const char *print = getenv(REPLAY_PRINT_ENV);
+    const char *chunker = getenv(REPLAY_CHUNKER_ENV);
+    bool real_time = speed && strcmp(speed, "real") == 0;
+    int loops = loops_env ? atoi(loops_env) : 1;
+    s_print = print && strcmp(print, "1") == 0;
+    bool verbose = s_print;
+
+    if (!path) {
+        ESP_LOGE(TAG, "未设置%s", REPLAY_FILE_ENV);
+        exit(2);
+    }
+    if (loops < 1 || real_time) {
+        loops = 1;
+    }
+
+    traffic_capture_entry_t *entries;
+    size_t count;
+    esp_err_t err = traffic_capture_load(path, &entries, &count);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "读取抓包文件 %s 失败: %s", path, esp_err_to_name(err));
+        exit(2);
+    }
+    ESP_LOGI(TAG, "%u 条记录, %s回放 %d 遍", (unsigned)count, real_time ? "按原始节奏" : "全速", loops);
+
+    // 只用来分配缓冲区, 不会连接服务器
+    ESP_ERROR_CHECK(ollama_init("http://127.0.0.1/api/generate"));
+    funasr_set_result_callback(asr_result_handler);
+    ollama_set_response_callback(llm_response_handler);
+    if (chunker) {
+        ollama_chunker_config_t cfg = OLLAMA_CHUNKER_DEFAULT_CONFIG();
+        if (!parse_chunker(chunker, &cfg)) {
+            ESP_LOGE(TAG, "%s格式错误: %s", REPLAY_CHUNKER_ENV, chunker);
+            exit(2);
+        }
+        ollama_set_chunker_config(&cfg);
+    }
+    s_measure = true;
+    s_request_time_us = -1;
+
+    int64_t wall = esp_timer_get_time();
+    if (real_time) {
+        replay_real_time(entries, count);
+    } else {
+        for (int l = 0; l < loops; l++) {
+            for (size_t i = 0; i < count; i++) {
+                replay_entry(&entries[i]);
+            }
+            // 只在第一遍输出结果和统计首段时间, 之后的遍数只用于统计吞吐
+            s_measure = false;
+            s_print = false;
+        }
+    }
+    print_stats(esp_timer_get_time() - wall);
+    print_ttfc(verbose);
+
+    traffic_capture_free(entries, count);
+    ollama_cleanup();
+    exit(0);
+}
@@ -0,0 +1,124 @@
+/*
+ * 回声抑制测试: 合成回声(参考信号整体延迟若干毫秒再加一条短反射),
+ * 时延远超NLMS窗口时, 时延估计应找到它, 滤波器随后收敛(ERLE > 6dB)
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "aec.h"
+#include "test_main.h"
+
+/* 播放任务每次写入的参考样本数 */
+#define TEST_AEC_FEED           1024
+
+/* 仿真时长(样本) */
+#define TEST_AEC_SAMPLES        (6 * 16000)
+
+static aec_t s_aec;
+static int16_t s_ref[TEST_AEC_SAMPLES];
+static int16_t s_mic[AEC_BLOCK];
+
+// 低通滤波后的伪随机噪声, 幅度约为满量程的五分之一
+static void fill_reference(uint32_t seed)
+{
+    uint32_t x = seed;
+    int32_t y = 0;
+    for (size_t i = 0; i < TEST_AEC_SAMPLES; i++) {
+        x = x * 1664525u + 1013904223u;
+        int32_t noise = (int32_t)(x >> 16) - 32768;
+        y += (noise - y) / 4;
+        s_ref[i] = (int16_t)(y / 2);
+    }
+}
+
+static int16_t ref_at(int32_t i)
+{
+    return i >= 0 && i < TEST_AEC_SAMPLES ? s_ref[i] : 0;
+}
+
+// 按播放/采集两个任务的节奏仿真[from, to)区间: 参考按块提前写入, 麦克风按20ms处理.
+// 回声 = 0.5 * ref[t - delay] + 0.2 * ref[t - delay - 40], near非零时叠加独立的近端噪声
+static void simulate(size_t from, size_t to, int32_t delay, bool near)
+{
+    size_t fed = from;
+    uint32_t x = 12345;
+
+    for (size_t t = from; t < to; t += AEC_BLOCK) {
+        while (fed < t + AEC_BLOCK && fed < to) {
+            size_t n = to - fed < TEST_AEC_FEED ? to - fed : TEST_AEC_FEED;
+            aec_feed_reference(&s_aec, s_ref + fed, n);
+            fed += n;
+        }
+        for (size_t i = 0; i < AEC_BLOCK; i++) {
+            int32_t k = (int32_t)(t + i);
+            int32_t v = ref_at(k - delay) / 2 + ref_at(k - delay - 40) / 5;
+            if (near) {
+                x = x * 1664525u + 1013904223u;
+                v = (int32_t)(x >> 18) - 8192;
+            }
+            s_mic[i] = (int16_t)v;
+        }
+        aec_process(&s_aec, s_mic, AEC_BLOCK);
+    }
+}
+
+static void check_delay(const aec_stats_t *st, int32_t delay)
+{
+    // 估计值比真实时延提前AEC_DELAY_MARGIN, 误差不超过一个抽取点
+    TEST_ASSERT_INT32_WITHIN(AEC_XCORR_DECIM, delay - AEC_DELAY_MARGIN, (int32_t)st->delay_samples);
+}
+
+// 100ms整体时延(1600样本, NLMS窗口的6倍)
+static void test_aec_compensates_bulk_delay(void)
+{
+    aec_stats_t st;
+
+    fill_reference(1);
+    aec_init(&s_aec, AEC_MODE_NLMS);
+    simulate(0, TEST_AEC_SAMPLES, 1600, false);
+    aec_get_stats(&s_aec, &st);
+
+    TEST_ASSERT_EQUAL_UINT32(1, st.delay_updates);
+    check_delay(&st, 1600);
+    TEST_ASSERT_GREATER_THAN_UINT32(AEC_CONVERGED_ERLE_Q8, st.erle_q8);
+    TEST_ASSERT_EQUAL_UINT32(0, st.ref_overflow);
+}
+
+// 回声路径改变(例如DMA深度变化)后重新估计
+static void test_aec_tracks_delay_change(void)
+{
+    aec_stats_t st;
+
+    fill_reference(2);
+    aec_init(&s_aec, AEC_MODE_NLMS);
+    simulate(0, TEST_AEC_SAMPLES / 2, 2400, false);
+    aec_get_stats(&s_aec, &st);
+    check_delay(&st, 2400);
+
+    simulate(TEST_AEC_SAMPLES / 2, TEST_AEC_SAMPLES, 700, false);
+    aec_get_stats(&s_aec, &st);
+    TEST_ASSERT_EQUAL_UINT32(2, st.delay_updates);
+    check_delay(&st, 700);
+    TEST_ASSERT_GREATER_THAN_UINT32(AEC_CONVERGED_ERLE_Q8, st.erle_q8);
+}
+
+// 麦克风里只有与参考无关的信号: 没有可信的峰值, 时延保持不变
+static void test_aec_ignores_uncorrelated_mic(void)
+{
+    aec_stats_t st;
+
+    fill_reference(3);
+    aec_init(&s_aec, AEC_MODE_NLMS);
+    simulate(0, TEST_AEC_SAMPLES, 1600, true);
+    aec_get_stats(&s_aec, &st);
+
+    TEST_ASSERT_EQUAL_UINT32(0, st.delay_updates);
+    TEST_ASSERT_EQUAL_UINT32(0, st.delay_samples);
+}
+
+void test_aec(void)
+{
+    RUN_TEST(test_aec_compensates_bulk_delay);
+    RUN_TEST(test_aec_tracks_delay_change);
+    RUN_TEST(test_aec_ignores_uncorrelated_mic);
+}
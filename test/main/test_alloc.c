@@ -0,0 +1,56 @@
+/*
+ * 内存分配计数
+ *
+ * 链接时用--wrap把malloc/calloc/realloc/free转到这里计数(见CMakeLists.txt),
+ * 只统计本线程在计数期间的调用, 不受其他任务影响.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "test_main.h"
+
+uint32_t test_allocs;
+uint32_t test_frees;
+
+static _Thread_local bool s_counting;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    test_allocs += s_counting;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    test_allocs += s_counting;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    test_allocs += s_counting;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    test_frees += s_counting && ptr;
+    __real_free(ptr);
+}
+
+void test_alloc_begin(void)
+{
+    test_allocs = 0;
+    test_frees = 0;
+    s_counting = true;
+}
+
+void test_alloc_end(void)
+{
+    s_counting = false;
+}
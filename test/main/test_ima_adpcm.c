@@ -0,0 +1,182 @@
+/*
+ * IMA-ADPCM测试: 正弦和噪声往返编解码的信噪比, 奇数样本数的块,
+ * 丢块之后单独解码后续块, 以及与tools/ima_adpcm.py逐样本一致
+ */
+
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+#include "ima_adpcm.h"
+#include "test_main.h"
+
+/* 上传一帧的样本数(60ms) */
+#define TEST_ADPCM_FRAME        960
+
+/* 仿真时长(样本) */
+#define TEST_ADPCM_SAMPLES      (2 * 16000)
+
+/* 往返信噪比下限(dB): 1kHz正弦实测27dB, 低通噪声21dB */
+#define TEST_ADPCM_TONE_SNR_DB  24
+#define TEST_ADPCM_NOISE_SNR_DB 18
+
+static int16_t s_pcm[TEST_ADPCM_SAMPLES];
+static int16_t s_out[TEST_ADPCM_SAMPLES];
+static uint8_t s_block[IMA_ADPCM_BLOCK_BYTES(TEST_ADPCM_FRAME)];
+
+/*
+ * 参考向量: 块头预测值-1000, 步长索引2, 49个码(奇数, 末字节高4位填充0xA),
+ * 依次覆盖索引下限, 预测值上下限饱和, 索引上限和全部16个码.
+ * 期望输出由tools/ima_adpcm.py解码得到:
+ *   cd tools && python3 -c 'import struct, ima_adpcm; d = bytes([...]);
+ *       o = ima_adpcm.decode_block(d); print(struct.unpack("<%dh" % (len(o) // 2), o))'
+ */
+static const uint8_t s_golden_block[] = {
+    0x18, 0xFC, 0x02, 0x01, 0x00, 0x00, 0x70, 0x77, 0x77, 0x77, 0xF7, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x21, 0x43, 0x65, 0x87, 0xA9, 0xCB,
+    0xED, 0x3F, 0x5C, 0x9A, 0xA6,
+};
+
+static const int16_t s_golden_pcm[] = {
+    -999, -998, -998, -998, -998, -987, -957, -894, -758, -465,
+    166, 1523, 4433, -1803, -15175, -32768, -32768, -32768, -32768, -32768,
+    -32768, -32768, -32768, -32768, -32768, -32768, -32768, -28673, -17501, -573,
+    20970, 32767, 32767, 32767, 32767, 28672, 17500, 572, -20971, -32768,
+    -32768, -32768, -32768, -4099, -32768, 12285, -8193, -19365, 24649,
+};
+
+static void fill_tone(void)
+{
+    for (size_t i = 0; i < TEST_ADPCM_SAMPLES; i++) {
+        s_pcm[i] = (int16_t)(12000.0 * sin(2.0 * M_PI * 1000.0 * i / 16000.0));
+    }
+}
+
+// 低通滤波后的伪随机噪声, 与test_aec.c的参考信号相同
+static void fill_noise(uint32_t seed)
+{
+    uint32_t x = seed;
+    int32_t y = 0;
+    for (size_t i = 0; i < TEST_ADPCM_SAMPLES; i++) {
+        x = x * 1664525u + 1013904223u;
+        int32_t noise = (int32_t)(x >> 16) - 32768;
+        y += (noise - y) / 4;
+        s_pcm[i] = (int16_t)(y / 2);
+    }
+}
+
+// 信噪比, 取整到dB
+static int32_t snr_db(const int16_t *ref, const int16_t *out, size_t samples)
+{
+    double signal = 0;
+    double noise = 0;
+    for (size_t i = 0; i < samples; i++) {
+        double e = (double)ref[i] - out[i];
+        signal += (double)ref[i] * ref[i];
+        noise += e * e;
+    }
+    return (int32_t)floor(10.0 * log10(signal / (noise > 0 ? noise : 1)));
+}
+
+// 按frame个样本一块编码s_pcm再逐块解码到s_out, 编码状态跨块保持
+static void round_trip(size_t frame)
+{
+    ima_adpcm_state_t state;
+
+    ima_adpcm_reset(&state);
+    for (size_t off = 0; off < TEST_ADPCM_SAMPLES; off += frame) {
+        size_t n = TEST_ADPCM_SAMPLES - off < frame ? TEST_ADPCM_SAMPLES - off : frame;
+        size_t len = ima_adpcm_encode_block(&state, s_pcm + off, n, s_block);
+        TEST_ASSERT_EQUAL(IMA_ADPCM_BLOCK_BYTES(n), len);
+        TEST_ASSERT_EQUAL(n, ima_adpcm_decode_block(s_block, len, s_out + off));
+        // 编码端按解码端的方式更新状态, 块尾两端的预测值一致
+        TEST_ASSERT_EQUAL_INT16(state.predictor, s_out[off + n - 1]);
+    }
+}
+
+// 与Python解码器逐样本一致, 奇数标志去掉末字节的填充码
+static void test_ima_adpcm_matches_reference(void)
+{
+    int16_t pcm[sizeof(s_golden_block) * 2];
+
+    size_t samples = ima_adpcm_decode_block(s_golden_block, sizeof(s_golden_block), pcm);
+    TEST_ASSERT_EQUAL(sizeof(s_golden_pcm) / sizeof(s_golden_pcm[0]), samples);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(s_golden_pcm, pcm, samples);
+}
+
+static void test_ima_adpcm_round_trip_tone(void)
+{
+    fill_tone();
+    round_trip(TEST_ADPCM_FRAME);
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_ADPCM_TONE_SNR_DB, snr_db(s_pcm, s_out, TEST_ADPCM_SAMPLES));
+}
+
+static void test_ima_adpcm_round_trip_noise(void)
+{
+    fill_noise(1);
+    round_trip(TEST_ADPCM_FRAME);
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_ADPCM_NOISE_SNR_DB, snr_db(s_pcm, s_out, TEST_ADPCM_SAMPLES));
+}
+
+// 奇数帧长: 每块末字节只有低4位有效, 解码出的样本数与编码时相同
+static void test_ima_adpcm_odd_samples(void)
+{
+    int16_t pcm[2];
+
+    fill_tone();
+    round_trip(TEST_ADPCM_FRAME - 1);
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_ADPCM_TONE_SNR_DB, snr_db(s_pcm, s_out, TEST_ADPCM_SAMPLES));
+
+    fill_noise(2);
+    round_trip(7);
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_ADPCM_NOISE_SNR_DB, snr_db(s_pcm, s_out, TEST_ADPCM_SAMPLES));
+
+    ima_adpcm_state_t state;
+    ima_adpcm_reset(&state);
+    size_t len = ima_adpcm_encode_block(&state, s_pcm, 1, s_block);
+    TEST_ASSERT_EQUAL(IMA_ADPCM_HEADER_BYTES + 1, len);
+    TEST_ASSERT_EQUAL(IMA_ADPCM_FLAG_ODD, s_block[3]);
+    TEST_ASSERT_EQUAL(1, ima_adpcm_decode_block(s_block, len, pcm));
+}
+
+// 上传队列丢掉一块: 后续块靠块头里的状态单独解码, 结果与连续解码完全相同
+static void test_ima_adpcm_decodes_after_dropped_block(void)
+{
+    ima_adpcm_state_t state;
+    int16_t pcm[TEST_ADPCM_FRAME];
+
+    fill_tone();
+    round_trip(TEST_ADPCM_FRAME);
+
+    ima_adpcm_reset(&state);
+    size_t len = 0;
+    for (size_t k = 0; k < 3; k++) {
+        // 第1块在上传队列里被丢弃, 接收端直接收到第2块
+        len = ima_adpcm_encode_block(&state, s_pcm + k * TEST_ADPCM_FRAME, TEST_ADPCM_FRAME, s_block);
+    }
+    TEST_ASSERT_EQUAL(TEST_ADPCM_FRAME, ima_adpcm_decode_block(s_block, len, pcm));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(s_out + 2 * TEST_ADPCM_FRAME, pcm, TEST_ADPCM_FRAME);
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_ADPCM_TONE_SNR_DB,
+                                 snr_db(s_pcm + 2 * TEST_ADPCM_FRAME, pcm, TEST_ADPCM_FRAME));
+}
+
+// 不完整的块和越界的步长索引不解码
+static void test_ima_adpcm_rejects_bad_block(void)
+{
+    uint8_t block[sizeof(s_golden_block)];
+    int16_t pcm[sizeof(s_golden_block) * 2];
+
+    TEST_ASSERT_EQUAL(0, ima_adpcm_decode_block(s_golden_block, IMA_ADPCM_HEADER_BYTES - 1, pcm));
+    memcpy(block, s_golden_block, sizeof(block));
+    block[2] = 89;
+    TEST_ASSERT_EQUAL(0, ima_adpcm_decode_block(block, sizeof(block), pcm));
+}
+
+void test_ima_adpcm(void)
+{
+    RUN_TEST(test_ima_adpcm_matches_reference);
+    RUN_TEST(test_ima_adpcm_round_trip_tone);
+    RUN_TEST(test_ima_adpcm_round_trip_noise);
+    RUN_TEST(test_ima_adpcm_odd_samples);
+    RUN_TEST(test_ima_adpcm_decodes_after_dropped_block);
+    RUN_TEST(test_ima_adpcm_rejects_bad_block);
+}
@@ -0,0 +1,31 @@
+/*
+ * 主机单元测试入口
+ *
+ * 按模块依次运行各组用例, 输出Unity的结果汇总, 失败的用例数作为退出码.
+ */
+
+#include <stdlib.h>
+#include "unity.h"
+#include "test_main.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    test_resampler();
+    test_vad_preroll();
+    test_ollama_chunker();
+    test_ollama_ndjson();
+    test_aec();
+    test_tts_cache();
+    test_ima_adpcm();
+    test_pcm_sink();
+    exit(UNITY_END());
+}
@@ -0,0 +1,27 @@
+#ifndef TEST_MAIN_H
+#define TEST_MAIN_H
+
+#include <stdint.h>
+
+/*
+ * 每个test_<模块>.c导出一个函数, 用RUN_TEST运行本文件中的全部用例
+ */
+void test_resampler(void);
+void test_vad_preroll(void);
+void test_ollama_chunker(void);
+void test_ollama_ndjson(void);
+void test_aec(void);
+void test_tts_cache(void);
+void test_ima_adpcm(void);
+void test_pcm_sink(void);
+
+/*
+ * 内存分配计数(test_alloc.c): test_alloc_begin和test_alloc_end之间
+ * 本线程调用malloc/calloc/realloc和free的次数
+ */
+extern uint32_t test_allocs;
+extern uint32_t test_frees;
+void test_alloc_begin(void);
+void test_alloc_end(void);
+
+#endif /* TEST_MAIN_H */
@@ -0,0 +1,70 @@
+/*
+ * 分句测试: 中英文标点, 最小/最大长度, 不完整的UTF-8字符, 英文句点的特殊情况
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "ollama_chunker.h"
+#include "test_main.h"
+
+static const ollama_chunker_config_t s_cfg = OLLAMA_CHUNKER_DEFAULT_CONFIG();
+
+static size_t cut(const char *text, bool first_chunk)
+{
+    return ollama_chunker_find_cut(&s_cfg, text, strlen(text), first_chunk);
+}
+
+static void test_chunker_cjk_punctuation(void)
+{
+    // 句末标点总是切分
+    TEST_ASSERT_EQUAL(strlen("好。"), cut("好。再见", false));
+    TEST_ASSERT_EQUAL(strlen("真的吗？"), cut("真的吗？是的", false));
+    // 逗号类标点: 第一块2个汉字即可, 后续块至少4个汉字
+    TEST_ASSERT_EQUAL(strlen("你好，"), cut("你好，世界", true));
+    TEST_ASSERT_EQUAL(0, cut("你好，世界", false));
+    TEST_ASSERT_EQUAL(strlen("今天天气，"), cut("今天天气，很好", false));
+    // 没有标点且未到最大长度时等待
+    TEST_ASSERT_EQUAL(0, cut("今天天气很好", false));
+}
+
+static void test_chunker_max_length(void)
+{
+    char text[256] = "";
+    for (int i = 0; i < 50; i++) {
+        strcat(text, "好");
+    }
+    // 强制切分点在最大长度以内的最后一个字符边界
+    size_t n = cut(text, false);
+    TEST_ASSERT_EQUAL(s_cfg.max_bytes / 3 * 3, n);
+}
+
+static void test_chunker_partial_utf8(void)
+{
+    // "。"只收到前两个字节, 不能当作标点, 也不能切在字符中间
+    const char text[] = "你好\xe3\x80";
+    TEST_ASSERT_EQUAL(0, ollama_chunker_find_cut(&s_cfg, text, sizeof(text) - 1, false));
+}
+
+static void test_chunker_ascii_period(void)
+{
+    // 小数点和版本号
+    TEST_ASSERT_EQUAL(0, cut("Pi is 3.14159", false));
+    TEST_ASSERT_EQUAL(0, cut("圆周率约等于3.", false));
+    TEST_ASSERT_EQUAL(0, cut("Released v1.2", false));
+    // 缩写中间的点
+    TEST_ASSERT_EQUAL(0, cut("Fruit, e.g", false));
+    // 后面是空白或文本末尾时是句末
+    TEST_ASSERT_EQUAL(strlen("Hello world."), cut("Hello world. Next", false));
+    TEST_ASSERT_EQUAL(strlen("Hello world."), cut("Hello world.", false));
+    TEST_ASSERT_EQUAL(strlen("v1.2 is out."), cut("v1.2 is out.\nBye", false));
+    // 其它英文句末标点不受影响
+    TEST_ASSERT_EQUAL(strlen("Really?"), cut("Really?Yes", false));
+}
+
+void test_ollama_chunker(void)
+{
+    RUN_TEST(test_chunker_cjk_punctuation);
+    RUN_TEST(test_chunker_max_length);
+    RUN_TEST(test_chunker_partial_utf8);
+    RUN_TEST(test_chunker_ascii_period);
+}
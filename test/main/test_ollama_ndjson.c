@@ -0,0 +1,263 @@
+/*
+ * 增量NDJSON解析器测试
+ *
+ * 同一段流式回复在任意位置切成两段或三段, 以及逐字节输入时,
+ * 回调得到的消息序列都必须与整段输入相同, 并且与预期内容一致.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "ollama_ndjson.h"
+#include "test_main.h"
+
+#define TEST_MAX_MSGS       16
+#define TEST_CONTEXT_CAP    8
+
+typedef struct {
+    char response[OLLAMA_NDJSON_TEXT_MAX + 1];
+    size_t response_len;
+    bool has_response;
+    bool truncated;
+    bool done;
+    bool has_context;
+    size_t context_total;
+    int32_t context[TEST_CONTEXT_CAP];
+} test_msg_t;
+
+typedef struct {
+    test_msg_t msgs[TEST_MAX_MSGS];
+    size_t count;
+} test_result_t;
+
+static ollama_ndjson_t s_parser;
+static int32_t s_context[TEST_CONTEXT_CAP];
+static test_result_t s_expect;
+static test_result_t s_got;
+
+/*
+ * 覆盖: 转义(\" \\ \n \/), \u转义的汉字和代理对, 字段顺序变化, 嵌套对象/数组中的
+ * 字符串里出现括号和引号, 负数和空白, 多行合并, 最后一行带context
+ */
+static const char s_stream[] =
+    "{\"model\":\"qwen2:0.5b\",\"response\":\"你好\",\"done\":false}\n"
+    "{\"response\":\"say \\\"hi\\\"\\\\\\n\",\"done\":false,\"meta\":{\"a\":[1,{\"b\":\"}]\\\"\"}]}}\n"
+    "{\"done\":false,\"response\":\"\\u4f60\\ud83d\\ude00\\/\"}\r\n"
+    "  {\"created_at\":\"2024-05-01T08:00:00Z\",\"response\":\"\",\"done\":true,\"done_reason\":\"stop\","
+    "\"context\":[ 151644, -7 ,0,42],\"total_duration\":812345678,\"eval_count\":3}\n";
+
+static void record(const ollama_ndjson_msg_t *msg, void *ctx)
+{
+    test_result_t *r = (test_result_t *)ctx;
+    TEST_ASSERT_LESS_THAN(TEST_MAX_MSGS, r->count);
+    test_msg_t *m = &r->msgs[r->count++];
+    memcpy(m->response, msg->response, msg->response_len + 1);
+    m->response_len = msg->response_len;
+    m->has_response = msg->has_response;
+    m->truncated = msg->truncated;
+    m->done = msg->done;
+    m->has_context = msg->has_context;
+    m->context_total = msg->context_total;
+    memcpy(m->context, s_context, sizeof(s_context));
+}
+
+static void parser_reset(void)
+{
+    memset(s_context, 0, sizeof(s_context));
+    ollama_ndjson_set_context_buffer(&s_parser, s_context, TEST_CONTEXT_CAP);
+    ollama_ndjson_init(&s_parser);
+}
+
+static void check_same(const test_result_t *expect, const test_result_t *got)
+{
+    TEST_ASSERT_EQUAL(expect->count, got->count);
+    for (size_t i = 0; i < expect->count; i++) {
+        const test_msg_t *e = &expect->msgs[i];
+        const test_msg_t *g = &got->msgs[i];
+        TEST_ASSERT_EQUAL(e->response_len, g->response_len);
+        TEST_ASSERT_EQUAL_MEMORY(e->response, g->response, e->response_len + 1);
+        TEST_ASSERT_EQUAL(e->has_response, g->has_response);
+        TEST_ASSERT_EQUAL(e->done, g->done);
+        TEST_ASSERT_EQUAL(e->has_context, g->has_context);
+        TEST_ASSERT_EQUAL(e->context_total, g->context_total);
+        TEST_ASSERT_EQUAL_INT32_ARRAY(e->context, g->context, TEST_CONTEXT_CAP);
+    }
+}
+
+// 按给定的切分点输入
+static void feed_split(const char *data, size_t len, const size_t *cuts, size_t ncuts, test_result_t *out)
+{
+    size_t pos = 0;
+    memset(out, 0, sizeof(*out));
+    parser_reset();
+    for (size_t k = 0; k <= ncuts; k++) {
+        size_t end = k < ncuts ? cuts[k] : len;
+        ollama_ndjson_feed(&s_parser, data + pos, end - pos, record, out);
+        pos = end;
+    }
+}
+
+static void test_ndjson_whole_stream(void)
+{
+    feed_split(s_stream, sizeof(s_stream) - 1, NULL, 0, &s_expect);
+
+    TEST_ASSERT_EQUAL(4, s_expect.count);
+    TEST_ASSERT_EQUAL_STRING("你好", s_expect.msgs[0].response);
+    TEST_ASSERT_FALSE(s_expect.msgs[0].done);
+    TEST_ASSERT_EQUAL_STRING("say \"hi\"\\\n", s_expect.msgs[1].response);
+    TEST_ASSERT_EQUAL_STRING("你\xf0\x9f\x98\x80/", s_expect.msgs[2].response);
+    TEST_ASSERT_TRUE(s_expect.msgs[3].has_response);
+    TEST_ASSERT_EQUAL(0, s_expect.msgs[3].response_len);
+    TEST_ASSERT_TRUE(s_expect.msgs[3].done);
+    TEST_ASSERT_TRUE(s_expect.msgs[3].has_context);
+    TEST_ASSERT_EQUAL(4, s_expect.msgs[3].context_total);
+    TEST_ASSERT_EQUAL_INT32(151644, s_expect.msgs[3].context[0]);
+    TEST_ASSERT_EQUAL_INT32(-7, s_expect.msgs[3].context[1]);
+    TEST_ASSERT_EQUAL_INT32(0, s_expect.msgs[3].context[2]);
+    TEST_ASSERT_EQUAL_INT32(42, s_expect.msgs[3].context[3]);
+    TEST_ASSERT_EQUAL(0, s_parser.errors);
+}
+
+static void test_ndjson_every_two_way_split(void)
+{
+    size_t len = sizeof(s_stream) - 1;
+    feed_split(s_stream, len, NULL, 0, &s_expect);
+    for (size_t i = 0; i <= len; i++) {
+        feed_split(s_stream, len, &i, 1, &s_got);
+        check_same(&s_expect, &s_got);
+    }
+}
+
+static void test_ndjson_every_three_way_split(void)
+{
+    size_t len = sizeof(s_stream) - 1;
+    feed_split(s_stream, len, NULL, 0, &s_expect);
+    for (size_t i = 0; i <= len; i++) {
+        for (size_t j = i; j <= len; j++) {
+            size_t cuts[2] = {i, j};
+            feed_split(s_stream, len, cuts, 2, &s_got);
+            check_same(&s_expect, &s_got);
+        }
+    }
+}
+
+static void test_ndjson_byte_by_byte(void)
+{
+    static size_t cuts[sizeof(s_stream)];
+    size_t len = sizeof(s_stream) - 1;
+    for (size_t i = 0; i < len; i++) {
+        cuts[i] = i + 1;
+    }
+    feed_split(s_stream, len, NULL, 0, &s_expect);
+    feed_split(s_stream, len, cuts, len, &s_got);
+    check_same(&s_expect, &s_got);
+}
+
+// context超出缓冲区时按环形写入, 保留最后cap个
+static void test_ndjson_context_wraps(void)
+{
+    static const char line[] = "{\"done\":true,\"context\":[1,2,3,4,5,6,7,8,9,10,11]}\n";
+    feed_split(line, sizeof(line) - 1, NULL, 0, &s_got);
+    TEST_ASSERT_EQUAL(1, s_got.count);
+    TEST_ASSERT_EQUAL(11, s_got.msgs[0].context_total);
+    // 第i个元素在i % 8
+    static const int32_t expect[TEST_CONTEXT_CAP] = {9, 10, 11, 4, 5, 6, 7, 8};
+    TEST_ASSERT_EQUAL_INT32_ARRAY(expect, s_got.msgs[0].context, TEST_CONTEXT_CAP);
+}
+
+// 格式错误的行被丢弃并计数, 从下一行重新同步
+static void test_ndjson_resync_after_error(void)
+{
+    static const char data[] =
+        "{\"response\":\"a\",\"done\":false}\n"
+        "garbage{\"response\":\"lost\"}\n"
+        "{\"response\":\"b\" \"done\":false}\n"
+        "{\"response\":\"c\",\"done\":true}\n";
+    size_t len = sizeof(data) - 1;
+
+    for (size_t i = 0; i <= len; i++) {
+        feed_split(data, len, &i, 1, &s_got);
+        TEST_ASSERT_EQUAL(2, s_got.count);
+        TEST_ASSERT_EQUAL_STRING("a", s_got.msgs[0].response);
+        TEST_ASSERT_EQUAL_STRING("c", s_got.msgs[1].response);
+        TEST_ASSERT_TRUE(s_got.msgs[1].done);
+        TEST_ASSERT_EQUAL(2, s_parser.errors);
+    }
+}
+
+// response超长时截断在完整的UTF-8字符处
+static void test_ndjson_truncates_on_char_boundary(void)
+{
+    static char line[64 + 3 * (OLLAMA_NDJSON_TEXT_MAX + 2)];
+    strcpy(line, "{\"response\":\"x");
+    for (int i = 0; i < OLLAMA_NDJSON_TEXT_MAX / 3 + 2; i++) {
+        strcat(line, "好");
+    }
+    strcat(line, "\",\"done\":false}\n");
+
+    feed_split(line, strlen(line), NULL, 0, &s_got);
+    TEST_ASSERT_EQUAL(1, s_got.count);
+    TEST_ASSERT_TRUE(s_got.msgs[0].truncated);
+    // 1个'x'加上能完整放下的汉字
+    TEST_ASSERT_EQUAL(1 + (OLLAMA_NDJSON_TEXT_MAX - 1) / 3 * 3, s_got.msgs[0].response_len);
+    TEST_ASSERT_EQUAL('\0', s_got.msgs[0].response[s_got.msgs[0].response_len]);
+}
+
+// context数组中出现非法字符: 整行作废, 但缓冲区已被部分改写, context_written提示调用方
+static void test_ndjson_malformed_context(void)
+{
+    static const char line[] = "{\"done\":true,\"context\":[1,2,3,x4]}\n";
+    static const int32_t previous[4] = {11, 12, 13, 14};
+    size_t len = sizeof(line) - 1;
+
+    for (size_t i = 0; i <= len; i++) {
+        memset(&s_got, 0, sizeof(s_got));
+        parser_reset();
+        memcpy(s_context, previous, sizeof(previous));
+        TEST_ASSERT_FALSE(s_parser.context_written);
+
+        ollama_ndjson_feed(&s_parser, line, i, record, &s_got);
+        ollama_ndjson_feed(&s_parser, line + i, len - i, record, &s_got);
+
+        TEST_ASSERT_EQUAL(0, s_got.count);
+        TEST_ASSERT_EQUAL(1, s_parser.errors);
+        TEST_ASSERT_FALSE(s_parser.msg.has_context);
+        TEST_ASSERT_TRUE(s_parser.context_written);
+        // 原有内容已被覆盖, 不能再当作上一轮的上下文
+        TEST_ASSERT_EQUAL_INT32(1, s_context[0]);
+    }
+
+    // 其后的正常行不清除标志, 只有init清除
+    static const char next[] = "{\"response\":\"a\",\"done\":false}\n";
+    ollama_ndjson_feed(&s_parser, next, sizeof(next) - 1, record, &s_got);
+    TEST_ASSERT_EQUAL(1, s_got.count);
+    TEST_ASSERT_TRUE(s_parser.context_written);
+    ollama_ndjson_init(&s_parser);
+    TEST_ASSERT_FALSE(s_parser.context_written);
+}
+
+// 没有context字段时缓冲区不被触碰
+static void test_ndjson_no_context_keeps_buffer(void)
+{
+    static const char line[] = "{\"response\":\"\",\"done\":true,\"context_size\":[9,9]}\n";
+    parser_reset();
+    s_context[0] = 11;
+    memset(&s_got, 0, sizeof(s_got));
+    ollama_ndjson_feed(&s_parser, line, sizeof(line) - 1, record, &s_got);
+    TEST_ASSERT_EQUAL(1, s_got.count);
+    TEST_ASSERT_FALSE(s_got.msgs[0].has_context);
+    TEST_ASSERT_FALSE(s_parser.context_written);
+    TEST_ASSERT_EQUAL_INT32(11, s_context[0]);
+}
+
+void test_ollama_ndjson(void)
+{
+    RUN_TEST(test_ndjson_whole_stream);
+    RUN_TEST(test_ndjson_every_two_way_split);
+    RUN_TEST(test_ndjson_every_three_way_split);
+    RUN_TEST(test_ndjson_byte_by_byte);
+    RUN_TEST(test_ndjson_context_wraps);
+    RUN_TEST(test_ndjson_resync_after_error);
+    RUN_TEST(test_ndjson_truncates_on_char_boundary);
+    RUN_TEST(test_ndjson_malformed_context);
+    RUN_TEST(test_ndjson_no_context_keeps_buffer);
+}
@@ -0,0 +1,158 @@
+/*
+ * 播放块池测试: 合成任务的写入(切块, 跨段拼接尾部, 打断)和播放任务的取块/归还
+ * 初始化之后都不分配内存, 取出的PCM与写入时一致, 打断和清空后所有块回到池中
+ */
+
+#include <stdbool.h>
+#include "unity.h"
+#include "pcm_sink.h"
+#include "test_main.h"
+
+/* 合成器每段输出的样本数, 不是块大小的整数分之一, 尾部要跨段拼接 */
+#define TEST_SINK_SEGMENT       700
+
+/* 每条应答的段数: 4个整块和一个不足一块的尾部 */
+#define TEST_SINK_SEGMENTS      7
+
+/* 稳态测试中的应答条数 */
+#define TEST_SINK_REPLIES       50
+
+static cancel_source_t s_cancel;
+static int16_t s_segment[TEST_SINK_SEGMENT];
+
+static int16_t sample_at(size_t i)
+{
+    return (int16_t)(i * 7 + 3);
+}
+
+// 按合成器的节奏写入一条应答, 返回提交的块数
+static int write_reply(uint32_t epoch)
+{
+    cancel_token_t token = cancel_token_make(&s_cancel, epoch);
+    int submitted = 0;
+
+    for (size_t k = 0; k < TEST_SINK_SEGMENTS; k++) {
+        for (size_t i = 0; i < TEST_SINK_SEGMENT; i++) {
+            s_segment[i] = sample_at(k * TEST_SINK_SEGMENT + i);
+        }
+        int n = pcm_sink_write(s_segment, TEST_SINK_SEGMENT, &token);
+        if (n < 0) {
+            return n;
+        }
+        submitted += n;
+    }
+    return submitted + pcm_sink_write_end();
+}
+
+// 按播放任务的方式取出全部排队的块, 检查内容连续, 返回不一致的样本数
+static uint32_t play_reply(uint32_t epoch)
+{
+    uint32_t mismatches = 0;
+    size_t pos = 0;
+    pcm_block_t *block;
+
+    while ((block = pcm_sink_receive(0)) != NULL) {
+        mismatches += block->epoch != epoch;
+        for (size_t i = 0; i < block->samples; i++) {
+            mismatches += block->data[i] != sample_at(pos++);
+        }
+        pcm_sink_release(block);
+    }
+    mismatches += pos != TEST_SINK_SEGMENTS * TEST_SINK_SEGMENT;
+    return mismatches;
+}
+
+// 池中的块都是空闲的: 不等待就能全部取出
+static void assert_pool_full(void)
+{
+    pcm_block_t *blocks[PCM_SINK_POOL_BLOCKS];
+
+    TEST_ASSERT_EQUAL_UINT32(0, pcm_sink_pending());
+    for (int i = 0; i < PCM_SINK_POOL_BLOCKS; i++) {
+        blocks[i] = pcm_sink_acquire(0);
+        TEST_ASSERT_NOT_NULL(blocks[i]);
+    }
+    for (int i = 0; i < PCM_SINK_POOL_BLOCKS; i++) {
+        pcm_sink_release(blocks[i]);
+    }
+}
+
+static void test_pcm_sink_init(void)
+{
+    cancel_source_init(&s_cancel);
+    TEST_ASSERT_EQUAL(ESP_OK, pcm_sink_init());
+    assert_pool_full();
+}
+
+// 7段700个样本: 4个整块, 尾部和下一段拼接, 最后一块由write_end提交
+static void test_pcm_sink_write_splits_blocks(void)
+{
+    uint32_t epoch = cancel_source_epoch(&s_cancel);
+    int blocks = (TEST_SINK_SEGMENTS * TEST_SINK_SEGMENT + PCM_SINK_BLOCK_SAMPLES - 1) / PCM_SINK_BLOCK_SAMPLES;
+
+    TEST_ASSERT_EQUAL(blocks, write_reply(epoch));
+    TEST_ASSERT_EQUAL_UINT32(blocks, pcm_sink_pending());
+    TEST_ASSERT_EQUAL_UINT32(0, play_reply(epoch));
+    assert_pool_full();
+}
+
+// 写入和播放的稳态: 每条应答都经过块池, 没有堆分配
+static void test_pcm_sink_no_allocations(void)
+{
+    uint32_t epoch = cancel_source_epoch(&s_cancel);
+    uint32_t mismatches = 0;
+
+    test_alloc_begin();
+    for (int r = 0; r < TEST_SINK_REPLIES; r++) {
+        write_reply(epoch);
+        mismatches += play_reply(epoch);
+    }
+    test_alloc_end();
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+    TEST_ASSERT_EQUAL_UINT32(0, test_allocs);
+    TEST_ASSERT_EQUAL_UINT32(0, test_frees);
+}
+
+// 被打断: 手上的块归还, 不足一块的尾部不再提交
+static void test_pcm_sink_cancelled_write(void)
+{
+    cancel_token_t token = cancel_token_make(&s_cancel, cancel_source_epoch(&s_cancel));
+
+    // 下一段到来时发现已被打断
+    TEST_ASSERT_EQUAL(0, pcm_sink_write(s_segment, 100, &token));
+    cancel_source_cancel(&s_cancel);
+    TEST_ASSERT_EQUAL(-1, pcm_sink_write(s_segment, 100, &token));
+    TEST_ASSERT_FALSE(pcm_sink_write_end());
+    assert_pool_full();
+
+    // 合成结束, 提交尾部之前被打断
+    token.epoch = cancel_source_epoch(&s_cancel);
+    TEST_ASSERT_EQUAL(0, pcm_sink_write(s_segment, 100, &token));
+    cancel_source_cancel(&s_cancel);
+    TEST_ASSERT_FALSE(pcm_sink_write_end());
+    assert_pool_full();
+}
+
+// 打断时清空排队的块, 全部回到池中
+static void test_pcm_sink_flush_returns_blocks(void)
+{
+    pcm_sink_stats_t before, after;
+    uint32_t epoch = cancel_source_epoch(&s_cancel);
+
+    pcm_sink_get_stats(&before);
+    int blocks = write_reply(epoch);
+    TEST_ASSERT_GREATER_THAN(0, blocks);
+    pcm_sink_flush();
+    pcm_sink_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(blocks, after.flushed - before.flushed);
+    assert_pool_full();
+}
+
+void test_pcm_sink(void)
+{
+    RUN_TEST(test_pcm_sink_init);
+    RUN_TEST(test_pcm_sink_write_splits_blocks);
+    RUN_TEST(test_pcm_sink_no_allocations);
+    RUN_TEST(test_pcm_sink_cancelled_write);
+    RUN_TEST(test_pcm_sink_flush_returns_blocks);
+}
@@ -0,0 +1,143 @@
+/*
+ * 抽取器测试: 分块方式不影响输出, 实测频响满足通带/阻带指标,
+ * 削顶的输入滤波后过冲也不会回绕
+ */
+
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+#include "resampler.h"
+#include "test_main.h"
+
+#define TEST_INPUT_SAMPLES  9600
+#define TEST_AMPLITUDE      16000
+
+static int16_t s_in[TEST_INPUT_SAMPLES];
+static int16_t s_whole[TEST_INPUT_SAMPLES / RESAMPLER_DECIMATION + 1];
+static int16_t s_split[TEST_INPUT_SAMPLES / RESAMPLER_DECIMATION + 1];
+
+static void fill_noise(int16_t *pcm, size_t n)
+{
+    uint32_t x = 12345;
+    for (size_t i = 0; i < n; i++) {
+        x = x * 1664525u + 1013904223u;
+        pcm[i] = (int16_t)(x >> 17) - 16384;
+    }
+}
+
+// 正弦经过抽取器后的增益(dB), 跳过滤波器填满历史之前的输出
+static double gain_db(uint32_t freq_hz)
+{
+    resampler_t rs;
+    double in_power = 0;
+    double out_power = 0;
+
+    for (size_t i = 0; i < TEST_INPUT_SAMPLES; i++) {
+        s_in[i] = (int16_t)lrint(TEST_AMPLITUDE * sin(2.0 * M_PI * freq_hz * i / 48000.0));
+        in_power += (double)s_in[i] * s_in[i];
+    }
+    resampler_init(&rs);
+    size_t n = resampler_process(&rs, s_in, TEST_INPUT_SAMPLES, s_whole);
+    size_t skip = RESAMPLER_TAPS / RESAMPLER_DECIMATION;
+    for (size_t i = skip; i < n; i++) {
+        out_power += (double)s_whole[i] * s_whole[i];
+    }
+    return 10.0 * log10((out_power / (n - skip) + 1e-3) / (in_power / TEST_INPUT_SAMPLES));
+}
+
+// 任意大小的输入块(包括不是3的倍数, 以及超过内部工作缓冲区的块)拼接后与一次处理的结果相同
+static void test_resampler_block_split(void)
+{
+    static const size_t blocks[] = {1, 2, 7, 480, 481, 961, 2880};
+    resampler_t rs;
+
+    fill_noise(s_in, TEST_INPUT_SAMPLES);
+    resampler_init(&rs);
+    size_t whole = resampler_process(&rs, s_in, TEST_INPUT_SAMPLES, s_whole);
+    TEST_ASSERT_EQUAL(TEST_INPUT_SAMPLES / RESAMPLER_DECIMATION, whole);
+
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        size_t produced = 0;
+        resampler_init(&rs);
+        for (size_t pos = 0; pos < TEST_INPUT_SAMPLES; pos += blocks[b]) {
+            size_t n = TEST_INPUT_SAMPLES - pos < blocks[b] ? TEST_INPUT_SAMPLES - pos : blocks[b];
+            produced += resampler_process(&rs, s_in + pos, n, s_split + produced);
+        }
+        TEST_ASSERT_EQUAL(whole, produced);
+        TEST_ASSERT_EQUAL_INT16_ARRAY(s_whole, s_split, whole);
+    }
+}
+
+// 参考实现与resampler_process逐点相同
+static void test_resampler_matches_ref(void)
+{
+    resampler_t rs;
+
+    fill_noise(s_in, TEST_INPUT_SAMPLES);
+    resampler_init(&rs);
+    size_t n = resampler_process(&rs, s_in, TEST_INPUT_SAMPLES, s_whole);
+    resampler_init(&rs);
+    TEST_ASSERT_EQUAL(n, resampler_process_ref(&rs, s_in, TEST_INPUT_SAMPLES, s_split));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(s_whole, s_split, n);
+}
+
+// 削顶的正弦(驱动到满幅的1.2~2倍)滤波后过冲超出int16, 输出应饱和而不是回绕.
+// 同一输入减半后不会过冲, 其输出乘2再饱和作为对照, 回绕会产生接近65536的误差
+static void test_resampler_clipped_input(void)
+{
+    static const struct {
+        uint32_t freq_hz;
+        double drive;
+    } tones[] = {{500, 1.2}, {1000, 1.5}, {2000, 1.2}, {3000, 2.0}};
+    resampler_t rs;
+
+    for (size_t t = 0; t < sizeof(tones) / sizeof(tones[0]); t++) {
+        for (size_t i = 0; i < TEST_INPUT_SAMPLES; i++) {
+            double v = tones[t].drive * INT16_MAX * sin(2.0 * M_PI * tones[t].freq_hz * i / 48000.0);
+            s_in[i] = (int16_t)fmax(INT16_MIN, fmin(INT16_MAX, v));
+        }
+        resampler_init(&rs);
+        size_t n = resampler_process(&rs, s_in, TEST_INPUT_SAMPLES, s_whole);
+        resampler_init(&rs);
+        TEST_ASSERT_EQUAL(n, resampler_process_ref(&rs, s_in, TEST_INPUT_SAMPLES, s_split));
+        TEST_ASSERT_EQUAL_INT16_ARRAY(s_split, s_whole, n);
+
+        for (size_t i = 0; i < TEST_INPUT_SAMPLES; i++) {
+            s_in[i] /= 2;
+        }
+        resampler_init(&rs);
+        resampler_process(&rs, s_in, TEST_INPUT_SAMPLES, s_split);
+
+        uint32_t saturated = 0;
+        for (size_t j = 0; j < n; j++) {
+            int32_t expect = 2 * s_split[j];
+            expect = expect > INT16_MAX ? INT16_MAX : expect < INT16_MIN ? INT16_MIN : expect;
+            TEST_ASSERT_INT32_WITHIN(8, expect, s_whole[j]);
+            saturated += s_whole[j] == INT16_MAX || s_whole[j] == INT16_MIN;
+        }
+        // 确实覆盖到了过冲
+        TEST_ASSERT_GREATER_THAN_UINT32(0, saturated);
+    }
+}
+
+// 0~6kHz波动小于0.3dB; 10kHz以上(抽取后会混叠进语音频带)衰减至少70dB
+static void test_resampler_response(void)
+{
+    static const uint32_t passband[] = {300, 1000, 3000, 6000};
+    static const uint32_t stopband[] = {10000, 12500, 16500, 20000, 23000};
+
+    for (size_t i = 0; i < sizeof(passband) / sizeof(passband[0]); i++) {
+        TEST_ASSERT_LESS_THAN_MESSAGE(30, (int)lrint(fabs(gain_db(passband[i])) * 100), "通带波动(0.01dB)");
+    }
+    for (size_t i = 0; i < sizeof(stopband) / sizeof(stopband[0]); i++) {
+        TEST_ASSERT_LESS_THAN_MESSAGE(-70, (int)lrint(gain_db(stopband[i])), "阻带增益(dB)");
+    }
+}
+
+void test_resampler(void)
+{
+    RUN_TEST(test_resampler_block_split);
+    RUN_TEST(test_resampler_matches_ref);
+    RUN_TEST(test_resampler_clipped_input);
+    RUN_TEST(test_resampler_response);
+}
@@ -0,0 +1,171 @@
+/*
+ * 合成缓存测试: 初始化之后的写入, 淘汰和紧凑都不分配内存,
+ * 且每条缓存取出的PCM与写入时一致
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "unity.h"
+#include "tts_cache.h"
+#include "test_main.h"
+
+/* 缓存预算: 约2秒语音, 放不下全部短语, 需要淘汰 */
+#define TEST_CACHE_BUDGET       (64 * 1024)
+
+/* 写入的短语数和最长样本数 */
+#define TEST_CACHE_PHRASES      300
+#define TEST_CACHE_MAX_SAMPLES  6000
+
+/* 合成器每次交给缓存的样本数 */
+#define TEST_CACHE_BLOCK        512
+
+static tts_cache_t s_cache;
+static int16_t s_pcm[TEST_CACHE_MAX_SAMPLES];
+
+// 第n句的文本, 长度和内容都由n决定
+static void phrase_text(uint32_t n, char *text, size_t len)
+{
+    snprintf(text, len, "句子%lu", (unsigned long)n);
+}
+
+static size_t phrase_samples(uint32_t n)
+{
+    uint32_t x = n * 2654435761u;
+    return 100 + (x >> 8) % (TEST_CACHE_MAX_SAMPLES - 100);
+}
+
+static int16_t phrase_sample(uint32_t n, size_t i)
+{
+    return (int16_t)(n * 131 + i * 7);
+}
+
+// 按合成器的节奏分块写入第n句
+static void insert_phrase(uint32_t n)
+{
+    char text[24];
+    size_t samples = phrase_samples(n);
+
+    phrase_text(n, text, sizeof(text));
+    for (size_t i = 0; i < samples; i++) {
+        s_pcm[i] = phrase_sample(n, i);
+    }
+    tts_cache_begin(&s_cache, text);
+    for (size_t off = 0; off < samples; off += TEST_CACHE_BLOCK) {
+        size_t len = samples - off < TEST_CACHE_BLOCK ? samples - off : TEST_CACHE_BLOCK;
+        tts_cache_append(&s_cache, s_pcm + off, len);
+    }
+    tts_cache_commit(&s_cache);
+}
+
+// 第n句命中时内容必须与写入时一致
+static bool check_phrase(uint32_t n)
+{
+    char text[24];
+    const int16_t *pcm;
+    size_t samples;
+
+    phrase_text(n, text, sizeof(text));
+    if (!tts_cache_lookup(&s_cache, text, &pcm, &samples)) {
+        return false;
+    }
+    TEST_ASSERT_EQUAL(phrase_samples(n), samples);
+    for (size_t i = 0; i < samples; i++) {
+        TEST_ASSERT_EQUAL_INT16(phrase_sample(n, i), pcm[i]);
+    }
+    return true;
+}
+
+// 初始化分配arena和暂存区两块, 之后的写入/查询/淘汰/紧凑不再分配, 释放时归还两块
+static void test_tts_cache_no_alloc_after_init(void)
+{
+    tts_cache_stats_t st;
+
+    test_alloc_begin();
+    TEST_ASSERT_EQUAL(ESP_OK, tts_cache_init(&s_cache, TEST_CACHE_BUDGET));
+    test_alloc_end();
+    TEST_ASSERT_EQUAL_UINT32(2, test_allocs);
+
+    test_alloc_begin();
+    uint32_t hits = 0;
+    for (uint32_t n = 0; n < TEST_CACHE_PHRASES; n++) {
+        insert_phrase(n);
+        // 隔几句回头查一次较早的短语, 打乱最近使用顺序, 制造空隙
+        TEST_ASSERT_TRUE(check_phrase(n));
+        if (n >= 3 && n % 3 == 0) {
+            hits += check_phrase(n - 3);
+        }
+    }
+    test_alloc_end();
+
+    TEST_ASSERT_EQUAL_UINT32(0, test_allocs);
+    TEST_ASSERT_EQUAL_UINT32(0, test_frees);
+
+    tts_cache_get_stats(&s_cache, &st);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, hits);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, st.evictions);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, st.compactions);
+    TEST_ASSERT_LESS_OR_EQUAL(TEST_CACHE_BUDGET, st.bytes_used);
+
+    // 紧凑之后所有留下的条目仍然完整
+    uint32_t live = 0;
+    for (uint32_t n = 0; n < TEST_CACHE_PHRASES; n++) {
+        live += check_phrase(n);
+    }
+    TEST_ASSERT_EQUAL(st.entries, live);
+
+    test_alloc_begin();
+    tts_cache_deinit(&s_cache);
+    test_alloc_end();
+    TEST_ASSERT_EQUAL_UINT32(0, test_allocs);
+    TEST_ASSERT_EQUAL_UINT32(2, test_frees);
+}
+
+// 查询会刷新最近使用顺序: 预算满时先淘汰最久没被查过的条目, 刚查过的留下
+static void test_tts_cache_evicts_least_recently_used(void)
+{
+    tts_cache_stats_t st;
+    size_t budget = (phrase_samples(1) + phrase_samples(2) + phrase_samples(5)) * sizeof(int16_t);
+
+    TEST_ASSERT_EQUAL(ESP_OK, tts_cache_init(&s_cache, budget));
+    insert_phrase(1);
+    insert_phrase(2);
+    insert_phrase(5);
+    TEST_ASSERT_TRUE(check_phrase(1));
+
+    // 第4句比第2句长, 需要淘汰2和5两条, 最近查过的第1句保留
+    insert_phrase(4);
+    tts_cache_get_stats(&s_cache, &st);
+    TEST_ASSERT_EQUAL_UINT32(2, st.evictions);
+    TEST_ASSERT_TRUE(check_phrase(4));
+    TEST_ASSERT_TRUE(check_phrase(1));
+    TEST_ASSERT_FALSE(check_phrase(2));
+    TEST_ASSERT_FALSE(check_phrase(5));
+    tts_cache_deinit(&s_cache);
+}
+
+// 超过预算的短语不缓存, 也不淘汰已有条目
+static void test_tts_cache_skips_oversized(void)
+{
+    tts_cache_stats_t st;
+    size_t budget = phrase_samples(0) * sizeof(int16_t);
+
+    TEST_ASSERT_EQUAL(ESP_OK, tts_cache_init(&s_cache, budget));
+    insert_phrase(0);
+    uint32_t n = 1;
+    while (phrase_samples(n) <= phrase_samples(0)) {
+        n++;
+    }
+    insert_phrase(n);
+    tts_cache_get_stats(&s_cache, &st);
+    TEST_ASSERT_EQUAL_UINT32(1, st.skipped);
+    TEST_ASSERT_EQUAL_UINT32(0, st.evictions);
+    TEST_ASSERT_TRUE(check_phrase(0));
+    tts_cache_deinit(&s_cache);
+}
+
+void test_tts_cache(void)
+{
+    RUN_TEST(test_tts_cache_no_alloc_after_init);
+    RUN_TEST(test_tts_cache_evicts_least_recently_used);
+    RUN_TEST(test_tts_cache_skips_oversized);
+}
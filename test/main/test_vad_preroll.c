@@ -0,0 +1,101 @@
+/*
+ * 预录环形缓冲区测试: 任意写入块大小和环长度下, 取出的样本恰好是最近写入的
+ * min(写入总数, 环长度)个样本, 按时间顺序且连续
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "vad_preroll.h"
+#include "test_main.h"
+
+static vad_preroll_t s_pr;
+static int16_t s_chunk[VAD_PREROLL_SAMPLES * 2 + 7];
+static int16_t s_out[VAD_PREROLL_SAMPLES];
+
+// 样本值就是写入序号, 取出后可以直接检查顺序
+static uint32_t push_sequence(uint32_t next, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        s_chunk[i] = (int16_t)(next + i);
+    }
+    vad_preroll_push(&s_pr, s_chunk, len);
+    return next + len;
+}
+
+static void check_drain(uint32_t next, size_t pushed, size_t capacity)
+{
+    size_t expect = pushed < capacity ? pushed : capacity;
+    size_t n = vad_preroll_drain(&s_pr, s_out);
+    TEST_ASSERT_EQUAL(expect, n);
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_INT16((int16_t)(next - n + i), s_out[i]);
+    }
+    TEST_ASSERT_EQUAL(0, vad_preroll_count(&s_pr));
+}
+
+static void test_preroll_init_rejects_bad_capacity(void)
+{
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, vad_preroll_init(&s_pr, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, vad_preroll_init(&s_pr, VAD_PREROLL_SAMPLES + 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, vad_preroll_init(NULL, VAD_PREROLL_SAMPLES));
+    TEST_ASSERT_EQUAL(ESP_OK, vad_preroll_init(&s_pr, VAD_PREROLL_SAMPLES));
+    TEST_ASSERT_EQUAL(0, vad_preroll_drain(&s_pr, s_out));
+}
+
+// 固定块大小写入, 每写入若干块取出一次; 块大小覆盖小于/等于/大于环长度的情况
+static void test_preroll_order_fixed_chunks(void)
+{
+    const size_t capacities[] = {1, 7, VAD_FRAME_SAMPLES, 1000, VAD_PREROLL_SAMPLES};
+
+    for (size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+        size_t capacity = capacities[c];
+        const size_t chunks[] = {1, 3, VAD_FRAME_SAMPLES, capacity - 1 ? capacity - 1 : 1, capacity,
+                                 capacity + 5, VAD_PREROLL_SAMPLES * 2};
+
+        for (size_t k = 0; k < sizeof(chunks) / sizeof(chunks[0]); k++) {
+            uint32_t next = 0;
+            TEST_ASSERT_EQUAL(ESP_OK, vad_preroll_init(&s_pr, capacity));
+            for (size_t pushes = 1; pushes <= 9; pushes++) {
+                size_t pushed = 0;
+                for (size_t p = 0; p < pushes; p++) {
+                    next = push_sequence(next, chunks[k]);
+                    pushed += chunks[k];
+                }
+                check_drain(next, pushed, capacity);
+            }
+        }
+    }
+}
+
+// 随机块大小, 取出的时机也随机, 环在各个位置回绕
+static void test_preroll_order_random_chunks(void)
+{
+    const size_t capacities[] = {5, 160, 999, VAD_PREROLL_SAMPLES};
+    uint32_t rng = 1;
+
+    for (size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+        size_t capacity = capacities[c];
+        uint32_t next = 0;
+        size_t pushed = 0;
+
+        TEST_ASSERT_EQUAL(ESP_OK, vad_preroll_init(&s_pr, capacity));
+        for (int round = 0; round < 2000; round++) {
+            rng = rng * 1664525u + 1013904223u;
+            size_t len = (rng >> 8) % (capacity * 2 + 2);
+            next = push_sequence(next, len);
+            pushed += len;
+            TEST_ASSERT_EQUAL(pushed < capacity ? pushed : capacity, vad_preroll_count(&s_pr));
+            if ((rng >> 24) % 5 == 0) {
+                check_drain(next, pushed, capacity);
+                pushed = 0;
+            }
+        }
+    }
+}
+
+void test_vad_preroll(void)
+{
+    RUN_TEST(test_preroll_init_rejects_bad_capacity);
+    RUN_TEST(test_preroll_order_fixed_chunks);
+    RUN_TEST(test_preroll_order_random_chunks);
+}
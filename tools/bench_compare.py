@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""比较两次微基准(bench/)的结果.
+
+从输出中提取BENCH行, 按用例名对齐, 给出ns/op和allocs/op的变化.
+只给一个文件时按CSV输出该次结果, 便于按提交存档.
+
+用法:
+    ./build/voice_pipeline_bench.elf > new.txt
+    python3 tools/bench_compare.py old.txt new.txt [--threshold 10]
+    python3 tools/bench_compare.py new.txt > new.csv
+"""
+
+import argparse
+import re
+import sys
+
+LINE = re.compile(r"BENCH (\S+) (.*)")
+FIELDS = ["iters", "ns_per_op", "bytes_per_op", "allocs_per_op", "cycles_per_op"]
+
+
+def parse(path):
+    results = {}
+    with open(path, encoding="utf-8", errors="replace") as fp:
+        for line in fp:
+            m = LINE.search(line)
+            if not m or "=" not in m.group(2).split()[0]:
+                continue
+            fields = dict(kv.split("=", 1) for kv in m.group(2).split() if "=" in kv)
+            results[m.group(1)] = {k: float(v) for k, v in fields.items()}
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("old")
+    parser.add_argument("new", nargs="?")
+    parser.add_argument("--threshold", type=float, default=0,
+                        help="ns/op变慢超过此百分比时返回非零, 0表示不检查")
+    args = parser.parse_args()
+
+    old = parse(args.old)
+    if not args.new:
+        print("name," + ",".join(FIELDS))
+        for name, r in old.items():
+            print(name + "," + ",".join("%.10g" % r[f] if f in r else "" for f in FIELDS))
+        return 0
+
+    new = parse(args.new)
+    regressions = []
+    print("%-28s %12s %12s %8s %10s" % ("用例", "旧 ns/op", "新 ns/op", "变化", "allocs/op"))
+    for name in list(old) + [n for n in new if n not in old]:
+        a, b = old.get(name), new.get(name)
+        if not a or not b:
+            print("%-28s %12s %12s" % (name, "%.1f" % a["ns_per_op"] if a else "-",
+                                       "%.1f" % b["ns_per_op"] if b else "-"))
+            continue
+        delta = (b["ns_per_op"] - a["ns_per_op"]) * 100.0 / a["ns_per_op"] if a["ns_per_op"] else 0
+        allocs = "%g->%g" % (a["allocs_per_op"], b["allocs_per_op"]) \
+            if a["allocs_per_op"] != b["allocs_per_op"] else "%g" % b["allocs_per_op"]
+        print("%-28s %12.1f %12.1f %+7.1f%% %10s" % (name, a["ns_per_op"], b["ns_per_op"], delta, allocs))
+        if args.threshold and delta > args.threshold:
+            regressions.append(name)
+
+    if regressions:
+        print("变慢超过 %g%%: %s" % (args.threshold, ", ".join(regressions)), file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""查看traffic_capture抓包文件.
+
+逐条输出时刻, 通道, 事件和负载(截断), 最后给出每个通道的事件数, 字节数和时长.
+文件格式见 components/traffic_capture/include/traffic_capture.h (小端主机).
+
+用法:
+    VOICE_CAPTURE_FILE=cap.bin ./build/voice_pipeline_host.elf
+    python3 tools/capture_dump.py cap.bin [--summary]
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0x43525456
+VERSION = 1
+FILE_HEADER = struct.Struct("<IHH")
+RECORD_HEADER = struct.Struct("<qiIBB6x")
+
+CHANNELS = {0: "funasr", 1: "ollama"}
+EVENTS = {
+    "funasr": {0: "ERROR", 1: "CONNECTED", 2: "DISCONNECTED", 3: "DATA", 4: "CLOSED",
+               5: "BEFORE_CONNECT"},
+    "ollama": {-1: "REQUEST", 0: "ERROR", 1: "ON_CONNECTED", 2: "HEADERS_SENT",
+               3: "ON_HEADER", 4: "ON_DATA", 5: "ON_FINISH", 6: "DISCONNECTED",
+               7: "REDIRECT"},
+}
+
+
+def read_capture(fp):
+    data = fp.read()
+    magic, version, _ = FILE_HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("不是抓包文件或版本不符")
+    pos = FILE_HEADER.size
+    while pos + RECORD_HEADER.size <= len(data):
+        time_us, event, length, channel, op_code = RECORD_HEADER.unpack_from(data, pos)
+        pos += RECORD_HEADER.size
+        if pos + length > len(data):
+            break
+        yield time_us, channel, event, op_code, data[pos:pos + length]
+        pos += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file")
+    parser.add_argument("--summary", action="store_true", help="只输出统计")
+    parser.add_argument("--width", type=int, default=80, help="负载最多显示的字符数")
+    args = parser.parse_args()
+
+    stats = {}
+    with open(args.file, "rb") as fp:
+        for time_us, channel, event, op_code, payload in read_capture(fp):
+            name = CHANNELS.get(channel, str(channel))
+            st = stats.setdefault(name, {"events": 0, "bytes": 0, "first": time_us, "last": 0})
+            st["events"] += 1
+            st["bytes"] += len(payload)
+            st["last"] = time_us
+            if args.summary:
+                continue
+            text = payload.decode("utf-8", "replace").replace("\n", "\\n")
+            if len(text) > args.width:
+                text = text[:args.width] + "..."
+            print("%10.3f %-6s %-14s op=%d %5d %s" % (
+                time_us / 1000.0, name, EVENTS.get(name, {}).get(event, str(event)),
+                op_code, len(payload), text))
+
+    for name, st in sorted(stats.items()):
+        print("%s: %d 个事件, %d 字节, 跨度 %.1f ms" % (
+            name, st["events"], st["bytes"], (st["last"] - st["first"]) / 1000.0),
+            file=sys.stderr if not args.summary else sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""FunASR上传解码中转.
+
+设备以IMA-ADPCM上传(UPLOAD_CODEC = AUDIO_CODEC_IMA_ADPCM)时, 把设备的
+WebSocket地址指向本程序, 本程序把音频解码成PCM后转发给真正的FunASR服务器,
+识别结果原样返回设备.
+
+用法:
+    pip install websockets
+    python3 tools/funasr_adpcm_proxy.py --listen 0.0.0.0:10096 --upstream ws://127.0.0.1:10095
+"""
+
+import argparse
+import asyncio
+import json
+import logging
+
+import websockets
+
+from ima_adpcm import decode_block
+
+log = logging.getLogger("adpcm_proxy")
+
+
+async def relay(device, upstream_uri):
+    adpcm = False
+    async with websockets.connect(upstream_uri, max_size=None) as server:
+
+        async def uplink():
+            nonlocal adpcm
+            async for msg in device:
+                if isinstance(msg, str):
+                    # 开始帧声明了wav_format, 转发给FunASR前改回pcm
+                    try:
+                        frame = json.loads(msg)
+                    except ValueError:
+                        await server.send(msg)
+                        continue
+                    if "wav_format" in frame:
+                        adpcm = frame["wav_format"] == "ima_adpcm"
+                        frame["wav_format"] = "pcm"
+                    await server.send(json.dumps(frame, ensure_ascii=False))
+                elif adpcm:
+                    await server.send(decode_block(msg))
+                else:
+                    await server.send(msg)
+
+        async def downlink():
+            async for msg in server:
+                await device.send(msg)
+
+        tasks = [asyncio.create_task(uplink()), asyncio.create_task(downlink())]
+        _, pending = await asyncio.wait(tasks, return_when=asyncio.FIRST_COMPLETED)
+        for task in pending:
+            task.cancel()
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--listen", default="0.0.0.0:10096", help="监听地址 host:port")
+    parser.add_argument("--upstream", default="ws://127.0.0.1:10095", help="FunASR服务器地址")
+    args = parser.parse_args()
+
+    host, port = args.listen.rsplit(":", 1)
+
+    async def handler(device, *_):
+        log.info("设备连接: %s", device.remote_address)
+        try:
+            await relay(device, args.upstream)
+        except websockets.ConnectionClosed:
+            pass
+        log.info("设备断开: %s", device.remote_address)
+
+    async with websockets.serve(handler, host, int(port), max_size=None):
+        log.info("监听 %s, 转发到 %s", args.listen, args.upstream)
+        await asyncio.Future()
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.INFO, format="%(asctime)s %(name)s %(message)s")
+    asyncio.run(main())
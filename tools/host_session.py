@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""用本地模拟服务驱动主机构建, 按场景脚本检查端到端结果.
+
+按场景的host节合成麦克风输入(若干段浊音), 在本进程内启动FunASR/Ollama模拟服务,
+运行主机构建程序直到输入播完退出, 再用expect节检查程序最后输出的指标(METRIC行)
+和模拟服务的事件记录. 任一检查不通过时返回非零.
+
+host节:
+    "speech": [[开始秒, 时长秒], ...]   每段语音在输入中的位置
+    "amplitude": 16000                  浊音基频的幅度
+    "tail_ms": 6000                     输入之后的静音时长(VOICE_HAL_TAIL_MS)
+    "env": {"VOICE_TTS_RTF_PCT": "30"}  额外的环境变量
+expect节:
+    "metrics": {"playback.barge_in_ms.count": "==1", ...}
+        计数器/仪表直接用名字, 直方图用 名字.count / 名字.max
+    "events": {"ollama.request": "==2", "funasr.fault.disconnect": ">=1", ...}
+        模拟服务的事件数, 按 服务.事件 或 服务.fault.故障类型 计数
+    "gaps": {"funasr.fault.refuse -> funasr.connect": "<=1000", ...}
+        前一事件每次出现到其后第一个后一事件的间隔(毫秒)取最大值, 后面没有该事件时视为无穷大
+    条件为 "<比较符><数值>", 比较符是 == != >= <= > < 之一
+
+用法:
+    pip install websockets
+    python3 tools/host_session.py --elf host/build/voice_pipeline_host.elf \\
+        --scenario tools/scenarios/barge_in.json [--log session.log]
+"""
+
+import argparse
+import asyncio
+import logging
+import math
+import os
+import random
+import re
+import sys
+import tempfile
+import wave
+
+from mock_script import Recorder, Scenario
+
+SAMPLE_RATE = 16000
+METRIC = re.compile(r"METRIC (\S+) (.*)")
+CONDITION = re.compile(r"\s*(==|!=|>=|<=|>|<)\s*(-?[\d.]+)\s*$")
+OPS = {
+    "==": lambda a, b: a == b,
+    "!=": lambda a, b: a != b,
+    ">=": lambda a, b: a >= b,
+    "<=": lambda a, b: a <= b,
+    ">": lambda a, b: a > b,
+    "<": lambda a, b: a < b,
+}
+
+
+class MemoryRecorder(Recorder):
+    """在写文件之外保留全部事件, 供结束后检查"""
+
+    def __init__(self, path=None):
+        super().__init__(path)
+        self.records = []
+
+    def event(self, server, event, **fields):
+        record = super().event(server, event, **fields)
+        self.records.append(record)
+        return record
+
+    @staticmethod
+    def keys(record):
+        keys = ["%s.%s" % (record["server"], record["event"])]
+        if record["event"] == "fault":
+            keys.append("%s.fault.%s" % (record["server"], record.get("kind")))
+        return keys
+
+    def counts(self):
+        result = {}
+        for r in self.records:
+            for key in self.keys(r):
+                result[key] = result.get(key, 0) + 1
+        return result
+
+    def gaps(self, names):
+        """每个 "前 -> 后" 取前一事件到其后第一个后一事件的最大间隔(毫秒)"""
+        result = {}
+        for name in names:
+            first, _, second = (part.strip() for part in name.partition("->"))
+            gap = 0
+            for i, r in enumerate(self.records):
+                if first not in self.keys(r):
+                    continue
+                after = next((x for x in self.records[i + 1:] if second in self.keys(x)), None)
+                gap = max(gap, after["t_ms"] - r["t_ms"] if after else math.inf)
+            result[name] = gap
+        return result
+
+
+def write_input(path, cfg, seed):
+    """低噪声底上的若干段浊音: 基频加两个谐波, 首尾20ms渐变"""
+    speech = cfg.get("speech", [[0.5, 1.0]])
+    amplitude = cfg.get("amplitude", 16000)
+    end = max(start + length for start, length in speech) + 0.5
+    n = int(end * SAMPLE_RATE)
+    rng = random.Random(seed)
+    pcm = [rng.randint(-20, 20) for _ in range(n)]
+    fade = SAMPLE_RATE // 50
+
+    for start, length in speech:
+        begin = int(start * SAMPLE_RATE)
+        count = int(length * SAMPLE_RATE)
+        for i in range(count):
+            t = i / SAMPLE_RATE
+            f0 = 140 + 20 * math.sin(2 * math.pi * 3 * t)
+            v = sum(amplitude / (k * k) * math.sin(2 * math.pi * f0 * k * t) for k in (1, 2, 3))
+            v *= min(1.0, i / fade, (count - i) / fade)
+            pcm[begin + i] = max(-32768, min(32767, int(pcm[begin + i] + v)))
+
+    with wave.open(path, "wb") as wav:
+        wav.setnchannels(1)
+        wav.setsampwidth(2)
+        wav.setframerate(SAMPLE_RATE)
+        wav.writeframes(b"".join(int(x).to_bytes(2, "little", signed=True) for x in pcm))
+    return end
+
+
+def parse_metrics(lines):
+    """取最后一次输出的每个指标, 直方图拆成 名字.count / 名字.max"""
+    metrics = {}
+    for line in lines:
+        m = METRIC.search(line)
+        if not m:
+            continue
+        name, rest = m.group(1), m.group(2).split()
+        if rest and "=" not in rest[0]:
+            metrics[name] = float(rest[0])
+            continue
+        for kv in rest:
+            if kv.startswith(("count=", "max=")):
+                key, value = kv.split("=", 1)
+                metrics["%s.%s" % (name, key)] = float(value)
+    return metrics
+
+
+def check(kind, expect, actual):
+    failures = []
+    for name, condition in expect.items():
+        m = CONDITION.match(str(condition))
+        if not m:
+            failures.append("%s %s: 无法解析的条件" % (kind, name))
+            continue
+        value = actual.get(name, 0)
+        ok = OPS[m.group(1)](value, float(m.group(2)))
+        print("%-4s %-8s %-36s %10g %s" % ("通过" if ok else "失败", kind, name, value, condition))
+        if not ok:
+            failures.append(name)
+    return failures
+
+
+async def serve(scenario, recorder):
+    from mock_funasr import FunasrMock
+    from mock_ollama import OllamaMock
+    funasr = FunasrMock(scenario, recorder)
+    ollama = OllamaMock(scenario, recorder)
+    servers = [await funasr.serve("127.0.0.1", 0), await ollama.serve("127.0.0.1", 0)]
+    ports = [s.sockets[0].getsockname()[1] for s in servers]
+    return servers, [funasr, ollama], ports
+
+
+async def run(args):
+    scenario = Scenario(args.scenario, args.seed)
+    host = scenario.config.get("host", {})
+    expect = scenario.config.get("expect", {})
+    recorder = MemoryRecorder(args.record)
+    servers, mocks, (funasr_port, ollama_port) = await serve(scenario, recorder)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        mic = os.path.join(tmp, "mic.wav")
+        input_s = write_input(mic, host, args.seed)
+        tail_ms = host.get("tail_ms", 6000)
+        env = dict(os.environ)
+        env.update({
+            "VOICE_HAL_MIC_WAV": mic,
+            "VOICE_HAL_SPK_WAV": args.speaker or os.path.join(tmp, "spk.wav"),
+            "VOICE_HAL_TAIL_MS": str(tail_ms),
+            "VOICE_FUNASR_URI": "ws://127.0.0.1:%d" % funasr_port,
+            "VOICE_OLLAMA_URI": "http://127.0.0.1:%d/api/generate" % ollama_port,
+        })
+        env.update({k: str(v) for k, v in host.get("env", {}).items()})
+
+        proc = await asyncio.create_subprocess_exec(
+            args.elf, env=env, stdout=asyncio.subprocess.PIPE, stderr=asyncio.subprocess.STDOUT)
+        lines = []
+        log_fp = open(args.log, "w", encoding="utf-8") if args.log else None
+
+        async def pump():
+            async for raw in proc.stdout:
+                line = raw.decode("utf-8", "replace").rstrip("\n")
+                lines.append(line)
+                if log_fp:
+                    log_fp.write(line + "\n")
+
+        timeout = input_s + tail_ms / 1000.0 + args.margin
+        try:
+            await asyncio.wait_for(asyncio.gather(pump(), proc.wait()), timeout)
+        except asyncio.TimeoutError:
+            proc.kill()
+            await proc.wait()
+            print("程序在 %.0f 秒内没有退出" % timeout, file=sys.stderr)
+        finally:
+            if log_fp:
+                log_fp.close()
+            for server in servers:
+                server.close()
+            recorder.close()
+
+    for mock in mocks:
+        print(mock.summary())
+    failures = []
+    if proc.returncode != 0:
+        failures.append("exit")
+        print("程序退出码 %s" % proc.returncode)
+    failures += check("指标", expect.get("metrics", {}), parse_metrics(lines))
+    failures += check("事件", expect.get("events", {}), recorder.counts())
+    gaps = expect.get("gaps", {})
+    failures += check("间隔", gaps, recorder.gaps(gaps))
+    if failures:
+        print("\n".join(lines[-args.tail:]), file=sys.stderr)
+        print("未通过: %s" % ", ".join(failures), file=sys.stderr)
+        return 1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--elf", required=True, help="主机构建程序(host/build/voice_pipeline_host.elf)")
+    parser.add_argument("--scenario", required=True, help="场景脚本(JSON), 需包含host和expect节")
+    parser.add_argument("--seed", type=int, default=0, help="抖动和输入噪声的随机种子")
+    parser.add_argument("--record", help="模拟服务计时记录输出文件(JSONL, 追加写入)")
+    parser.add_argument("--log", help="程序输出保存到此文件")
+    parser.add_argument("--speaker", help="喇叭输出WAV, 不指定时写到临时目录")
+    parser.add_argument("--margin", type=float, default=20, help="超出输入时长多少秒仍未退出视为卡死")
+    parser.add_argument("--tail", type=int, default=40, help="失败时显示程序输出的最后几行")
+    args = parser.parse_args()
+    return asyncio.run(run(args))
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.WARNING, format="%(asctime)s %(name)s %(message)s")
+    sys.exit(main())
@@ -0,0 +1,57 @@
+"""IMA-ADPCM块解码, 与components/audio_codec/ima_adpcm.c的块格式一致.
+
+块头: 预测值(int16, 小端) + 步长索引(uint8) + 标志(uint8, bit0表示样本数为奇数),
+之后每字节两个4位码, 低4位在前.
+"""
+
+import struct
+
+HEADER_BYTES = 4
+FLAG_ODD = 0x01
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def decode_block(data: bytes) -> bytes:
+    """解码一块, 返回16位小端PCM; 数据不完整时返回空"""
+    if len(data) < HEADER_BYTES or data[2] > 88:
+        return b""
+
+    predictor = struct.unpack_from("<h", data, 0)[0]
+    index = data[2]
+    samples = (len(data) - HEADER_BYTES) * 2
+    if data[3] & FLAG_ODD and samples > 0:
+        samples -= 1
+
+    out = []
+    for i in range(samples):
+        byte = data[HEADER_BYTES + (i >> 1)]
+        code = (byte >> 4) if (i & 1) else (byte & 0x0F)
+
+        step = STEP_TABLE[index]
+        diff = step >> 3
+        if code & 4:
+            diff += step
+        if code & 2:
+            diff += step >> 1
+        if code & 1:
+            diff += step >> 2
+        predictor += -diff if code & 8 else diff
+        predictor = max(-32768, min(32767, predictor))
+
+        index = max(0, min(88, index + INDEX_TABLE[code]))
+        out.append(predictor)
+
+    return struct.pack("<%dh" % len(out), *out)
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""端到端延迟分段统计.
+
+从串口日志(或主机构建的输出)中提取latency_trace_dump()输出的LTRACE行,
+按段计算分位数: 识别(语音结束->最终结果), 大模型(->首token),
+合成(->首段PCM), 播放(->开始写入喇叭), 以及总计(语音结束->开始播放).
+同一编号多次出现时取最后一行; 不完整的记录只计入已到达的分段.
+
+用法:
+    idf.py monitor | tee serial.log
+    python3 tools/latency_report.py serial.log [--csv out.csv]
+"""
+
+import argparse
+import re
+import sys
+
+LINE = re.compile(r"LTRACE (\d+) (-?\d+) (-?\d+) (-?\d+) (-?\d+) (-?\d+)")
+
+POINTS = ["asr_final", "llm_first_token", "tts_first_sample", "playback_start"]
+STAGES = [
+    ("识别", None, "asr_final"),
+    ("大模型首token", "asr_final", "llm_first_token"),
+    ("合成首包", "llm_first_token", "tts_first_sample"),
+    ("播放启动", "tts_first_sample", "playback_start"),
+    ("总计", None, "playback_start"),
+]
+PERCENTILES = [50, 90, 99]
+
+
+def parse(lines):
+    traces = {}
+    for line in lines:
+        m = LINE.search(line)
+        if not m:
+            continue
+        values = [int(v) for v in m.groups()]
+        offsets = {name: (v if v >= 0 else None) for name, v in zip(POINTS, values[2:])}
+        traces[(values[0], values[1])] = offsets
+    return [traces[k] for k in sorted(traces, key=lambda k: k[1])]
+
+
+def percentile(sorted_values, p):
+    """最近秩法"""
+    if not sorted_values:
+        return None
+    rank = max(1, -(-p * len(sorted_values) // 100))
+    return sorted_values[rank - 1]
+
+
+def stage_values(traces, begin, end):
+    values = []
+    for t in traces:
+        start = 0 if begin is None else t[begin]
+        if start is not None and t[end] is not None:
+            values.append((t[end] - start) / 1000.0)
+    return sorted(values)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="*", help="日志文件, 不指定时读标准输入")
+    parser.add_argument("--csv", help="每段语音一行的明细输出(毫秒)")
+    args = parser.parse_args()
+
+    lines = []
+    if args.log:
+        for path in args.log:
+            with open(path, encoding="utf-8", errors="replace") as fp:
+                lines.extend(fp)
+    else:
+        lines = sys.stdin
+    traces = parse(lines)
+    if not traces:
+        print("没有找到LTRACE记录")
+        return 1
+
+    print("共 %d 段语音, 完整 %d 段" % (len(traces), sum(1 for t in traces if t["playback_start"] is not None)))
+    header = "%-14s %6s" % ("分段(ms)", "样本") + "".join(" %8s" % ("p%d" % p) for p in PERCENTILES) + " %8s" % "最大"
+    print(header)
+    for name, begin, end in STAGES:
+        values = stage_values(traces, begin, end)
+        cells = [percentile(values, p) for p in PERCENTILES] + [values[-1] if values else None]
+        print("%-14s %6d" % (name, len(values)) +
+              "".join(" %8s" % ("-" if v is None else "%.1f" % v) for v in cells))
+
+    if args.csv:
+        with open(args.csv, "w", encoding="utf-8") as fp:
+            fp.write(",".join(POINTS) + "\n")
+            for t in traces:
+                fp.write(",".join("" if t[p] is None else "%.3f" % (t[p] / 1000.0) for p in POINTS) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""解析metrics_snapshot_binary()输出的二进制指标快照.
+
+格式(小端): magic(4) 个数(2), 之后每个指标: 类型(1) 名字长度(1) 名字 值(4),
+直方图另有 最大值(4) 桶数(1) 桶上界(4*(桶数-1)) 各桶计数(4*桶数).
+输入可以是原始二进制文件, 也可以是十六进制文本(串口转储, 忽略空白).
+输出与metrics_snapshot_text()的文本格式相同.
+
+用法:
+    python3 tools/metrics_decode.py snapshot.bin
+    python3 tools/metrics_decode.py --hex snapshot.txt
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0x3154454D
+TYPES = {0: "counter", 1: "gauge", 2: "histogram"}
+
+
+def decode(data):
+    magic, count = struct.unpack_from("<IH", data, 0)
+    if magic != MAGIC:
+        raise ValueError("magic不匹配: 0x%08x" % magic)
+    pos = 6
+    metrics = []
+    for _ in range(count):
+        kind, name_len = struct.unpack_from("<BB", data, pos)
+        pos += 2
+        name = data[pos:pos + name_len].decode("utf-8", "replace")
+        pos += name_len
+        (value,) = struct.unpack_from("<I", data, pos)
+        pos += 4
+        metric = {"name": name, "type": TYPES.get(kind, str(kind)), "value": value}
+        if kind == 2:
+            peak, buckets = struct.unpack_from("<IB", data, pos)
+            pos += 5
+            bounds = list(struct.unpack_from("<%dI" % (buckets - 1), data, pos))
+            pos += 4 * (buckets - 1)
+            counts = list(struct.unpack_from("<%dI" % buckets, data, pos))
+            pos += 4 * buckets
+            metric.update(max=peak, bounds=bounds, counts=counts)
+        metrics.append(metric)
+    return metrics
+
+
+def format_metric(m):
+    if m["type"] != "histogram":
+        return "%s %d" % (m["name"], m["value"])
+    parts = ["%s count=%d max=%d" % (m["name"], m["value"], m["max"])]
+    parts += ["<%d:%d" % (b, c) for b, c in zip(m["bounds"], m["counts"])]
+    parts.append("inf:%d" % m["counts"][-1])
+    return " ".join(parts)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", nargs="?", help="快照文件, 不指定时读标准输入")
+    parser.add_argument("--hex", action="store_true", help="输入是十六进制文本")
+    args = parser.parse_args()
+
+    fp = open(args.file, "rb") if args.file else sys.stdin.buffer
+    with fp:
+        data = fp.read()
+    if args.hex:
+        data = bytes.fromhex(data.decode("ascii", "ignore").replace("\n", " "))
+    for m in decode(data):
+        print(format_metric(m))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,171 @@
+"""FunASR WebSocket模拟服务.
+
+按funasr_send_start_frame()/funasr_send_finish_frame()使用的协议工作:
+开始帧(is_speaking=true)开启一段语音, 之后的二进制帧是音频,
+结束帧(is_speaking=false)之后回复2pass-offline最终结果;
+音频每到partial_interval_ms回复一次2pass-online中间结果.
+识别文本按场景脚本依次给出, 与实际音频内容无关.
+
+断线时尚未收到结束帧的语音段会保留, 重连后的开始帧和补发音频接续到这一段,
+因此注入断线故障后, 识别结果的顺序和不断线时一致.
+"""
+
+import asyncio
+import json
+import logging
+
+import websockets
+
+from ima_adpcm import HEADER_BYTES, FLAG_ODD
+
+log = logging.getLogger("mock_funasr")
+
+
+def audio_samples(data, wav_format):
+    """一条二进制消息中的样本数"""
+    if wav_format == "ima_adpcm":
+        if len(data) < HEADER_BYTES:
+            return 0
+        samples = (len(data) - HEADER_BYTES) * 2
+        return samples - 1 if data[3] & FLAG_ODD and samples > 0 else samples
+    return len(data) // 2
+
+
+class Utterance:
+    def __init__(self, index, text, connection):
+        self.index = index
+        self.text = text
+        self.connection = connection
+        self.wav_format = "pcm"
+        self.sample_rate = 16000
+        self.samples = 0
+        self.partials = 0
+
+    def audio_ms(self):
+        return self.samples * 1000 // self.sample_rate
+
+
+class FunasrMock:
+    def __init__(self, scenario, recorder):
+        self.scenario = scenario
+        self.cfg = scenario.section("funasr")
+        self.rec = recorder
+        self.connections = 0
+        self.utterances = 0
+        self.open = None            # 还没收到结束帧的语音段
+        self.fired = set()          # 已触发的一次性故障
+        self.latencies_ms = []      # 结束帧到最终结果
+
+    def event(self, event, **fields):
+        record = self.rec.event("funasr", event, **fields)
+        log.info("%s %s", event, {k: v for k, v in fields.items() if k != "text"})
+        return record
+
+    async def handler(self, ws, *_):
+        self.connections += 1
+        conn = self.connections
+        self.event("connect", connection=conn)
+
+        if self.scenario.fault("funasr", "refuse", "connection", conn):
+            self.event("fault", kind="refuse", connection=conn)
+            ws.transport.abort()
+            return
+
+        try:
+            async for msg in ws:
+                if isinstance(msg, str):
+                    await self.on_control(ws, conn, msg)
+                elif not await self.on_audio(ws, msg):
+                    break
+        except websockets.ConnectionClosed:
+            pass
+        self.event("disconnect", connection=conn)
+
+    async def on_control(self, ws, conn, msg):
+        try:
+            frame = json.loads(msg)
+        except ValueError:
+            self.event("bad_frame", connection=conn)
+            return
+
+        if frame.get("is_speaking") is True:
+            utt = self.open
+            if utt is not None and utt.connection != conn:
+                # 断线重连后的补发, 接续上一段
+                utt.connection = conn
+                self.event("resume", utterance=utt.index, audio_ms=utt.audio_ms())
+            else:
+                self.utterances += 1
+                transcripts = self.cfg["transcripts"]
+                text = transcripts[(self.utterances - 1) % len(transcripts)]
+                utt = Utterance(self.utterances, text, conn)
+                self.open = utt
+                self.event("start", utterance=utt.index, connection=conn,
+                           chunk_size=frame.get("chunk_size"))
+            utt.wav_format = frame.get("wav_format", "pcm")
+            utt.sample_rate = frame.get("audio_fs", 16000)
+        elif frame.get("is_speaking") is False:
+            utt = self.open
+            if utt is None:
+                self.event("end_without_start", connection=conn)
+                return
+            self.open = None
+            end = self.event("end", utterance=utt.index, audio_ms=utt.audio_ms())
+            asyncio.ensure_future(self.send_final(ws, utt, end["t_ms"]))
+
+    async def on_audio(self, ws, data):
+        """返回False表示已注入断线, 丢弃缓冲中剩余的消息"""
+        utt = self.open
+        if utt is None:
+            return True
+        if utt.samples == 0:
+            self.event("first_audio", utterance=utt.index)
+        utt.samples += audio_samples(data, utt.wav_format)
+
+        fault = self.scenario.fault("funasr", "disconnect", "utterance", utt.index)
+        if fault and ("disconnect", utt.index) not in self.fired and \
+                utt.audio_ms() >= fault.get("after_ms", 0):
+            self.fired.add(("disconnect", utt.index))
+            self.event("fault", kind="disconnect", utterance=utt.index, audio_ms=utt.audio_ms())
+            ws.transport.abort()
+            return False
+
+        interval = self.cfg["partial_interval_ms"]
+        while interval > 0 and utt.audio_ms() >= (utt.partials + 1) * interval:
+            utt.partials += 1
+            partial = utt.text[:utt.partials]
+            await ws.send(json.dumps({"mode": "2pass-online", "text": partial,
+                                      "wav_name": "mic", "is_final": False},
+                                     ensure_ascii=False))
+        return True
+
+    async def send_final(self, ws, utt, end_ms):
+        if self.scenario.fault("funasr", "drop_final", "utterance", utt.index):
+            self.event("fault", kind="drop_final", utterance=utt.index)
+            return
+
+        delay_ms = self.cfg["final_delay_ms"]
+        fault = self.scenario.fault("funasr", "delay", "utterance", utt.index)
+        if fault:
+            delay_ms += fault.get("ms", 0)
+        await asyncio.sleep(self.scenario.delay("funasr", delay_ms))
+
+        try:
+            await ws.send(json.dumps({"mode": "2pass-offline", "text": utt.text,
+                                      "wav_name": "mic", "is_final": True},
+                                     ensure_ascii=False))
+        except websockets.ConnectionClosed:
+            self.event("final_lost", utterance=utt.index)
+            return
+        record = self.event("final", utterance=utt.index, text=utt.text)
+        self.latencies_ms.append(record["t_ms"] - end_ms)
+
+    async def serve(self, host, port):
+        return await websockets.serve(self.handler, host, port, max_size=None)
+
+    def summary(self):
+        lat = self.latencies_ms
+        if not lat:
+            return "funasr: 无最终结果"
+        return "funasr: 连接 %d 次, 语音 %d 段, 结束帧到最终结果 平均 %.1f ms, 最大 %.1f ms" % (
+            self.connections, self.utterances, sum(lat) / len(lat), max(lat))
@@ -0,0 +1,170 @@
+"""Ollama /api/generate 模拟服务.
+
+以分块传输流式返回NDJSON, 与真实服务一致: 每行一个token,
+最后一行done=true并带context. 不带prompt的请求(ollama_warmup)立即返回.
+连接保持复用, 每个新TCP连接记一次connect; 设备打断时主动断开连接, 记为cancelled.
+"""
+
+import asyncio
+import json
+import logging
+import time
+
+log = logging.getLogger("mock_ollama")
+
+
+async def read_request(reader):
+    """读一个HTTP/1.1请求, 连接关闭时返回None"""
+    line = await reader.readline()
+    if not line:
+        return None
+    method, path, _ = line.decode("latin-1").split(" ", 2)
+    headers = {}
+    while True:
+        line = await reader.readline()
+        if line in (b"\r\n", b"\n", b""):
+            break
+        name, _, value = line.decode("latin-1").partition(":")
+        headers[name.strip().lower()] = value.strip()
+    body = b""
+    length = int(headers.get("content-length", 0))
+    if length:
+        body = await reader.readexactly(length)
+    return method, path, headers, body
+
+
+def created_at():
+    return time.strftime("%Y-%m-%dT%H:%M:%S", time.gmtime()) + "Z"
+
+
+class OllamaMock:
+    def __init__(self, scenario, recorder):
+        self.scenario = scenario
+        self.cfg = scenario.section("ollama")
+        self.rec = recorder
+        self.requests = 0
+        self.connections = 0
+        self.first_token_ms = []    # 请求到第一个token
+
+    def event(self, event, **fields):
+        record = self.rec.event("ollama", event, **fields)
+        log.info("%s %s", event, {k: v for k, v in fields.items() if k != "prompt"})
+        return record
+
+    def reply_for(self, prompt):
+        for reply in self.cfg["replies"]:
+            if reply.get("match", "") in prompt:
+                return reply["response"]
+        return ""
+
+    def tokens(self, text):
+        n = max(1, self.cfg["token_chars"])
+        return [text[i:i + n] for i in range(0, len(text), n)]
+
+    async def handle(self, reader, writer):
+        self.connections += 1
+        self.event("connect", connection=self.connections)
+        try:
+            while True:
+                request = await read_request(reader)
+                if request is None:
+                    break
+                method, path, headers, body = request
+                if not await self.respond(writer, path, body):
+                    break
+                if headers.get("connection", "").lower() == "close":
+                    break
+        except (ConnectionError, asyncio.IncompleteReadError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+    async def send_json(self, writer, status, obj):
+        data = json.dumps(obj, ensure_ascii=False).encode()
+        writer.write(("HTTP/1.1 %d %s\r\nContent-Type: application/json\r\n"
+                      "Content-Length: %d\r\n\r\n" % (status, "OK" if status == 200 else "Error",
+                                                      len(data))).encode() + data)
+        await writer.drain()
+
+    async def send_chunk(self, writer, obj):
+        line = (json.dumps(obj, ensure_ascii=False) + "\n").encode()
+        writer.write(b"%x\r\n%s\r\n" % (len(line), line))
+        await writer.drain()
+
+    async def respond(self, writer, path, body):
+        """返回False表示连接已断开"""
+        try:
+            req = json.loads(body or b"{}")
+        except ValueError:
+            await self.send_json(writer, 400, {"error": "invalid json"})
+            return True
+        model = req.get("model", self.cfg["model"])
+        prompt = req.get("prompt")
+
+        if not prompt:
+            self.event("warmup", model=model)
+            await self.send_json(writer, 200, {"model": model, "created_at": created_at(),
+                                               "response": "", "done": True})
+            return True
+
+        self.requests += 1
+        index = self.requests
+        start = self.event("request", request=index, prompt=prompt,
+                           context_len=len(req.get("context", [])))
+
+        fault = self.scenario.fault("ollama", "status", "request", index)
+        if fault:
+            self.event("fault", kind="status", request=index, status=fault.get("status", 500))
+            await self.send_json(writer, fault.get("status", 500), {"error": "injected fault"})
+            return True
+
+        stall = self.scenario.fault("ollama", "stall", "request", index)
+        drop = self.scenario.fault("ollama", "disconnect", "request", index)
+        reply = self.reply_for(prompt)
+        tokens = self.tokens(reply)
+
+        writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\n"
+                     b"Transfer-Encoding: chunked\r\n\r\n")
+        await asyncio.sleep(self.scenario.delay("ollama", self.cfg["first_token_ms"]))
+
+        try:
+            for i, token in enumerate(tokens):
+                if i > 0:
+                    await asyncio.sleep(self.scenario.delay("ollama", self.cfg["token_interval_ms"]))
+                await self.send_chunk(writer, {"model": model, "created_at": created_at(),
+                                               "response": token, "done": False})
+                if i == 0:
+                    first = self.event("first_token", request=index)
+                    self.first_token_ms.append(first["t_ms"] - start["t_ms"])
+                if stall and i + 1 == stall.get("after_tokens", 1):
+                    self.event("fault", kind="stall", request=index, ms=stall.get("ms", 0))
+                    await asyncio.sleep(stall.get("ms", 0) / 1000.0)
+                if drop and i + 1 == drop.get("after_tokens", 1):
+                    self.event("fault", kind="disconnect", request=index, tokens=i + 1)
+                    writer.transport.abort()
+                    return False
+
+            # context: 带来的上下文加上本轮的字符, 设备原样带回
+            context = list(req.get("context", [])) + [ord(c) for c in prompt + reply]
+            await self.send_chunk(writer, {"model": model, "created_at": created_at(),
+                                           "response": "", "done": True, "done_reason": "stop",
+                                           "context": context, "eval_count": len(tokens)})
+            writer.write(b"0\r\n\r\n")
+            await writer.drain()
+        except ConnectionError:
+            # 设备打断时关闭连接
+            self.event("cancelled", request=index)
+            return False
+
+        self.event("done", request=index, tokens=len(tokens))
+        return True
+
+    async def serve(self, host, port):
+        return await asyncio.start_server(self.handle, host, port)
+
+    def summary(self):
+        lat = self.first_token_ms
+        if not lat:
+            return "ollama: 无对话请求"
+        return "ollama: 连接 %d 次, 请求 %d 次, 首token 平均 %.1f ms, 最大 %.1f ms" % (
+            self.connections, self.requests, sum(lat) / len(lat), max(lat))
@@ -0,0 +1,94 @@
+"""本地模拟服务共用部分: 场景脚本, 带抖动的延迟, 故障注入和计时记录.
+
+场景文件是一个JSON对象, funasr/ollama两节分别给两个模拟服务使用,
+未写的字段取DEFAULTS中的值. 故障列表中的每一项按序号匹配
+(funasr按语音段, ollama按对话请求, 从1开始), 不写序号表示每次都生效.
+示例见 tools/scenarios/.
+"""
+
+import copy
+import json
+import random
+import time
+
+DEFAULTS = {
+    "funasr": {
+        # 按语音段依次使用, 用完后循环
+        "transcripts": ["你好", "今天天气怎么样"],
+        # 每收到多少毫秒音频回一次2pass-online中间结果(chunk_size [5,10,5]即600ms)
+        "partial_interval_ms": 600,
+        # 收到结束帧后多久回2pass-offline最终结果
+        "final_delay_ms": 200,
+        "jitter_ms": 0,
+        # {"type": "disconnect", "utterance": N, "after_ms": 音频毫秒数}  收到这么多音频后断开TCP
+        # {"type": "refuse", "connection": N}                        第N次连接握手后立即断开
+        # {"type": "drop_final", "utterance": N}                     不回最终结果
+        # {"type": "delay", "utterance": N, "ms": 毫秒}               最终结果额外延迟
+        "faults": [],
+    },
+    "ollama": {
+        # 按顺序匹配: prompt包含match(不写则总是匹配)时回复response
+        "replies": [{"response": "你好, 有什么可以帮你的吗?"}],
+        "model": "qwen:0.5b",
+        # 收到请求到第一个token, 以及之后每个token的间隔
+        "first_token_ms": 300,
+        "token_interval_ms": 40,
+        # 每个token包含的字符数
+        "token_chars": 1,
+        "jitter_ms": 0,
+        # {"type": "status", "request": N, "status": 500}             直接返回错误状态码
+        # {"type": "stall", "request": N, "after_tokens": K, "ms": 毫秒}  第K个token后停顿
+        # {"type": "disconnect", "request": N, "after_tokens": K}      第K个token后断开连接
+        "faults": [],
+    },
+}
+
+
+class Scenario:
+    """场景脚本及确定性的随机源"""
+
+    def __init__(self, path=None, seed=0):
+        self.config = copy.deepcopy(DEFAULTS)
+        if path:
+            with open(path, encoding="utf-8") as fp:
+                loaded = json.load(fp)
+            for name, section in loaded.items():
+                self.config.setdefault(name, {}).update(section)
+        self.rng = random.Random(seed)
+
+    def section(self, name):
+        return self.config[name]
+
+    def delay(self, name, ms):
+        """在ms上加对称抖动, 返回秒"""
+        jitter = self.config[name].get("jitter_ms", 0)
+        if jitter:
+            ms += self.rng.uniform(-jitter, jitter)
+        return max(0.0, ms) / 1000.0
+
+    def fault(self, name, kind, key, index):
+        """取第index次(语音段/请求/连接)生效的kind类故障, 没有时返回None"""
+        for f in self.config[name].get("faults", []):
+            if f.get("type") == kind and f.get(key, index) == index:
+                return f
+        return None
+
+
+class Recorder:
+    """计时记录: 每个事件一行JSON, t_ms为墙钟毫秒, 两个服务的记录可以直接合并排序"""
+
+    def __init__(self, path=None):
+        self.fp = open(path, "a", encoding="utf-8") if path else None
+
+    def event(self, server, event, **fields):
+        record = {"t_ms": round(time.time() * 1000.0, 3), "server": server, "event": event}
+        record.update(fields)
+        if self.fp:
+            self.fp.write(json.dumps(record, ensure_ascii=False) + "\n")
+            self.fp.flush()
+        return record
+
+    def close(self):
+        if self.fp:
+            self.fp.close()
+            self.fp = None
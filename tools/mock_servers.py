@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""本地FunASR/Ollama模拟服务, 用于不依赖GPU和外网的端到端延迟测试.
+
+两个服务按同一个场景脚本回放识别文本和大模型回复, 可配置延迟, 抖动和故障,
+所有事件带墙钟时间写入--record指定的JSONL文件. 与主机构建(host/)配合时,
+默认地址就是主机构建程序的默认服务地址.
+
+用法:
+    pip install websockets
+    python3 tools/mock_servers.py --scenario tools/scenarios/basic.json --record timing.jsonl
+"""
+
+import argparse
+import asyncio
+import logging
+
+from mock_script import Recorder, Scenario
+
+
+def split_addr(addr):
+    host, port = addr.rsplit(":", 1)
+    return host, int(port)
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--scenario", help="场景脚本(JSON), 不指定时使用内置默认值")
+    parser.add_argument("--seed", type=int, default=0, help="抖动的随机种子")
+    parser.add_argument("--record", help="计时记录输出文件(JSONL, 追加写入)")
+    parser.add_argument("--funasr", default="127.0.0.1:10095", help="FunASR监听地址, 空表示不启动")
+    parser.add_argument("--ollama", default="127.0.0.1:11434", help="Ollama监听地址, 空表示不启动")
+    parser.add_argument("--duration", type=float, default=0, help="运行秒数, 0表示直到Ctrl-C")
+    args = parser.parse_args()
+
+    scenario = Scenario(args.scenario, args.seed)
+    recorder = Recorder(args.record)
+    mocks = []
+    servers = []
+
+    if args.funasr:
+        from mock_funasr import FunasrMock
+        mock = FunasrMock(scenario, recorder)
+        servers.append(await mock.serve(*split_addr(args.funasr)))
+        mocks.append(mock)
+        logging.info("FunASR模拟服务 ws://%s", args.funasr)
+    if args.ollama:
+        from mock_ollama import OllamaMock
+        mock = OllamaMock(scenario, recorder)
+        servers.append(await mock.serve(*split_addr(args.ollama)))
+        mocks.append(mock)
+        logging.info("Ollama模拟服务 http://%s/api/generate", args.ollama)
+
+    try:
+        if args.duration > 0:
+            await asyncio.sleep(args.duration)
+        else:
+            await asyncio.Future()
+    finally:
+        for server in servers:
+            server.close()
+        for mock in mocks:
+            print(mock.summary())
+        recorder.close()
+
+
+if __name__ == "__main__":
+    logging.basicConfig(level=logging.INFO, format="%(asctime)s %(name)s %(message)s")
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass